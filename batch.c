@@ -0,0 +1,199 @@
+#include "batch.h"
+
+Spmm_Batch spmm_batch_alloc(Arena *arena, Spmm_Batch_Shape *shapes, u32 count)
+{
+  Spmm_Batch result =
+  {
+    .count   = count,
+    .lefts   = arena_calloc(arena, MAX(count, 1), CSR_Matrix),
+    .rights  = arena_calloc(arena, MAX(count, 1), Dense_Matrix),
+    .outputs = arena_calloc(arena, MAX(count, 1), Dense_Matrix),
+  };
+
+  // Sized up front so it's all one block, same section rounding as csr_alloc() so every array
+  // starts on its own line
+  u64 total_size = 0;
+  for (u32 i = 0; i < count; i++)
+  {
+    Spmm_Batch_Shape shape = shapes[i];
+
+    total_size += format_section_size(sizeof(u32) * ((u64)shape.row_count + 1));
+    total_size += format_section_size(sizeof(u32) * (u64)shape.non_zero_count);
+    total_size += format_section_size(sizeof(f64) * (u64)shape.non_zero_count);
+    total_size += format_section_size(sizeof(f64) * (u64)shape.inner_count * shape.col_count);
+    total_size += format_section_size(sizeof(f64) * (u64)shape.row_count * shape.col_count);
+  }
+
+  u8 *at = format_block_alloc(arena, MAX(total_size, 1));
+
+  for (u32 i = 0; i < count; i++)
+  {
+    Spmm_Batch_Shape shape = shapes[i];
+
+    CSR_Matrix *left = result.lefts + i;
+    left->non_zero_count = shape.non_zero_count;
+    left->row_count      = shape.row_count;
+    left->col_count      = shape.inner_count;
+
+    left->row_pointers = (u32 *)at;
+    at += format_section_size(sizeof(u32) * ((u64)shape.row_count + 1));
+    left->col_indices = (u32 *)at;
+    at += format_section_size(sizeof(u32) * (u64)shape.non_zero_count);
+    left->values = (f64 *)at;
+    at += format_section_size(sizeof(f64) * (u64)shape.non_zero_count);
+
+    Dense_Matrix *right = result.rights + i;
+    right->row_count = shape.inner_count;
+    right->col_count = shape.col_count;
+    right->values    = (f64 *)at;
+    at += format_section_size(sizeof(f64) * (u64)shape.inner_count * shape.col_count);
+
+    Dense_Matrix *output = result.outputs + i;
+    output->row_count = shape.row_count;
+    output->col_count = shape.col_count;
+    output->values    = (f64 *)at;
+    at += format_section_size(sizeof(f64) * (u64)shape.row_count * shape.col_count);
+  }
+
+  return result;
+}
+
+// Multiply adds plus the output writes, so a pair of empty rows still costs something
+static
+u64 spmm_batch_work(Spmm_Batch *batch, u32 index)
+{
+  CSR_Matrix   left   = batch->lefts[index];
+  Dense_Matrix output = batch->outputs[index];
+
+  return ((u64)left.non_zero_count + output.row_count) * output.col_count;
+}
+
+// Stable bottom up merge sort, descending by work
+static
+void spmm_batch_sort(u32 *items, u32 count, u64 *works, u32 *scratch)
+{
+  u32 *from = items;
+  u32 *to   = scratch;
+
+  for (u32 width = 1; width < count; width *= 2)
+  {
+    for (u32 begin = 0; begin < count; begin += 2 * width)
+    {
+      u32 middle = MIN(begin + width, count);
+      u32 end    = MIN(begin + 2 * width, count);
+
+      u32 a = begin, b = middle, out = begin;
+      while (a < middle && b < end)
+      {
+        to[out++] = works[from[b]] > works[from[a]] ? from[b++] : from[a++];
+      }
+      while (a < middle)
+      {
+        to[out++] = from[a++];
+      }
+      while (b < end)
+      {
+        to[out++] = from[b++];
+      }
+    }
+
+    u32 *swap = from;
+    from = to;
+    to   = swap;
+  }
+
+  if (from != items)
+  {
+    MEM_COPY(items, from, sizeof(u32) * count);
+  }
+}
+
+Spmm_Batch_Plan spmm_batch_plan(Arena *arena, Spmm_Batch *batch, u32 thread_count)
+{
+  u32 count = batch->count;
+
+  Spmm_Batch_Plan result =
+  {
+    .order        = arena_calloc(arena, MAX(count, 1), u32),
+    .group_starts = arena_calloc(arena, (usize)count + 1, u32),
+  };
+
+  u64 *works   = arena_calloc(arena, MAX(count, 1), u64);
+  u32 *scratch = arena_calloc(arena, MAX(count, 1), u32);
+
+  u64 total_work = 0;
+  for (u32 i = 0; i < count; i++)
+  {
+    works[i] = spmm_batch_work(batch, i);
+    total_work += works[i];
+
+    result.order[i] = i;
+  }
+
+  spmm_batch_sort(result.order, count, works, scratch);
+
+  u64 group_target = MAX(total_work / ((u64)MAX(thread_count, 1) * SPMM_BATCH_GROUPS_PER_THREAD), 1);
+
+  u64 group_work = 0;
+  for (u32 i = 0; i < count; i++)
+  {
+    group_work += works[result.order[i]];
+
+    if (group_work >= group_target || i + 1 == count)
+    {
+      result.group_starts[++result.group_count] = i + 1;
+      group_work = 0;
+    }
+  }
+
+  return result;
+}
+
+typedef struct Spmm_Batch_Task Spmm_Batch_Task;
+struct Spmm_Batch_Task
+{
+  Spmm_Batch      *batch;
+  Spmm_Batch_Plan *plan;
+};
+
+static
+void spmm_batch_task(void *user, u32 task_index, u32 task_count)
+{
+  (void)task_count;
+
+  Spmm_Batch_Task *task  = user;
+  Spmm_Batch      *batch = task->batch;
+  Spmm_Batch_Plan *plan  = task->plan;
+
+  for (u32 i = plan->group_starts[task_index]; i < plan->group_starts[task_index + 1]; i++)
+  {
+    u32 pair = plan->order[i];
+
+    CSR_Matrix   left   = batch->lefts[pair];
+    Dense_Matrix right  = batch->rights[pair];
+    Dense_Matrix output = batch->outputs[pair];
+
+    // Per pair, rights come in every width and the narrow ones have kernels of their own
+    Simd_CSR_Dense_Row *row_kernel = simd_csr_dense_row_kernel(right.col_count);
+
+    for (usize row = 0; row < left.row_count; row++)
+    {
+      usize nz_start = left.row_pointers[row];
+      usize nz_close = left.row_pointers[row + 1];
+
+      row_kernel(output.values + row * output.col_count, left.col_indices + nz_start, left.values + nz_start,
+                 nz_close - nz_start, right.values, right.col_count, right.col_count);
+    }
+  }
+}
+
+void spmm_batch_execute(Thread_Pool *pool, Spmm_Batch *batch, Spmm_Batch_Plan *plan)
+{
+  Spmm_Batch_Task task =
+  {
+    .batch = batch,
+    .plan  = plan,
+  };
+
+  thread_pool_dispatch(pool, plan->group_count, spmm_batch_task, &task);
+}
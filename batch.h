@@ -0,0 +1,59 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "../common.h"
+#include "formats.h"
+#include "threads.h"
+#include "simd.h"
+
+// Lots of small independent products, outputs[i] = lefts[i] X rights[i], the shape of a model
+// multiplying thousands of small sparse weights each by its own activations. One kernel call per
+// pair is mostly call overhead and cold caches at these sizes, so the whole batch lives in one
+// arena block, each pair's left, right and output one after another, and goes out to the pool
+// in groups
+typedef struct Spmm_Batch Spmm_Batch;
+struct Spmm_Batch
+{
+  u32 count;
+
+  CSR_Matrix   *lefts;
+  Dense_Matrix *rights;
+  Dense_Matrix *outputs;
+};
+
+// What spmm_batch_alloc() needs to lay a pair out, right is inner_count x col_count
+typedef struct Spmm_Batch_Shape Spmm_Batch_Shape;
+struct Spmm_Batch_Shape
+{
+  u32 row_count;
+  u32 inner_count;
+  u32 col_count;
+  u32 non_zero_count;
+};
+
+// Pairs in descending order of work, cut into groups. Anything bigger than a group's share is a
+// group by itself, the small ones get bundled until they add up to one. The pool hands groups
+// out in order, so the big ones start first and the small ones fill in behind, and no thread is
+// left with one giant pair at the end
+typedef struct Spmm_Batch_Plan Spmm_Batch_Plan;
+struct Spmm_Batch_Plan
+{
+  u32 *order;        // count pair indices
+  u32 *group_starts; // group_count + 1, into order
+  u32 group_count;
+};
+
+// Groups per thread the plan aims for, enough that the last few finish close together
+#define SPMM_BATCH_GROUPS_PER_THREAD 8
+
+// Values and row pointers left zeroed for the caller to fill in
+Spmm_Batch spmm_batch_alloc(Arena *arena, Spmm_Batch_Shape *shapes, u32 count);
+
+// Only looks at the shapes and non zero counts, so it can be made once and reused for every
+// batch laid out the same way
+Spmm_Batch_Plan spmm_batch_plan(Arena *arena, Spmm_Batch *batch, u32 thread_count);
+
+// Every output overwritten, none need zeroing first
+void spmm_batch_execute(Thread_Pool *pool, Spmm_Batch *batch, Spmm_Batch_Plan *plan);
+
+#endif // BATCH_H
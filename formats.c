@@ -1,5 +1,118 @@
 #include "formats.h"
 
+#include <stdlib.h>
+#include <sys/mman.h>
+
+static
+u64 format_section_size(u64 size)
+{
+  return (size + FORMAT_SECTION_ALIGNMENT - 1) & ~(u64)(FORMAT_SECTION_ALIGNMENT - 1);
+}
+
+static
+u8 *format_block_alloc(Arena *arena, u64 size)
+{
+  usize alignment = size >= FORMAT_HUGE_PAGE_SIZE ? FORMAT_HUGE_PAGE_SIZE : FORMAT_SECTION_ALIGNMENT;
+
+  // Over allocate and align by hand, the arena only promises alignment for the type
+  u8 *raw = arena_calloc(arena, size + alignment - 1, u8);
+  u8 *result = (u8 *)(((usize)raw + alignment - 1) & ~(alignment - 1));
+
+  if (alignment == FORMAT_HUGE_PAGE_SIZE)
+  {
+    // Only a hint, fine if the kernel says no
+    madvise(result, size & ~(u64)(FORMAT_HUGE_PAGE_SIZE - 1), MADV_HUGEPAGE);
+  }
+
+  return result;
+}
+
+static
+CSR_Matrix csr_alloc(Arena *arena, u32 row_count, u32 col_count, u32 non_zero_count)
+{
+  u64 pointers_size = format_section_size(sizeof(u32) * ((u64)row_count + 1));
+  u64 indices_size  = format_section_size(sizeof(u32) * (u64)non_zero_count);
+  u64 values_size   = format_section_size(sizeof(f64) * (u64)non_zero_count);
+
+  u8 *block = format_block_alloc(arena, pointers_size + indices_size + values_size);
+
+  CSR_Matrix result =
+  {
+    .non_zero_count = non_zero_count,
+    .row_count      = row_count,
+    .col_count      = col_count,
+    .row_pointers   = (u32 *)block,
+    .col_indices    = (u32 *)(block + pointers_size),
+    .values         = (f64 *)(block + pointers_size + indices_size),
+  };
+
+  return result;
+}
+
+static
+CSC_Matrix csc_alloc(Arena *arena, u32 row_count, u32 col_count, u32 non_zero_count)
+{
+  u64 pointers_size = format_section_size(sizeof(u32) * ((u64)col_count + 1));
+  u64 indices_size  = format_section_size(sizeof(u32) * (u64)non_zero_count);
+  u64 values_size   = format_section_size(sizeof(f64) * (u64)non_zero_count);
+
+  u8 *block = format_block_alloc(arena, pointers_size + indices_size + values_size);
+
+  CSC_Matrix result =
+  {
+    .non_zero_count = non_zero_count,
+    .row_count      = row_count,
+    .col_count      = col_count,
+    .row_indices    = (u32 *)(block + pointers_size),
+    .col_pointers   = (u32 *)block,
+    .values         = (f64 *)(block + pointers_size + indices_size),
+  };
+
+  return result;
+}
+
+static
+BCSR_Matrix bcsr_alloc(Arena *arena, u32 row_count, u32 col_count, u32 block_rows, u32 block_cols,
+                       u32 block_count)
+{
+  u32 block_row_count = (row_count + block_rows - 1) / block_rows;
+  u32 block_col_count = (col_count + block_cols - 1) / block_cols;
+
+  u64 pointers_size = format_section_size(sizeof(u32) * ((u64)block_row_count + 1));
+  u64 indices_size  = format_section_size(sizeof(u32) * (u64)block_count);
+  u64 values_size   = format_section_size(sizeof(f64) * (u64)block_count * block_rows * block_cols);
+
+  u8 *block = format_block_alloc(arena, pointers_size + indices_size + values_size);
+
+  BCSR_Matrix result =
+  {
+    .block_count        = block_count,
+    .row_count          = row_count,
+    .col_count          = col_count,
+    .block_rows         = block_rows,
+    .block_cols         = block_cols,
+    .block_row_count    = block_row_count,
+    .block_col_count    = block_col_count,
+    .block_row_pointers = (u32 *)block,
+    .block_col_indices  = (u32 *)(block + pointers_size),
+    .values             = (f64 *)(block + pointers_size + indices_size),
+  };
+
+  return result;
+}
+
+static
+CSR_Matrix csr_copy(Arena *arena, CSR_Matrix *csr)
+{
+  CSR_Matrix result = csr_alloc(arena, csr->row_count, csr->col_count, csr->non_zero_count);
+
+  MEM_COPY(result.row_pointers, csr->row_pointers, sizeof(u32) * ((usize)csr->row_count + 1));
+  MEM_COPY(result.col_indices,  csr->col_indices,  sizeof(u32) * (usize)csr->non_zero_count);
+  MEM_COPY(result.values,       csr->values,       sizeof(f64) * (usize)csr->non_zero_count);
+
+  return result;
+}
+
 static
 u64 dense_non_zero_count(Dense_Matrix *dense)
 {
@@ -21,13 +134,7 @@ u64 dense_non_zero_count(Dense_Matrix *dense)
 static
 CSR_Matrix csr_from_dense(Arena *arena, Dense_Matrix *dense)
 {
-  CSR_Matrix result = {0};
-  result.non_zero_count = dense_non_zero_count(dense);
-  result.row_count = dense->row_count;
-
-  result.values       = arena_calloc(arena, result.non_zero_count, f64);
-  result.col_indices  = arena_calloc(arena, result.non_zero_count, u32);
-  result.row_pointers = arena_calloc(arena, result.row_count + 1, u32);
+  CSR_Matrix result = csr_alloc(arena, dense->row_count, dense->col_count, dense_non_zero_count(dense));
 
   isize non_zero_index = 0;
   for (isize r = 0; r < dense->row_count; r++)
@@ -54,13 +161,7 @@ CSR_Matrix csr_from_dense(Arena *arena, Dense_Matrix *dense)
 static
 CSC_Matrix csc_from_dense(Arena *arena, Dense_Matrix *dense)
 {
-  CSC_Matrix result = {0};
-  result.non_zero_count = dense_non_zero_count(dense);
-  result.col_count = dense->col_count;
-
-  result.values       = arena_calloc(arena, result.non_zero_count, f64);
-  result.row_indices  = arena_calloc(arena, result.non_zero_count, u32);
-  result.col_pointers = arena_calloc(arena, result.col_count + 1, u32);
+  CSC_Matrix result = csc_alloc(arena, dense->row_count, dense->col_count, dense_non_zero_count(dense));
 
   isize non_zero_index = 0;
   for (isize c = 0; c < dense->col_count; c++)
@@ -84,32 +185,670 @@ CSC_Matrix csc_from_dense(Arena *arena, Dense_Matrix *dense)
   return result;
 }
 
-#include <stdlib.h>
+// The block row's rows are each sorted, so merging them gives its block columns in order. Just
+// counts them if out_block_cols is NULL
+static
+u32 bcsr_merge_block_row(CSR_Matrix *csr, u32 block_row, u32 block_rows, u32 block_cols,
+                         u32 *out_block_cols, f64 *out_values)
+{
+  u32 cursors[BCSR_MAX_BLOCK_SIZE];
+  u32 ends[BCSR_MAX_BLOCK_SIZE];
+
+  u32 row_begin = block_row * block_rows;
+  u32 row_count = MIN(block_rows, csr->row_count - row_begin);
+
+  for (u32 r = 0; r < row_count; r++)
+  {
+    cursors[r] = csr->row_pointers[row_begin + r];
+    ends[r]    = csr->row_pointers[row_begin + r + 1];
+  }
+
+  u32 result = 0;
+  while (true)
+  {
+    u32 next_block_col = (u32)-1;
+    for (u32 r = 0; r < row_count; r++)
+    {
+      if (cursors[r] < ends[r])
+      {
+        next_block_col = MIN(next_block_col, csr->col_indices[cursors[r]] / block_cols);
+      }
+    }
+
+    if (next_block_col == (u32)-1)
+    {
+      break;
+    }
+
+    // Take everything each row has in this block
+    for (u32 r = 0; r < row_count; r++)
+    {
+      while (cursors[r] < ends[r] && csr->col_indices[cursors[r]] / block_cols == next_block_col)
+      {
+        if (out_block_cols)
+        {
+          u32 c = csr->col_indices[cursors[r]] % block_cols;
+          out_values[(u64)result * block_rows * block_cols + r * block_cols + c] = csr->values[cursors[r]];
+        }
+
+        cursors[r] += 1;
+      }
+    }
+
+    if (out_block_cols)
+    {
+      out_block_cols[result] = next_block_col;
+    }
+
+    result += 1;
+  }
+
+  return result;
+}
 
 static
-Dense_Matrix make_random_dense_matrix(Arena *arena, u32 row_count, u32 col_count, f64 density)
+BCSR_Matrix bcsr_from_csr(Arena *arena, CSR_Matrix *csr, u32 block_rows, u32 block_cols)
 {
-  Dense_Matrix result =
+  u32 block_row_count = (csr->row_count + block_rows - 1) / block_rows;
+
+  // Sized in a first pass so it lands in one packed block like the other formats
+  u64 block_count = 0;
+  for (u32 block_row = 0; block_row < block_row_count; block_row++)
+  {
+    block_count += bcsr_merge_block_row(csr, block_row, block_rows, block_cols, NULL, NULL);
+  }
+
+  BCSR_Matrix result = bcsr_alloc(arena, csr->row_count, csr->col_count, block_rows, block_cols, block_count);
+  result.non_zero_count = csr->non_zero_count;
+
+  for (u32 block_row = 0; block_row < block_row_count; block_row++)
+  {
+    u32 start = result.block_row_pointers[block_row];
+    u32 count = bcsr_merge_block_row(csr, block_row, block_rows, block_cols,
+                                     result.block_col_indices + start,
+                                     result.values + (u64)start * block_rows * block_cols);
+
+    result.block_row_pointers[block_row + 1] = start + count;
+  }
+
+  return result;
+}
+
+static
+f64 bcsr_fill_ratio(BCSR_Matrix *bcsr)
+{
+  f64 stored = (f64)bcsr->block_count * bcsr->block_rows * bcsr->block_cols;
+
+  return bcsr->non_zero_count ? stored / bcsr->non_zero_count : 1.0;
+}
+
+// Shared by DCSR and DCSC, keeps only the majors with something in them. Packed like the rest
+static
+void doubly_compress(Arena *arena, u32 *pointers, u32 major_count, u32 *minors, f64 *values, u32 non_zero_count,
+                     u32 *out_non_empty_count, u32 **out_ids, u32 **out_pointers, u32 **out_minors, f64 **out_values)
+{
+  u32 non_empty_count = 0;
+  for (u32 major = 0; major < major_count; major++)
   {
-    .row_count = row_count,
-    .col_count = col_count,
-    .values = arena_calloc(arena, row_count * col_count, f64),
+    non_empty_count += pointers[major + 1] != pointers[major];
+  }
+
+  u64 ids_size      = format_section_size(sizeof(u32) * (u64)non_empty_count);
+  u64 pointers_size = format_section_size(sizeof(u32) * ((u64)non_empty_count + 1));
+  u64 minors_size   = format_section_size(sizeof(u32) * (u64)non_zero_count);
+  u64 values_size   = format_section_size(sizeof(f64) * (u64)non_zero_count);
+
+  u8 *block = format_block_alloc(arena, ids_size + pointers_size + minors_size + values_size);
+
+  u32 *ids        = (u32 *)block;
+  u32 *compressed = (u32 *)(block + ids_size);
+  u32 *out_minor  = (u32 *)(block + ids_size + pointers_size);
+  f64 *out_value  = (f64 *)(block + ids_size + pointers_size + minors_size);
+
+  u32 non_empty_index = 0;
+  for (u32 major = 0; major < major_count; major++)
+  {
+    if (pointers[major + 1] != pointers[major])
+    {
+      ids[non_empty_index] = major;
+      compressed[non_empty_index + 1] = pointers[major + 1];
+      non_empty_index += 1;
+    }
+  }
+
+  // The non zeros themselves are in the same order, the empty majors just held none of them
+  MEM_COPY(out_minor, minors, sizeof(u32) * (usize)non_zero_count);
+  MEM_COPY(out_value, values, sizeof(f64) * (usize)non_zero_count);
+
+  *out_non_empty_count = non_empty_count;
+  *out_ids      = ids;
+  *out_pointers = compressed;
+  *out_minors   = out_minor;
+  *out_values   = out_value;
+}
+
+static
+DCSR_Matrix dcsr_from_csr(Arena *arena, CSR_Matrix *csr)
+{
+  DCSR_Matrix result =
+  {
+    .non_zero_count = csr->non_zero_count,
+    .row_count      = csr->row_count,
+    .col_count      = csr->col_count,
   };
 
-  for (u32 r = 0; r < row_count; r++)
+  doubly_compress(arena, csr->row_pointers, csr->row_count, csr->col_indices, csr->values, csr->non_zero_count,
+                  &result.non_empty_row_count, &result.row_ids, &result.row_pointers,
+                  &result.col_indices, &result.values);
+
+  return result;
+}
+
+static
+DCSC_Matrix dcsc_from_csc(Arena *arena, CSC_Matrix *csc)
+{
+  DCSC_Matrix result =
+  {
+    .non_zero_count = csc->non_zero_count,
+    .row_count      = csc->row_count,
+    .col_count      = csc->col_count,
+  };
+
+  doubly_compress(arena, csc->col_pointers, csc->col_count, csc->row_indices, csc->values, csc->non_zero_count,
+                  &result.non_empty_col_count, &result.col_ids, &result.col_pointers,
+                  &result.row_indices, &result.values);
+
+  return result;
+}
+
+static
+COO_Matrix coo_from_csr(Arena *arena, CSR_Matrix *csr)
+{
+  u64 indices_size = format_section_size(sizeof(u32) * (u64)csr->non_zero_count);
+  u64 values_size  = format_section_size(sizeof(f64) * (u64)csr->non_zero_count);
+
+  u8 *block = format_block_alloc(arena, 2 * indices_size + values_size);
+
+  COO_Matrix result =
+  {
+    .non_zero_count = csr->non_zero_count,
+    .row_count      = csr->row_count,
+    .col_count      = csr->col_count,
+    .row_indices    = (u32 *)block,
+    .col_indices    = (u32 *)(block + indices_size),
+    .values         = (f64 *)(block + 2 * indices_size),
+  };
+
+  expand_pointers(csr->row_pointers, csr->row_count, result.row_indices);
+  MEM_COPY(result.col_indices, csr->col_indices, sizeof(u32) * (usize)csr->non_zero_count);
+  MEM_COPY(result.values,      csr->values,      sizeof(f64) * (usize)csr->non_zero_count);
+
+  return result;
+}
+
+typedef struct SELL_Row SELL_Row;
+struct SELL_Row
+{
+  u32 length;
+  u32 row;
+};
+
+// Longest first, ties by row so the order doesn't depend on qsort
+static
+int sell_row_compare(const void *a, const void *b)
+{
+  const SELL_Row *row_a = a;
+  const SELL_Row *row_b = b;
+
+  int result = row_a->length != row_b->length ? (row_a->length < row_b->length ? 1 : -1)
+                                              : (row_a->row > row_b->row) - (row_a->row < row_b->row);
+
+  return result;
+}
+
+static
+SELL_Matrix sell_from_csr(Arena *arena, CSR_Matrix *csr, u32 sort_window)
+{
+  u32 chunk_count = (csr->row_count + SELL_CHUNK_HEIGHT - 1) / SELL_CHUNK_HEIGHT;
+  u32 lane_count  = chunk_count * SELL_CHUNK_HEIGHT;
+
+  sort_window = MAX(sort_window, 1);
+  if (sort_window > 1)
+  {
+    sort_window = (sort_window + SELL_CHUNK_HEIGHT - 1) / SELL_CHUNK_HEIGHT * SELL_CHUNK_HEIGHT;
+  }
+
+  SELL_Row *order = arena_calloc(arena, lane_count, SELL_Row);
+  for (u32 lane = 0; lane < lane_count; lane++)
   {
-    for (u32 c = 0; c < col_count; c++)
+    order[lane].row    = lane;
+    order[lane].length = lane < csr->row_count ? csr->row_pointers[lane + 1] - csr->row_pointers[lane] : 0;
+  }
+
+  // Sorting within a window keeps rows of similar length in the same chunk, so less padding.
+  // Padding lanes are length 0 so they sink to the end of the last window
+  if (sort_window > 1)
+  {
+    for (u32 window_start = 0; window_start < lane_count; window_start += sort_window)
     {
-      f64 check = (f64)rand() / RAND_MAX;
+      u32 window_count = MIN(sort_window, lane_count - window_start);
+      qsort(order + window_start, window_count, sizeof(SELL_Row), sell_row_compare);
+    }
+  }
 
-      // We should put a non-zero
-      if (check < density)
+  u64 padded_count = 0;
+  for (u32 chunk = 0; chunk < chunk_count; chunk++)
+  {
+    u32 width = 0;
+    for (u32 lane = 0; lane < SELL_CHUNK_HEIGHT; lane++)
+    {
+      width = MAX(width, order[chunk * SELL_CHUNK_HEIGHT + lane].length);
+    }
+
+    padded_count += (u64)width * SELL_CHUNK_HEIGHT;
+  }
+
+  u64 pointers_size = format_section_size(sizeof(u32) * ((u64)chunk_count + 1));
+  u64 rows_size     = format_section_size(sizeof(u32) * (u64)lane_count);
+  u64 indices_size  = format_section_size(sizeof(u32) * padded_count);
+  u64 values_size   = format_section_size(sizeof(f64) * padded_count);
+
+  u8 *block = format_block_alloc(arena, pointers_size + rows_size + indices_size + values_size);
+
+  SELL_Matrix result =
+  {
+    .non_zero_count = csr->non_zero_count,
+    .padded_count   = (u32)padded_count,
+    .row_count      = csr->row_count,
+    .col_count      = csr->col_count,
+    .sort_window    = sort_window,
+    .chunk_count    = chunk_count,
+    .chunk_pointers = (u32 *)block,
+    .rows           = (u32 *)(block + pointers_size),
+    .col_indices    = (u32 *)(block + pointers_size + rows_size),
+    .values         = (f64 *)(block + pointers_size + rows_size + indices_size),
+  };
+
+  for (u32 chunk = 0; chunk < chunk_count; chunk++)
+  {
+    u32 start = result.chunk_pointers[chunk];
+    u32 width = 0;
+
+    for (u32 lane = 0; lane < SELL_CHUNK_HEIGHT; lane++)
+    {
+      SELL_Row *row = order + chunk * SELL_CHUNK_HEIGHT + lane;
+      result.rows[chunk * SELL_CHUNK_HEIGHT + lane] = row->row;
+      width = MAX(width, row->length);
+
+      if (row->row < csr->row_count)
       {
-        f64 value = ((f64)rand() / RAND_MAX) * 2.0 - 1.0;
-        result.values[r * col_count + c] = value;
+        u32 row_start = csr->row_pointers[row->row];
+        for (u32 j = 0; j < row->length; j++)
+        {
+          result.col_indices[start + j * SELL_CHUNK_HEIGHT + lane] = csr->col_indices[row_start + j];
+          result.values[start + j * SELL_CHUNK_HEIGHT + lane]      = csr->values[row_start + j];
+        }
       }
     }
+
+    result.chunk_pointers[chunk + 1] = start + width * SELL_CHUNK_HEIGHT;
+  }
+
+  return result;
+}
+
+static
+Dense_Matrix dense_from_csr(Arena *arena, CSR_Matrix *csr)
+{
+  Dense_Matrix result =
+  {
+    .row_count = csr->row_count,
+    .col_count = csr->col_count,
+    .values = arena_calloc(arena, (usize)csr->row_count * csr->col_count, f64),
+  };
+
+  for (usize r = 0; r < csr->row_count; r++)
+  {
+    for (usize i = csr->row_pointers[r]; i < csr->row_pointers[r + 1]; i++)
+    {
+      result.values[r * result.col_count + csr->col_indices[i]] = csr->values[i];
+    }
+  }
+
+  return result;
+}
+
+static
+bf16 bf16_from_f64(f64 value)
+{
+  f32 single = (f32)value;
+
+  u32 bits = 0;
+  MEM_COPY(&bits, &single, sizeof(bits));
+
+  // Carries into the exponent when it should, no NaNs or infinities come through here
+  bits += 0x7fff + ((bits >> 16) & 1);
+
+  return (bf16)(bits >> 16);
+}
+
+static
+f32 f32_from_bf16(bf16 value)
+{
+  u32 bits = (u32)value << 16;
+
+  f32 result = 0.0f;
+  MEM_COPY(&result, &bits, sizeof(result));
+
+  return result;
+}
+
+#define COMPACT_KEEP_F64(value) (value)
+#define COMPACT_TO_F32(value)   ((f32)(value))
+
+#define COMPACT_CSR_FROM_CSR(Name, function, Value, Index, convert)                            \
+static                                                                                         \
+Name function(Arena *arena, CSR_Matrix *csr)                                                   \
+{                                                                                              \
+  u64 pointers_size = format_section_size(sizeof(u32) * ((u64)csr->row_count + 1));            \
+  u64 indices_size  = format_section_size(sizeof(Index) * (u64)csr->non_zero_count);           \
+  u64 values_size   = format_section_size(sizeof(Value) * (u64)csr->non_zero_count);           \
+                                                                                               \
+  u8 *block = format_block_alloc(arena, pointers_size + indices_size + values_size);           \
+                                                                                               \
+  Name result =                                                                                \
+  {                                                                                            \
+    .non_zero_count = csr->non_zero_count,                                                     \
+    .row_count      = csr->row_count,                                                          \
+    .col_count      = csr->col_count,                                                          \
+    .row_pointers   = (u32 *)block,                                                            \
+    .col_indices    = (Index *)(block + pointers_size),                                        \
+    .values         = (Value *)(block + pointers_size + indices_size),                         \
+  };                                                                                           \
+                                                                                               \
+  MEM_COPY(result.row_pointers, csr->row_pointers, sizeof(u32) * ((u64)csr->row_count + 1));   \
+                                                                                               \
+  for (u64 i = 0; i < csr->non_zero_count; i++)                                                \
+  {                                                                                            \
+    result.col_indices[i] = (Index)csr->col_indices[i];                                        \
+    result.values[i]      = convert(csr->values[i]);                                           \
+  }                                                                                            \
+                                                                                               \
+  return result;                                                                               \
+}
+
+COMPACT_CSR_FROM_CSR(CSR_F32_Matrix,     csr_f32_from_csr,     f32,  u32, COMPACT_TO_F32)
+COMPACT_CSR_FROM_CSR(CSR_BF16_Matrix,    csr_bf16_from_csr,    bf16, u32, bf16_from_f64)
+COMPACT_CSR_FROM_CSR(CSR_U16_Matrix,     csr_u16_from_csr,     f64,  u16, COMPACT_KEEP_F64)
+COMPACT_CSR_FROM_CSR(CSR_F32_U16_Matrix, csr_f32_u16_from_csr, f32,  u16, COMPACT_TO_F32)
+
+#define COMPACT_DENSE_FROM_DENSE(Name, function, Value, convert)                        \
+static                                                                                  \
+Name function(Arena *arena, Dense_Matrix *dense)                                        \
+{                                                                                       \
+  usize count = (usize)dense->row_count * dense->col_count;                             \
+                                                                                        \
+  Name result =                                                                         \
+  {                                                                                     \
+    .row_count = dense->row_count,                                                      \
+    .col_count = dense->col_count,                                                      \
+    .values = arena_calloc(arena, count, Value),                                        \
+  };                                                                                    \
+                                                                                        \
+  for (usize i = 0; i < count; i++)                                                     \
+  {                                                                                     \
+    result.values[i] = convert(dense->values[i]);                                       \
+  }                                                                                     \
+                                                                                        \
+  return result;                                                                        \
+}
+
+COMPACT_DENSE_FROM_DENSE(Dense_F32_Matrix,  dense_f32_from_dense,  f32,  COMPACT_TO_F32)
+COMPACT_DENSE_FROM_DENSE(Dense_BF16_Matrix, dense_bf16_from_dense, bf16, bf16_from_f64)
+
+// Stable counting sort of (major, minor, value) triplets by major index, so a CSR if major is the
+// row and a CSC if it's the column. out_pointers needs to be zeroed, with major_count + 1 of them
+static
+void compress_triplets(u64 count, u32 *majors, u32 *minors, f64 *values,
+                       u32 major_count, u32 *out_pointers, u32 *out_minors, f64 *out_values)
+{
+  for (u64 i = 0; i < count; i++)
+  {
+    out_pointers[majors[i] + 1] += 1;
+  }
+
+  for (u32 major = 0; major < major_count; major++)
+  {
+    out_pointers[major + 1] += out_pointers[major];
+  }
+
+  // Use each major's start as its write cursor, which leaves it pointing at the next one's start
+  for (u64 i = 0; i < count; i++)
+  {
+    u32 destination = out_pointers[majors[i]]++;
+
+    out_minors[destination] = minors[i];
+    out_values[destination] = values[i];
+  }
+
+  // So shift them all back one
+  for (u32 major = major_count; major > 0; major--)
+  {
+    out_pointers[major] = out_pointers[major - 1];
+  }
+  out_pointers[0] = 0;
+}
+
+// Inverse of the compression, the major index of every non zero
+static
+void expand_pointers(u32 *pointers, u32 major_count, u32 *out_majors)
+{
+  for (u32 major = 0; major < major_count; major++)
+  {
+    for (u32 i = pointers[major]; i < pointers[major + 1]; i++)
+    {
+      out_majors[i] = major;
+    }
   }
+}
+
+// First major whose start is at or past the non zero index, ie a lower bound on the pointers.
+// Used to split majors into ranges with about the same number of non zeros
+static
+u32 pointers_lower_bound(u32 *pointers, u32 major_count, u64 non_zero_index)
+{
+  u32 low  = 0;
+  u32 high = major_count;
+
+  while (low < high)
+  {
+    u32 middle = low + (high - low) / 2;
+
+    if (pointers[middle] < non_zero_index)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+static
+u32 csr_row_for_non_zero(CSR_Matrix *csr, u64 non_zero_index)
+{
+  return pointers_lower_bound(csr->row_pointers, csr->row_count, non_zero_index);
+}
+
+typedef struct Transpose Transpose;
+struct Transpose
+{
+  u32 major_count;
+  u32 minor_count;
+  u64 non_zero_count;
+
+  u32 *pointers;
+  u32 *minors;
+  f64 *values;
+
+  u32 *out_pointers;
+  u32 *out_minors;
+  f64 *out_values;
+
+  // Per task, how many of each minor it has. Then where its first one of each goes, relative to
+  // that minor's start, and then the write cursors
+  u32 *task_counts;
+  u32  task_count;
+};
+
+// Majors split so each task gets about the same number of non zeros
+static
+void transpose_major_range(Transpose *transpose, u32 task_index, u32 *out_begin, u32 *out_end)
+{
+  u64 non_zero_begin = transpose->non_zero_count * task_index / transpose->task_count;
+  u64 non_zero_end   = transpose->non_zero_count * (task_index + 1) / transpose->task_count;
+
+  *out_begin = task_index == 0 ? 0 : pointers_lower_bound(transpose->pointers, transpose->major_count, non_zero_begin);
+  *out_end   = task_index + 1 == transpose->task_count ? transpose->major_count
+                                                       : pointers_lower_bound(transpose->pointers, transpose->major_count, non_zero_end);
+}
+
+static
+void transpose_count_task(void *user, u32 task_index, u32 task_count)
+{
+  Transpose *transpose = user;
+  u32 *counts = transpose->task_counts + (usize)task_index * transpose->minor_count;
+
+  u32 major_begin, major_end;
+  transpose_major_range(transpose, task_index, &major_begin, &major_end);
+
+  for (u32 i = transpose->pointers[major_begin]; i < transpose->pointers[major_end]; i++)
+  {
+    counts[transpose->minors[i]] += 1;
+  }
+}
+
+// Split over minors this time, scans each minor's counts across the tasks
+static
+void transpose_offset_task(void *user, u32 task_index, u32 task_count)
+{
+  Transpose *transpose = user;
+
+  u32 minor_begin = (u32)((u64)transpose->minor_count * task_index / task_count);
+  u32 minor_end   = (u32)((u64)transpose->minor_count * (task_index + 1) / task_count);
+
+  for (u32 minor = minor_begin; minor < minor_end; minor++)
+  {
+    u32 running = 0;
+    for (u32 task = 0; task < transpose->task_count; task++)
+    {
+      u32 *count = transpose->task_counts + (usize)task * transpose->minor_count + minor;
+      u32 task_minor_count = *count;
+
+      *count = running;
+      running += task_minor_count;
+    }
+
+    // Prefix summed after
+    transpose->out_pointers[minor + 1] = running;
+  }
+}
+
+// Tasks own increasing majors and walk them in order, so each output major comes out sorted
+static
+void transpose_scatter_task(void *user, u32 task_index, u32 task_count)
+{
+  Transpose *transpose = user;
+  u32 *cursors = transpose->task_counts + (usize)task_index * transpose->minor_count;
+
+  u32 major_begin, major_end;
+  transpose_major_range(transpose, task_index, &major_begin, &major_end);
+
+  for (u32 major = major_begin; major < major_end; major++)
+  {
+    for (u32 i = transpose->pointers[major]; i < transpose->pointers[major + 1]; i++)
+    {
+      u32 minor = transpose->minors[i];
+      u32 destination = transpose->out_pointers[minor] + cursors[minor]++;
+
+      transpose->out_minors[destination] = major;
+      transpose->out_values[destination] = transpose->values[i];
+    }
+  }
+}
+
+// Counting sort by minor, like compress_triplets() but in parallel and without expanding the
+// majors first. Works for either direction, CSR's minors are columns and CSC's are rows
+static
+void transpose_compressed(Arena *arena, Thread_Pool *pool, Transpose *transpose)
+{
+  // Every task costs a full set of minor counts, so only use as many as there are threads, and
+  // only when there's enough work to split
+  u64 task_count = MIN(MAX(transpose->non_zero_count / TRANSPOSE_MIN_TASK_NON_ZEROS, 1), pool->worker_count + 1);
+
+  transpose->task_count  = (u32)task_count;
+  transpose->task_counts = arena_calloc(arena, (usize)task_count * transpose->minor_count, u32);
+
+  thread_pool_dispatch(pool, transpose->task_count, transpose_count_task, transpose);
+  thread_pool_dispatch(pool, transpose->task_count, transpose_offset_task, transpose);
+
+  for (u32 minor = 0; minor < transpose->minor_count; minor++)
+  {
+    transpose->out_pointers[minor + 1] += transpose->out_pointers[minor];
+  }
+
+  thread_pool_dispatch(pool, transpose->task_count, transpose_scatter_task, transpose);
+}
+
+static
+CSC_Matrix csc_from_csr(Arena *arena, Thread_Pool *pool, CSR_Matrix *csr)
+{
+  CSC_Matrix result = csc_alloc(arena, csr->row_count, csr->col_count, csr->non_zero_count);
+
+  Transpose transpose =
+  {
+    .major_count    = csr->row_count,
+    .minor_count    = csr->col_count,
+    .non_zero_count = csr->non_zero_count,
+
+    .pointers = csr->row_pointers,
+    .minors   = csr->col_indices,
+    .values   = csr->values,
+
+    .out_pointers = result.col_pointers,
+    .out_minors   = result.row_indices,
+    .out_values   = result.values,
+  };
+
+  transpose_compressed(arena, pool, &transpose);
+
+  return result;
+}
+
+static
+CSR_Matrix csr_from_csc(Arena *arena, Thread_Pool *pool, CSC_Matrix *csc)
+{
+  CSR_Matrix result = csr_alloc(arena, csc->row_count, csc->col_count, csc->non_zero_count);
+
+  Transpose transpose =
+  {
+    .major_count    = csc->col_count,
+    .minor_count    = csc->row_count,
+    .non_zero_count = csc->non_zero_count,
+
+    .pointers = csc->col_pointers,
+    .minors   = csc->row_indices,
+    .values   = csc->values,
+
+    .out_pointers = result.row_pointers,
+    .out_minors   = result.col_indices,
+    .out_values   = result.values,
+  };
+
+  transpose_compressed(arena, pool, &transpose);
 
   return result;
 }
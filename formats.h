@@ -2,6 +2,7 @@
 #define FORMATS_H
 
 #include "../common.h"
+#include "threads.h"
 
 // Row major
 typedef struct Dense_Matrix Dense_Matrix;
@@ -17,8 +18,9 @@ struct CSR_Matrix
 {
   u32 non_zero_count;
   u32 row_count;
+  u32 col_count;
 
-  // Hmm, might be better to have just one buffer and relative pointers
+  // Usually all in one packed block, see csr_alloc()
   u32 *row_pointers;
   u32 *col_indices;
   f64 *values;
@@ -28,14 +30,143 @@ typedef struct CSC_Matrix CSC_Matrix;
 struct CSC_Matrix
 {
   u32 non_zero_count;
+  u32 row_count;
   u32 col_count;
 
-  // Hmm, might be better to have just one buffer and relative pointers
+  // Usually all in one packed block, see csc_alloc()
   u32 *row_indices;
   u32 *col_pointers;
   f64 *values;
 };
 
+// Doubly compressed, pointers only for rows that have something in them. For hypersparse
+// matrices where row_pointers would be mostly repeats
+typedef struct DCSR_Matrix DCSR_Matrix;
+struct DCSR_Matrix
+{
+  u32 non_zero_count;
+  u32 row_count;
+  u32 col_count;
+  u32 non_empty_row_count;
+
+  u32 *row_ids;      // non_empty_row_count, ascending
+  u32 *row_pointers; // non_empty_row_count + 1
+  u32 *col_indices;
+  f64 *values;
+};
+
+typedef struct DCSC_Matrix DCSC_Matrix;
+struct DCSC_Matrix
+{
+  u32 non_zero_count;
+  u32 row_count;
+  u32 col_count;
+  u32 non_empty_col_count;
+
+  u32 *col_ids;      // non_empty_col_count, ascending
+  u32 *col_pointers; // non_empty_col_count + 1
+  u32 *row_indices;
+  f64 *values;
+};
+
+// Plain triplets, sorted by row then column
+typedef struct COO_Matrix COO_Matrix;
+struct COO_Matrix
+{
+  u32 non_zero_count;
+  u32 row_count;
+  u32 col_count;
+
+  u32 *row_indices;
+  u32 *col_indices;
+  f64 *values;
+};
+
+// Dense r x c blocks, so one column index covers r * c values. Blocks are row major inside and
+// zero padded wherever they hang off the edge of the matrix, or wherever the pattern has a hole
+typedef struct BCSR_Matrix BCSR_Matrix;
+struct BCSR_Matrix
+{
+  u32 non_zero_count; // Of the CSR it came from, not counting the padding
+  u32 block_count;
+  u32 row_count;
+  u32 col_count;
+
+  u32 block_rows;
+  u32 block_cols;
+  u32 block_row_count;
+  u32 block_col_count;
+
+  u32 *block_row_pointers;
+  u32 *block_col_indices;
+  f64 *values; // block_count * block_rows * block_cols
+};
+
+// Plenty for the shapes worth trying, and keeps the conversion's per row cursors on the stack
+#define BCSR_MAX_BLOCK_SIZE 8
+
+// SELL-C-sigma. Rows sorted by length within windows of sort_window rows, then packed in chunks
+// of SELL_CHUNK_HEIGHT, each padded to its longest row and stored column major. So entry j of
+// every row in a chunk sits side by side, one vector's worth of rows at a time
+typedef struct SELL_Matrix SELL_Matrix;
+struct SELL_Matrix
+{
+  u32 non_zero_count;
+  u32 padded_count; // Slots stored, padding included
+  u32 row_count;
+  u32 col_count;
+
+  u32 sort_window;
+  u32 chunk_count;
+
+  u32 *chunk_pointers; // chunk_count + 1, chunk width is the difference / SELL_CHUNK_HEIGHT
+  u32 *rows;           // Original row of each chunk lane, lanes past row_count are padding
+  u32 *col_indices;    // Padding is column 0 with a 0.0 value, so it can be multiplied blindly
+  f64 *values;
+};
+
+// One AVX-512 register of f64 lanes
+#define SELL_CHUNK_HEIGHT 8
+
+#define SELL_DEFAULT_SORT_WINDOW (32 * SELL_CHUNK_HEIGHT)
+
+// The same CSR stored narrower, since the sparse kernels are bound on bytes rather than flops.
+// f32 or bf16 values, and u16 column indices when there are at most COMPACT_INDEX_LIMIT columns.
+// bf16 is kept as raw bits, the top half of an f32
+typedef u16 bf16;
+
+#define COMPACT_INDEX_LIMIT (1u << 16)
+
+#define COMPACT_CSR_MATRIX(Name, Value, Index) \
+typedef struct Name Name;                      \
+struct Name                                    \
+{                                              \
+  u32 non_zero_count;                          \
+  u32 row_count;                               \
+  u32 col_count;                               \
+                                               \
+  u32   *row_pointers;                         \
+  Index *col_indices;                          \
+  Value *values;                               \
+};
+
+COMPACT_CSR_MATRIX(CSR_F32_Matrix,     f32,  u32)
+COMPACT_CSR_MATRIX(CSR_BF16_Matrix,    bf16, u32)
+COMPACT_CSR_MATRIX(CSR_U16_Matrix,     f64,  u16)
+COMPACT_CSR_MATRIX(CSR_F32_U16_Matrix, f32,  u16)
+
+#define COMPACT_DENSE_MATRIX(Name, Value) \
+typedef struct Name Name;                 \
+struct Name                               \
+{                                         \
+  u32 row_count;                          \
+  u32 col_count;                          \
+  Value *values;                          \
+};
+
+COMPACT_DENSE_MATRIX(Dense_F32_Matrix,  f32)
+COMPACT_DENSE_MATRIX(Dense_BF16_Matrix, bf16)
+
 typedef enum Matrix_Format
 {
   MAT_NONE,
@@ -43,6 +174,11 @@ typedef enum Matrix_Format
   MAT_DENSE,
   MAT_CSR,
   MAT_CSC,
+  MAT_BCSR,
+  MAT_SELL,
+  MAT_DCSR,
+  MAT_DCSC,
+  MAT_COO,
 
   MAT_COUNT,
 } Matrix_Format;
@@ -60,6 +196,15 @@ typedef enum Matrix_Format_Combo
   MAT_COMBO_CSC_DENSE,
   MAT_COMBO_CSC_CSR,
   MAT_COMBO_CSC_CSC,
+  MAT_COMBO_BCSR_DENSE,
+  MAT_COMBO_BCSR_BCSR,
+  MAT_COMBO_SELL_DENSE,
+  MAT_COMBO_DCSR_DENSE,
+  MAT_COMBO_DCSR_CSR,
+  MAT_COMBO_DCSC_DENSE,
+  MAT_COMBO_DCSC_CSR,
+  MAT_COMBO_COO_DENSE,
+  MAT_COMBO_COO_CSR,
 
   MAT_COMBO_COUNT,
 } Matrix_Format_Combo;
@@ -73,20 +218,60 @@ struct Matrix_Union
     Dense_Matrix dense;
     CSR_Matrix   csr;
     CSC_Matrix   csc;
+    BCSR_Matrix  bcsr;
+    SELL_Matrix  sell;
+    DCSR_Matrix  dcsr;
+    DCSC_Matrix  dcsc;
+    COO_Matrix   coo;
   };
 };
 
-// Not a union, stores all 3
+// Not a union, stores all of them. Though dense may be left empty until something needs it
 typedef struct Matrix_Reps Matrix_Reps;
 struct Matrix_Reps
 {
   Dense_Matrix dense;
   CSR_Matrix   csr;
   CSC_Matrix   csc;
+  BCSR_Matrix  bcsr;
+  SELL_Matrix  sell;
+  DCSR_Matrix  dcsr;
+  DCSC_Matrix  dcsc;
+  COO_Matrix   coo;
+
+  // Narrow copies for the reduced precision kernels. The u16 ones stay empty if there are too
+  // many columns for them
+  CSR_F32_Matrix     csr_f32;
+  CSR_BF16_Matrix    csr_bf16;
+  CSR_U16_Matrix     csr_u16;
+  CSR_F32_U16_Matrix csr_f32_u16;
+  Dense_F32_Matrix   dense_f32;
+  Dense_BF16_Matrix  dense_bf16;
 };
 
+// Every section of a packed matrix starts on its own cache line. Not pages, so the streams a
+// kernel walks together don't all alias the same cache sets
+#define FORMAT_SECTION_ALIGNMENT 64
+
+// Blocks at least this big start on a transparent huge page and are advised as such, so walking
+// one takes a handful of TLB entries instead of one every 4KB
+#define FORMAT_HUGE_PAGE_SIZE MB(2)
+
+// One zeroed block holding pointers, indices and values, in that order. The structs still just
+// point into it, kernels don't know or care which layout they're handed
+static
+CSR_Matrix csr_alloc(Arena *arena, u32 row_count, u32 col_count, u32 non_zero_count);
+
+static
+CSC_Matrix csc_alloc(Arena *arena, u32 row_count, u32 col_count, u32 non_zero_count);
+
+// Into a packed block, whatever the source's layout was
 static
-Dense_Matrix make_random_dense_matrix(Arena *arena, u32 row_count, u32 col_count, f64 density);
+CSR_Matrix csr_copy(Arena *arena, CSR_Matrix *csr);
+
+static
+BCSR_Matrix bcsr_alloc(Arena *arena, u32 row_count, u32 col_count, u32 block_rows, u32 block_cols,
+                       u32 block_count);
 
 static
 CSR_Matrix csr_from_dense(Arena *arena, Dense_Matrix *dense);
@@ -94,4 +279,74 @@ CSR_Matrix csr_from_dense(Arena *arena, Dense_Matrix *dense);
 static
 CSC_Matrix csc_from_dense(Arena *arena, Dense_Matrix *dense);
 
+// Below this many non zeros per thread a transpose isn't worth splitting
+#define TRANSPOSE_MIN_TASK_NON_ZEROS KB(64)
+
+// O(non zeros) transposes on the pool, indices come out sorted within each row/column
+static
+CSC_Matrix csc_from_csr(Arena *arena, Thread_Pool *pool, CSR_Matrix *csr);
+
+static
+CSR_Matrix csr_from_csc(Arena *arena, Thread_Pool *pool, CSC_Matrix *csc);
+
+// Needs each row's columns sorted, which every CSR built here has
+static
+BCSR_Matrix bcsr_from_csr(Arena *arena, CSR_Matrix *csr, u32 block_rows, u32 block_cols);
+
+// Values stored per actual non zero, 1.0 if the blocks are completely full
+static
+f64 bcsr_fill_ratio(BCSR_Matrix *bcsr);
+
+// sort_window gets rounded up to a whole number of chunks, 1 means no sorting at all
+static
+SELL_Matrix sell_from_csr(Arena *arena, CSR_Matrix *csr, u32 sort_window);
+
+static
+DCSR_Matrix dcsr_from_csr(Arena *arena, CSR_Matrix *csr);
+
+static
+DCSC_Matrix dcsc_from_csc(Arena *arena, CSC_Matrix *csc);
+
+static
+COO_Matrix coo_from_csr(Arena *arena, CSR_Matrix *csr);
+
+static
+Dense_Matrix dense_from_csr(Arena *arena, CSR_Matrix *csr);
+
+// Round to nearest even
+static
+bf16 bf16_from_f64(f64 value);
+
+static
+f32 f32_from_bf16(bf16 value);
+
+// Packed like csr_alloc(). The u16 ones need col_count <= COMPACT_INDEX_LIMIT
+static
+CSR_F32_Matrix csr_f32_from_csr(Arena *arena, CSR_Matrix *csr);
+
+static
+CSR_BF16_Matrix csr_bf16_from_csr(Arena *arena, CSR_Matrix *csr);
+
+static
+CSR_U16_Matrix csr_u16_from_csr(Arena *arena, CSR_Matrix *csr);
+
+static
+CSR_F32_U16_Matrix csr_f32_u16_from_csr(Arena *arena, CSR_Matrix *csr);
+
+static
+Dense_F32_Matrix dense_f32_from_dense(Arena *arena, Dense_Matrix *dense);
+
+static
+Dense_BF16_Matrix dense_bf16_from_dense(Arena *arena, Dense_Matrix *dense);
+
+static
+void compress_triplets(u64 count, u32 *majors, u32 *minors, f64 *values,
+                       u32 major_count, u32 *out_pointers, u32 *out_minors, f64 *out_values);
+
+static
+void expand_pointers(u32 *pointers, u32 major_count, u32 *out_majors);
+
+static
+u32 csr_row_for_non_zero(CSR_Matrix *csr, u64 non_zero_index);
+
 #endif // FORMATS_H
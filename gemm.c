@@ -0,0 +1,130 @@
+#include "gemm.h"
+
+static
+Gemm_Workspace gemm_workspace_make(Arena *arena)
+{
+  Gemm_Workspace result =
+  {
+    .packed_left  = arena_calloc(arena, (usize)GEMM_MC * GEMM_KC, f64),
+    .packed_right = arena_calloc(arena, (usize)GEMM_KC * GEMM_NC, f64),
+  };
+
+  return result;
+}
+
+// Slivers of tile_rows rows, k major within each, so the micro kernel reads them front to back.
+// Rows past the end are packed as zeros and the micro kernel never has to know
+static
+void gemm_pack_left(f64 *packed, f64 *left, usize left_stride, usize row_count, usize depth, u32 tile_rows)
+{
+  for (usize row = 0; row < row_count; row += tile_rows)
+  {
+    usize rows = MIN(tile_rows, row_count - row);
+
+    for (usize k = 0; k < depth; k++)
+    {
+      for (usize r = 0; r < tile_rows; r++)
+      {
+        *packed++ = r < rows ? left[(row + r) * left_stride + k] : 0.0;
+      }
+    }
+  }
+}
+
+// Same for slivers of tile_cols columns
+static
+void gemm_pack_right(f64 *packed, f64 *right, usize right_stride, usize depth, usize col_count, u32 tile_cols)
+{
+  for (usize col = 0; col < col_count; col += tile_cols)
+  {
+    usize cols = MIN(tile_cols, col_count - col);
+
+    for (usize k = 0; k < depth; k++)
+    {
+      f64 *right_row = right + k * right_stride + col;
+
+      for (usize c = 0; c < tile_cols; c++)
+      {
+        *packed++ = c < cols ? right_row[c] : 0.0;
+      }
+    }
+  }
+}
+
+static
+void gemm(Gemm_Workspace *workspace, Dense_Matrix left, Dense_Matrix right, Dense_Matrix output)
+{
+  Simd_Gemm_Kernel kernel = simd_gemm_kernels[simd_level()];
+  usize tile_rows = kernel.tile_rows;
+  usize tile_cols = kernel.tile_cols;
+
+  usize row_count = left.row_count;
+  usize col_count = right.col_count;
+  usize depth     = left.col_count;
+
+  // Nothing to accumulate, but it still has to come out zero
+  if (depth == 0)
+  {
+    MEM_SET(output.values, sizeof(f64) * row_count * col_count, 0);
+    return;
+  }
+
+  // Tiles hanging off the bottom or right edge go here whole, then only the part that exists is copied
+  f64 edge[SIMD_GEMM_MAX_TILE_ROWS * SIMD_GEMM_MAX_TILE_COLS];
+
+  for (usize col_block = 0; col_block < col_count; col_block += GEMM_NC)
+  {
+    usize block_cols = MIN(GEMM_NC, col_count - col_block);
+
+    for (usize k_block = 0; k_block < depth; k_block += GEMM_KC)
+    {
+      usize block_depth = MIN(GEMM_KC, depth - k_block);
+
+      // First slice overwrites, so output needn't be cleared beforehand
+      b32 accumulate = k_block > 0;
+
+      gemm_pack_right(workspace->packed_right, right.values + k_block * right.col_count + col_block,
+                      right.col_count, block_depth, block_cols, tile_cols);
+
+      for (usize row_block = 0; row_block < row_count; row_block += GEMM_MC)
+      {
+        usize block_rows = MIN(GEMM_MC, row_count - row_block);
+
+        gemm_pack_left(workspace->packed_left, left.values + row_block * left.col_count + k_block,
+                       left.col_count, block_rows, block_depth, tile_rows);
+
+        for (usize col = 0; col < block_cols; col += tile_cols)
+        {
+          f64 *right_sliver = workspace->packed_right + col * block_depth;
+          usize cols = MIN(tile_cols, block_cols - col);
+
+          for (usize row = 0; row < block_rows; row += tile_rows)
+          {
+            f64 *left_sliver = workspace->packed_left + row * block_depth;
+            usize rows = MIN(tile_rows, block_rows - row);
+
+            f64 *output_tile = output.values + (row_block + row) * output.col_count + col_block + col;
+
+            if (rows == tile_rows && cols == tile_cols)
+            {
+              kernel.micro(block_depth, left_sliver, right_sliver, output_tile, output.col_count, accumulate);
+            }
+            else
+            {
+              kernel.micro(block_depth, left_sliver, right_sliver, edge, tile_cols, false);
+
+              for (usize r = 0; r < rows; r++)
+              {
+                for (usize c = 0; c < cols; c++)
+                {
+                  f64 *out = output_tile + r * output.col_count + c;
+                  *out = accumulate ? *out + edge[r * tile_cols + c] : edge[r * tile_cols + c];
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
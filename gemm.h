@@ -0,0 +1,35 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "../common.h"
+#include "formats.h"
+#include "simd.h"
+
+// Goto style blocked dense X dense, the baseline the sparse kernels ought to be held against.
+// From the outside in:
+//   GEMM_NC columns of right at a time, packed so the GEMM_KC x GEMM_NC panel sits in L3
+//   GEMM_KC deep slices, so the right sliver one register tile walks (GEMM_KC x NR) stays in L1
+//   GEMM_MC rows of left at a time, packed so the GEMM_MC x GEMM_KC block sits in L2
+//   then MR x NR register tiles, see Simd_Gemm_Micro
+// Sized for a 32-48KB L1 and 1-2MB L2. GEMM_MC has to be a multiple of every level's MR, and
+// GEMM_NC of every NR
+#define GEMM_KC 256
+#define GEMM_MC 96
+#define GEMM_NC 4096
+
+// Packing buffers, made once and reused every call
+typedef struct Gemm_Workspace Gemm_Workspace;
+struct Gemm_Workspace
+{
+  f64 *packed_left;  // GEMM_MC x GEMM_KC
+  f64 *packed_right; // GEMM_KC x GEMM_NC
+};
+
+static
+Gemm_Workspace gemm_workspace_make(Arena *arena);
+
+// output = left X right, overwritten
+static
+void gemm(Gemm_Workspace *workspace, Dense_Matrix left, Dense_Matrix right, Dense_Matrix output);
+
+#endif // GEMM_H
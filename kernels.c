@@ -0,0 +1,2560 @@
+#include "kernels.h"
+
+// Whatever the caller set with spmm_set_tester_hooks(). The tester is only ever handed back
+static Spmm_Tester_Hooks spmm_tester_hooks;
+
+static
+void spmm_tester_begin_time(Repetition_Tester *tester)
+{
+  if (tester && spmm_tester_hooks.begin_time)
+  {
+    spmm_tester_hooks.begin_time(tester);
+  }
+}
+
+static
+void spmm_tester_close_time(Repetition_Tester *tester)
+{
+  if (tester && spmm_tester_hooks.close_time)
+  {
+    spmm_tester_hooks.close_time(tester);
+  }
+}
+
+static
+void spmm_tester_count(Repetition_Tester *tester, u64 flops, u64 memops, u64 bytes)
+{
+  if (tester && spmm_tester_hooks.count)
+  {
+    spmm_tester_hooks.count(tester, flops, memops, bytes);
+  }
+}
+
+#define repetition_tester_begin_time(tester)          spmm_tester_begin_time(tester)
+#define repetition_tester_close_time(tester)          spmm_tester_close_time(tester)
+#define repetition_tester_count_flops(tester, count)  spmm_tester_count(tester, count, 0, 0)
+#define repetition_tester_count_memops(tester, count) spmm_tester_count(tester, 0, count, 0)
+#define repetition_tester_count_bytes(tester, count)  spmm_tester_count(tester, 0, 0, count)
+
+#ifndef OBSERVE_FLOPS
+#define FMADD(dst, a, b) dst += (a * b)
+#else
+#define FMADD(dst, a, b) dst += (a * b); repetition_tester_count_flops(tester, 2)
+#endif // OBSERVE_FLOPS
+
+#ifndef OBSERVE_MEMOPS
+#define LOAD(src)       src
+#define STORE(dst, src) dst = src
+#else
+#define LOAD(src)       src;                          \
+  repetition_tester_count_memops(tester, 1);          \
+  repetition_tester_count_bytes(tester, sizeof(src))
+#define STORE(dst, src) dst = src;                    \
+  repetition_tester_count_memops(tester, 1);          \
+  repetition_tester_count_bytes(tester, sizeof(dst))
+#endif // OBSERVE_MEMOPS
+
+// The parallel and SIMD kernels can't go through LOAD/STORE/FMADD, the tester isn't thread safe
+// and intrinsics don't fit the macros. So those count what they do after the fact
+void spmm_observe_counts(Repetition_Tester *tester, u64 flops, u64 memops, u64 bytes)
+{
+#ifdef OBSERVE_FLOPS
+  repetition_tester_count_flops(tester, flops);
+#endif // OBSERVE_FLOPS
+
+#ifdef OBSERVE_MEMOPS
+  repetition_tester_count_memops(tester, memops);
+  repetition_tester_count_bytes(tester, bytes);
+#endif // OBSERVE_MEMOPS
+}
+
+// What the serial version would have counted
+static
+void observe_csr_dense(Repetition_Tester *tester, CSR_Matrix left, Dense_Matrix right)
+{
+  u64 product_count = (u64)left.non_zero_count * right.col_count;
+
+  u64 flops  = 2 * product_count;
+  u64 memops = 2 * (u64)left.row_count + 2 * (u64)left.non_zero_count + 3 * product_count;
+  u64 bytes  = 2 * sizeof(u32) * (u64)left.row_count +
+               (sizeof(u32) + sizeof(f64)) * (u64)left.non_zero_count +
+               3 * sizeof(f64) * product_count;
+
+  spmm_observe_counts(tester, flops, memops, bytes);
+}
+
+// Called before the timed region, and only builds each operand once
+Dense_Matrix spmm_operand_dense(Operation_Parameters *params, Matrix_Reps *operand)
+{
+  if (!operand->dense.values)
+  {
+    operand->dense = dense_from_csr(params->arena, &operand->csr);
+  }
+
+  return operand->dense;
+}
+
+void spmm_matmul_dense_dense(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  Dense_Matrix left   = spmm_operand_dense(params, &params->left);
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize row = 0; row < left.row_count; row++)
+  {
+    for (usize col = 0; col < right.col_count; col++)
+    {
+      f64 dot = 0.0;
+
+      for (usize i = 0; i < left.col_count; i++)
+      {
+        usize left_index  = row * left.col_count + i;
+        usize right_index = i * right.col_count + col;
+        f64 left_value  = LOAD(left.values[left_index]);
+        f64 right_value = LOAD(right.values[right_index]);
+
+        FMADD(dot, left_value, right_value);
+      }
+
+      usize output_index = row * output.col_count + col;
+      STORE(output.values[output_index], dot);
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+// Made the first time it's asked for, like spmm_operand_dense(). spmm_plan() asks up front
+static
+Gemm_Workspace *params_gemm_workspace(Operation_Parameters *params)
+{
+  if (!params->gemm_workspace.packed_left)
+  {
+    params->gemm_workspace = gemm_workspace_make(params->arena);
+  }
+
+  return &params->gemm_workspace;
+}
+
+// Same product, but blocked for the caches, packed, and through the SIMD register tiles
+void spmm_matmul_dense_dense_blocked(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  Dense_Matrix left   = spmm_operand_dense(params, &params->left);
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  Gemm_Workspace *workspace = params_gemm_workspace(params);
+
+  repetition_tester_begin_time(tester);
+
+  gemm(workspace, left, right, output);
+
+  repetition_tester_close_time(tester);
+
+  // Left is packed once per column block and right once, the micro tiles read both packed
+  // slivers every k, and output is read and written once per k slice
+  Simd_Gemm_Kernel kernel = simd_gemm_kernels[simd_level()];
+  u64 col_blocks = (output.col_count + GEMM_NC - 1) / GEMM_NC;
+  u64 k_blocks   = (left.col_count + GEMM_KC - 1) / GEMM_KC;
+
+  u64 product_count = (u64)left.row_count * left.col_count * right.col_count;
+  u64 packing       = 2 * ((u64)left.row_count * left.col_count * col_blocks + (u64)right.row_count * right.col_count);
+  u64 tile_loads    = product_count / kernel.tile_cols + product_count / kernel.tile_rows;
+  u64 output_count  = 2 * (u64)output.row_count * output.col_count * k_blocks;
+
+  u64 memops = packing + tile_loads + output_count;
+  spmm_observe_counts(tester, 2 * product_count, memops, sizeof(f64) * memops);
+}
+
+void spmm_matmul_csr_dense(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSR_Matrix left     = params->left.csr;
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize row = 0; row < left.row_count; row++)
+  {
+    // Double count?
+    usize row_start = LOAD(left.row_pointers[row]);
+    usize row_end   = LOAD(left.row_pointers[row + 1]);
+
+    for (usize i = row_start; i < row_end; i++)
+    {
+      usize left_col = LOAD(left.col_indices[i]);
+      f64 left_value = LOAD(left.values[i]);
+
+      for (usize right_col = 0; right_col < right.col_count; right_col++)
+      {
+        usize right_index  = left_col * right.col_count + right_col; // ALU op
+        usize output_index = row * output.col_count + right_col;     // ALU op
+
+        f64 right_value   = LOAD(right.values[right_index]);
+        f64 current_value = LOAD(output.values[output_index]);
+
+        f64 result_value = current_value;
+        FMADD(result_value, left_value, right_value);
+
+        STORE(output.values[output_index], result_value);
+      }
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+// Output row tile stays in registers across the row's non zeros, so there's one store per output
+// value rather than a load and store per non zero
+void spmm_matmul_csr_dense_simd(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSR_Matrix left     = params->left.csr;
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  Simd_CSR_Dense_Row *row_kernel = simd_csr_dense_row_kernel(right.col_count);
+
+  repetition_tester_begin_time(tester);
+
+  for (usize row = 0; row < left.row_count; row++)
+  {
+    usize row_start = left.row_pointers[row];
+    usize row_end   = left.row_pointers[row + 1];
+
+    row_kernel(output.values + row * output.col_count,
+               left.col_indices + row_start, left.values + row_start, row_end - row_start,
+               right.values, right.col_count, right.col_count);
+  }
+
+  repetition_tester_close_time(tester);
+
+  u64 product_count = (u64)left.non_zero_count * right.col_count;
+  u64 output_count  = (u64)output.row_count * output.col_count;
+  spmm_observe_counts(tester, 2 * product_count,
+                 2 * (u64)left.row_count + 2 * (u64)left.non_zero_count + product_count + output_count,
+                 2 * sizeof(u32) * (u64)left.row_count +
+                 (sizeof(u32) + sizeof(f64)) * (u64)left.non_zero_count +
+                 sizeof(f64) * (product_count + output_count));
+}
+
+// Columns of right per panel, so that reused_rows rows of one panel take up half of L2 and leave
+// the rest for what streams past. Whole tiles of the widest SIMD kernel, and at least one
+#define DENSE_PANEL_TILE_WIDTH (8 * AVX512_TILE_REGISTERS)
+
+usize spmm_dense_panel_width(usize reused_rows, usize col_count)
+{
+  usize budget = cpu_cache_size(2) / 2;
+  usize width  = budget / (sizeof(f64) * MAX(reused_rows, 1));
+  width = MAX(width / DENSE_PANEL_TILE_WIDTH, 1) * DENSE_PANEL_TILE_WIDTH;
+
+  return MIN(width, col_count);
+}
+
+// Once right is wider than cache, each non zero drags a whole row of it through L2 and evicts the
+// rows the next few non zeros want. So go through right a column panel at a time, with a full pass
+// over left for each. The panel's rows are what gets reused, so those are sized to fit
+void spmm_matmul_csr_dense_tiled(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSR_Matrix left     = params->left.csr;
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  usize panel_width = spmm_dense_panel_width(right.row_count, right.col_count);
+
+  // Only ever narrow with a single panel, the whole of right
+  Simd_CSR_Dense_Row *row_kernel = simd_csr_dense_row_kernel(panel_width);
+
+  repetition_tester_begin_time(tester);
+
+  for (usize panel = 0; panel < right.col_count; panel += panel_width)
+  {
+    usize width = MIN(panel_width, right.col_count - panel);
+
+    for (usize row = 0; row < left.row_count; row++)
+    {
+      usize row_start = left.row_pointers[row];
+      usize row_end   = left.row_pointers[row + 1];
+
+      row_kernel(output.values + row * output.col_count + panel,
+                 left.col_indices + row_start, left.values + row_start, row_end - row_start,
+                 right.values + panel, right.col_count, width);
+    }
+  }
+
+  repetition_tester_close_time(tester);
+
+  // Left is read once per panel
+  u64 panel_count   = panel_width ? (right.col_count + panel_width - 1) / panel_width : 0;
+  u64 product_count = (u64)left.non_zero_count * right.col_count;
+  u64 output_count  = (u64)output.row_count * output.col_count;
+  spmm_observe_counts(tester, 2 * product_count,
+                 panel_count * (2 * (u64)left.row_count + 2 * (u64)left.non_zero_count) + product_count + output_count,
+                 panel_count * (2 * sizeof(u32) * (u64)left.row_count +
+                                (sizeof(u32) + sizeof(f64)) * (u64)left.non_zero_count) +
+                 sizeof(f64) * (product_count + output_count));
+}
+
+typedef struct CSR_Dense_Task CSR_Dense_Task;
+struct CSR_Dense_Task
+{
+  CSR_Matrix   left;
+  Dense_Matrix right;
+  Dense_Matrix output;
+};
+
+// Each task takes a range of rows holding ~ non_zero_count / task_count non zeros. Equal row
+// counts would leave threads idle when row lengths are lopsided. A task owns its output rows
+// outright so there's no need to synchronize writes.
+static
+void csr_dense_task(void *user, u32 task_index, u32 task_count)
+{
+  CSR_Dense_Task *task = user;
+  CSR_Matrix left     = task->left;
+  Dense_Matrix right  = task->right;
+  Dense_Matrix output = task->output;
+
+  u64 non_zero_start = (u64)left.non_zero_count * task_index / task_count;
+  u64 non_zero_close = (u64)left.non_zero_count * (task_index + 1) / task_count;
+
+  usize row_start = csr_row_for_non_zero(&left, non_zero_start);
+  usize row_close = task_index + 1 == task_count ? left.row_count : csr_row_for_non_zero(&left, non_zero_close);
+
+  for (usize row = row_start; row < row_close; row++)
+  {
+    usize nz_start = left.row_pointers[row];
+    usize nz_close = left.row_pointers[row + 1];
+
+    for (usize i = nz_start; i < nz_close; i++)
+    {
+      usize left_col = left.col_indices[i];
+      f64 left_value = left.values[i];
+
+      for (usize right_col = 0; right_col < right.col_count; right_col++)
+      {
+        usize right_index  = left_col * right.col_count + right_col;
+        usize output_index = row * output.col_count + right_col;
+
+        output.values[output_index] += left_value * right.values[right_index];
+      }
+    }
+  }
+}
+
+static
+void matmul_csr_dense_parallel(Repetition_Tester *tester, Operation_Parameters *params, u32 thread_count)
+{
+  CSR_Dense_Task task =
+  {
+    .left   = params->left.csr,
+    .right  = spmm_operand_dense(params, &params->right),
+    .output = params->output,
+  };
+
+  repetition_tester_begin_time(tester);
+
+  thread_pool_dispatch(params->pool, thread_count, csr_dense_task, &task);
+
+  repetition_tester_close_time(tester);
+
+  observe_csr_dense(tester, task.left, task.right);
+}
+
+// One entry per thread count so each gets its own csv to compare against the serial one
+#define MATMUL_CSR_DENSE_THREADS(count)                                                             \
+void spmm_matmul_csr_dense_threads_##count(Repetition_Tester *tester, Operation_Parameters *params) \
+{                                                                                                   \
+  matmul_csr_dense_parallel(tester, params, count);                                                 \
+}
+
+MATMUL_CSR_DENSE_THREADS(2)
+MATMUL_CSR_DENSE_THREADS(4)
+MATMUL_CSR_DENSE_THREADS(8)
+MATMUL_CSR_DENSE_THREADS(16)
+MATMUL_CSR_DENSE_THREADS(32)
+
+void spmm_matmul_csc_dense(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSC_Matrix left     = params->left.csc;
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize col = 0; col < left.col_count; col++)
+  {
+    usize col_start = LOAD(left.col_pointers[col]);
+    usize col_end   = LOAD(left.col_pointers[col + 1]);
+
+    for (usize i = col_start; i < col_end; i++)
+    {
+      usize left_row = LOAD(left.row_indices[i]);
+      f64 left_value = LOAD(left.values[i]);
+
+      for (usize right_col = 0; right_col < right.col_count; right_col++)
+      {
+        usize right_index  = col * right.col_count + right_col;
+        usize output_index = left_row * output.col_count + right_col;
+
+        f64 right_value   = LOAD(right.values[right_index]);
+        f64 current_value = LOAD(output.values[output_index]);
+
+        f64 result_value = current_value;
+        FMADD(result_value, left_value, right_value);
+
+        STORE(output.values[output_index], result_value);
+      }
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+// Right row tile stays in registers across the column's non zeros instead, since each of those
+// lands in a different output row
+void spmm_matmul_csc_dense_simd(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSC_Matrix left     = params->left.csc;
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  Simd_CSC_Dense_Col *col_kernel = simd_csc_dense_col_kernel(right.col_count);
+
+  repetition_tester_begin_time(tester);
+
+  for (usize col = 0; col < left.col_count; col++)
+  {
+    usize col_start = left.col_pointers[col];
+    usize col_end   = left.col_pointers[col + 1];
+
+    col_kernel(output.values, output.col_count,
+               left.row_indices + col_start, left.values + col_start, col_end - col_start,
+               right.values + col * right.col_count, right.col_count);
+  }
+
+  repetition_tester_close_time(tester);
+
+  u64 product_count = (u64)left.non_zero_count * right.col_count;
+  u64 right_count   = (u64)right.row_count * right.col_count;
+  spmm_observe_counts(tester, 2 * product_count,
+                 2 * (u64)left.col_count + 2 * (u64)left.non_zero_count + right_count + 2 * product_count,
+                 2 * sizeof(u32) * (u64)left.col_count +
+                 (sizeof(u32) + sizeof(f64)) * (u64)left.non_zero_count +
+                 sizeof(f64) * (right_count + 2 * product_count));
+}
+
+// The CSC version scatters into output rows instead, so those are what the panel has to keep
+// around, while each right row goes by once per column
+void spmm_matmul_csc_dense_tiled(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSC_Matrix left     = params->left.csc;
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  usize panel_width = spmm_dense_panel_width(output.row_count, right.col_count);
+
+  Simd_CSC_Dense_Col *col_kernel = simd_csc_dense_col_kernel(panel_width);
+
+  repetition_tester_begin_time(tester);
+
+  for (usize panel = 0; panel < right.col_count; panel += panel_width)
+  {
+    usize width = MIN(panel_width, right.col_count - panel);
+
+    for (usize col = 0; col < left.col_count; col++)
+    {
+      usize col_start = left.col_pointers[col];
+      usize col_end   = left.col_pointers[col + 1];
+
+      col_kernel(output.values + panel, output.col_count,
+                 left.row_indices + col_start, left.values + col_start, col_end - col_start,
+                 right.values + col * right.col_count + panel, width);
+    }
+  }
+
+  repetition_tester_close_time(tester);
+
+  u64 panel_count   = panel_width ? (right.col_count + panel_width - 1) / panel_width : 0;
+  u64 product_count = (u64)left.non_zero_count * right.col_count;
+  u64 right_count   = (u64)right.row_count * right.col_count;
+  spmm_observe_counts(tester, 2 * product_count,
+                 panel_count * (2 * (u64)left.col_count + 2 * (u64)left.non_zero_count) + right_count + 2 * product_count,
+                 panel_count * (2 * sizeof(u32) * (u64)left.col_count +
+                                (sizeof(u32) + sizeof(f64)) * (u64)left.non_zero_count) +
+                 sizeof(f64) * (right_count + 2 * product_count));
+}
+
+void spmm_matmul_csr_csr(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSR_Matrix left  = params->left.csr;
+  CSR_Matrix right = params->right.csr;
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize left_row = 0; left_row < left.row_count; left_row++)
+  {
+    usize left_row_start = LOAD(left.row_pointers[left_row]);
+    usize left_row_end   = LOAD(left.row_pointers[left_row + 1]);
+
+    for (usize i = left_row_start; i < left_row_end; i++)
+    {
+      usize left_col = LOAD(left.col_indices[i]);
+      f64 left_value = LOAD(left.values[i]);
+
+      usize right_row_start = LOAD(right.row_pointers[left_col]);
+      usize right_row_end   = LOAD(right.row_pointers[left_col + 1]);
+      for (usize j = right_row_start; j < right_row_end; j++)
+      {
+        usize right_col = LOAD(right.col_indices[j]);
+        f64 right_value = LOAD(right.values[j]);
+
+        usize output_index = left_row * output.col_count + right_col;
+        f64 current_value = LOAD(output.values[output_index]);
+
+        f64 result_value = current_value;
+        FMADD(result_value, left_value, right_value);
+
+        STORE(output.values[output_index], result_value);
+      }
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+// Built the first time a reordered kernel asks, outside the timed region like the dense operands
+static
+Reordering *params_reordering(Operation_Parameters *params, Reorder_Method method)
+{
+  Reordering *result = params->reorderings + method;
+
+  if (!result->row_order)
+  {
+    *result = reorder_make(params->arena, method, &params->left.csr, &params->left.csc, &params->right.csr);
+  }
+
+  return result;
+}
+
+// The kernel runs as is on the permuted operands, into a permuted output that gets scattered
+// back. The tester sums every begin/close pair in a repetition, so the scatter is timed along
+// with the kernel. The gather before it is only so the output still accumulates like the others
+static
+void matmul_reordered(Repetition_Tester *tester, Operation_Parameters *params, Reorder_Method method,
+                      void (*kernel)(Repetition_Tester *, Operation_Parameters *))
+{
+  Reordering *reordering = params_reordering(params, method);
+
+  if (!params->reorder_output.values)
+  {
+    params->reorder_output = (Dense_Matrix)
+    {
+      .row_count = params->output.row_count,
+      .col_count = params->output.col_count,
+      .values = arena_calloc(params->arena, (usize)params->output.row_count * params->output.col_count, f64),
+    };
+  }
+
+  Dense_Matrix output = params->reorder_output;
+  for (usize row = 0; row < output.row_count; row++)
+  {
+    MEM_COPY(output.values + row * output.col_count,
+             params->output.values + (usize)reordering->row_order[row] * output.col_count,
+             sizeof(f64) * output.col_count);
+  }
+
+  Operation_Parameters permuted = *params;
+  permuted.left   = reordering->left;
+  permuted.right  = reordering->right;
+  permuted.output = output;
+
+  kernel(tester, &permuted);
+
+  // Keep the permuted right's dense, if the kernel made one
+  reordering->right = permuted.right;
+
+  repetition_tester_begin_time(tester);
+
+  reorder_unpermute_rows(&output, &params->output, reordering->row_order);
+
+  repetition_tester_close_time(tester);
+
+  u64 count = (u64)output.row_count * output.col_count;
+  spmm_observe_counts(tester, 0, 2 * count, 2 * sizeof(f64) * count);
+}
+
+#define MATMUL_REORDERED(kernel, suffix, method)                                                  \
+void kernel##_##suffix(Repetition_Tester *tester, Operation_Parameters *params)                   \
+{                                                                                                 \
+  matmul_reordered(tester, params, method, kernel);                                               \
+}
+
+MATMUL_REORDERED(spmm_matmul_csr_dense, rcm,     REORDER_RCM)
+MATMUL_REORDERED(spmm_matmul_csr_dense, degree,  REORDER_DEGREE)
+MATMUL_REORDERED(spmm_matmul_csr_dense, cluster, REORDER_CLUSTER)
+MATMUL_REORDERED(spmm_matmul_csr_csr,   rcm,     REORDER_RCM)
+MATMUL_REORDERED(spmm_matmul_csr_csr,   degree,  REORDER_DEGREE)
+MATMUL_REORDERED(spmm_matmul_csr_csr,   cluster, REORDER_CLUSTER)
+
+// Gustavson's, row by row into a per row accumulator so the output never has to be dense.
+// Output is sized by an upper bound (every product lands in a distinct column) rather than
+// counted exactly first, so this is one pass over the products.
+void spmm_matmul_csr_csr_sparse(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSR_Matrix left  = params->left.csr;
+  CSR_Matrix right = params->right.csr;
+  Arena *arena = params->output_arena;
+
+  arena_clear(arena); // Previous call's output
+
+  repetition_tester_begin_time(tester);
+
+  CSR_Matrix output =
+  {
+    .row_count    = left.row_count,
+    .col_count    = right.col_count,
+    .row_pointers = arena_calloc(arena, left.row_count + 1, u32),
+  };
+
+  // Stash each row's upper bound in row_pointers[row + 1] until the row is done
+  u64 upper_bound_total = 0;
+  u32 upper_bound_max   = 0;
+  for (usize left_row = 0; left_row < left.row_count; left_row++)
+  {
+    usize left_row_start = LOAD(left.row_pointers[left_row]);
+    usize left_row_end   = LOAD(left.row_pointers[left_row + 1]);
+
+    u32 upper_bound = 0;
+    for (usize i = left_row_start; i < left_row_end; i++)
+    {
+      usize left_col = LOAD(left.col_indices[i]);
+      usize right_row_start = LOAD(right.row_pointers[left_col]);
+      usize right_row_end   = LOAD(right.row_pointers[left_col + 1]);
+      upper_bound += right_row_end - right_row_start;
+    }
+    upper_bound = MIN(upper_bound, right.col_count);
+
+    output.row_pointers[left_row + 1] = upper_bound;
+    upper_bound_total += upper_bound;
+    if (upper_bound > upper_bound_max && spgemm_use_hash(upper_bound, right.col_count))
+    {
+      upper_bound_max = upper_bound;
+    }
+  }
+
+  output.col_indices = arena_calloc(arena, upper_bound_total, u32);
+  output.values      = arena_calloc(arena, upper_bound_total, f64);
+
+  Dense_Accumulator dense_accumulator = dense_accumulator_make(arena, right.col_count);
+  Hash_Accumulator  hash_accumulator  = hash_accumulator_make(arena, upper_bound_max);
+
+  u32 non_zero_index = 0;
+  for (usize left_row = 0; left_row < left.row_count; left_row++)
+  {
+    usize left_row_start = LOAD(left.row_pointers[left_row]);
+    usize left_row_end   = LOAD(left.row_pointers[left_row + 1]);
+
+    u32 upper_bound = output.row_pointers[left_row + 1];
+    b32 use_hash = spgemm_use_hash(upper_bound, right.col_count);
+    if (use_hash)
+    {
+      hash_accumulator_begin_row(&hash_accumulator, upper_bound);
+    }
+
+    for (usize i = left_row_start; i < left_row_end; i++)
+    {
+      usize left_col = LOAD(left.col_indices[i]);
+      f64 left_value = LOAD(left.values[i]);
+
+      usize right_row_start = LOAD(right.row_pointers[left_col]);
+      usize right_row_end   = LOAD(right.row_pointers[left_col + 1]);
+      for (usize j = right_row_start; j < right_row_end; j++)
+      {
+        usize right_col = LOAD(right.col_indices[j]);
+        f64 right_value = LOAD(right.values[j]);
+
+        f64 *slot = use_hash ? hash_accumulator_slot(&hash_accumulator, right_col)
+                             : dense_accumulator_slot(&dense_accumulator, right_col);
+        FMADD(*slot, left_value, right_value);
+      }
+    }
+
+    u32 *out_cols   = output.col_indices + non_zero_index;
+    f64 *out_values = output.values + non_zero_index;
+    non_zero_index += use_hash ? hash_accumulator_flush(&hash_accumulator, out_cols, out_values)
+                               : dense_accumulator_flush(&dense_accumulator, out_cols, out_values);
+
+    output.row_pointers[left_row + 1] = non_zero_index;
+  }
+
+  output.non_zero_count = non_zero_index;
+
+  repetition_tester_close_time(tester);
+
+  params->sparse_output = output;
+}
+
+// Inserts the columns of one output row into whichever accumulator the row uses
+static
+void spgemm_symbolic_row(Repetition_Tester *tester, CSR_Matrix left, CSR_Matrix right, usize left_row,
+                         b32 use_hash, Dense_Accumulator *dense_accumulator, Hash_Accumulator *hash_accumulator)
+{
+  usize left_row_start = LOAD(left.row_pointers[left_row]);
+  usize left_row_end   = LOAD(left.row_pointers[left_row + 1]);
+
+  for (usize i = left_row_start; i < left_row_end; i++)
+  {
+    usize left_col = LOAD(left.col_indices[i]);
+
+    usize right_row_start = LOAD(right.row_pointers[left_col]);
+    usize right_row_end   = LOAD(right.row_pointers[left_col + 1]);
+    for (usize j = right_row_start; j < right_row_end; j++)
+    {
+      usize right_col = LOAD(right.col_indices[j]);
+
+      if (use_hash)
+      {
+        hash_accumulator_slot(hash_accumulator, right_col);
+      }
+      else
+      {
+        dense_accumulator_slot(dense_accumulator, right_col);
+      }
+    }
+  }
+}
+
+// Pattern half of csr_X_csr_sparse. Counts each row exactly first so the output is allocated at
+// its real size, then fills in the sorted column indices. Values are left for spgemm_numeric()
+Spgemm_Plan spmm_spgemm_symbolic(Repetition_Tester *tester, Arena *arena, CSR_Matrix left, CSR_Matrix right)
+{
+  Spgemm_Plan plan = {0};
+  CSR_Matrix *output = &plan.output;
+
+  output->row_count    = left.row_count;
+  output->col_count    = right.col_count;
+  output->row_pointers = arena_calloc(arena, left.row_count + 1, u32);
+
+  u32 *upper_bounds   = arena_calloc(arena, left.row_count, u32);
+  u32 upper_bound_max = 0;
+  for (usize left_row = 0; left_row < left.row_count; left_row++)
+  {
+    usize left_row_start = LOAD(left.row_pointers[left_row]);
+    usize left_row_end   = LOAD(left.row_pointers[left_row + 1]);
+
+    u32 upper_bound = 0;
+    for (usize i = left_row_start; i < left_row_end; i++)
+    {
+      usize left_col = LOAD(left.col_indices[i]);
+      usize right_row_start = LOAD(right.row_pointers[left_col]);
+      usize right_row_end   = LOAD(right.row_pointers[left_col + 1]);
+      upper_bound += right_row_end - right_row_start;
+    }
+    upper_bound = MIN(upper_bound, right.col_count);
+
+    upper_bounds[left_row] = upper_bound;
+    if (upper_bound > upper_bound_max && spgemm_use_hash(upper_bound, right.col_count))
+    {
+      upper_bound_max = upper_bound;
+    }
+  }
+
+  Dense_Accumulator dense_accumulator = dense_accumulator_make(arena, right.col_count);
+  Hash_Accumulator  hash_accumulator  = hash_accumulator_make(arena, upper_bound_max);
+
+  // Row sizes
+  for (usize left_row = 0; left_row < left.row_count; left_row++)
+  {
+    b32 use_hash = spgemm_use_hash(upper_bounds[left_row], right.col_count);
+    if (use_hash)
+    {
+      hash_accumulator_begin_row(&hash_accumulator, upper_bounds[left_row]);
+    }
+
+    spgemm_symbolic_row(tester, left, right, left_row, use_hash, &dense_accumulator, &hash_accumulator);
+
+    u32 row_size = use_hash ? hash_accumulator_clear(&hash_accumulator)
+                            : dense_accumulator_clear(&dense_accumulator);
+
+    output->row_pointers[left_row + 1] = output->row_pointers[left_row] + row_size;
+  }
+
+  // Packed now the size is known, the plan gets reused so its layout is worth the copy
+  u32 *row_pointers = output->row_pointers;
+  *output = csr_alloc(arena, left.row_count, right.col_count, row_pointers[left.row_count]);
+  MEM_COPY(output->row_pointers, row_pointers, sizeof(u32) * ((usize)left.row_count + 1));
+
+  // Pattern, the accumulators hand back zeros for values which is fine, numeric overwrites them
+  for (usize left_row = 0; left_row < left.row_count; left_row++)
+  {
+    b32 use_hash = spgemm_use_hash(upper_bounds[left_row], right.col_count);
+    if (use_hash)
+    {
+      hash_accumulator_begin_row(&hash_accumulator, upper_bounds[left_row]);
+    }
+
+    spgemm_symbolic_row(tester, left, right, left_row, use_hash, &dense_accumulator, &hash_accumulator);
+
+    u32 *out_cols   = output->col_indices + output->row_pointers[left_row];
+    f64 *out_values = output->values + output->row_pointers[left_row];
+    if (use_hash)
+    {
+      hash_accumulator_flush(&hash_accumulator, out_cols, out_values);
+    }
+    else
+    {
+      dense_accumulator_flush(&dense_accumulator, out_cols, out_values);
+    }
+  }
+
+  plan.workspace = arena_calloc(arena, right.col_count, f64);
+
+  return plan;
+}
+
+// Values half, the pattern is already known so there's no accumulator bookkeeping. Just zero the
+// row's pattern in the workspace, scatter the products, gather the pattern back out
+static
+void spgemm_numeric(Repetition_Tester *tester, Spgemm_Plan *plan, CSR_Matrix left, CSR_Matrix right)
+{
+  CSR_Matrix output = plan->output;
+  f64 *workspace = plan->workspace;
+
+  for (usize left_row = 0; left_row < left.row_count; left_row++)
+  {
+    usize output_row_start = LOAD(output.row_pointers[left_row]);
+    usize output_row_end   = LOAD(output.row_pointers[left_row + 1]);
+
+    for (usize o = output_row_start; o < output_row_end; o++)
+    {
+      usize output_col = LOAD(output.col_indices[o]);
+      STORE(workspace[output_col], 0.0);
+    }
+
+    usize left_row_start = LOAD(left.row_pointers[left_row]);
+    usize left_row_end   = LOAD(left.row_pointers[left_row + 1]);
+
+    for (usize i = left_row_start; i < left_row_end; i++)
+    {
+      usize left_col = LOAD(left.col_indices[i]);
+      f64 left_value = LOAD(left.values[i]);
+
+      usize right_row_start = LOAD(right.row_pointers[left_col]);
+      usize right_row_end   = LOAD(right.row_pointers[left_col + 1]);
+      for (usize j = right_row_start; j < right_row_end; j++)
+      {
+        usize right_col = LOAD(right.col_indices[j]);
+        f64 right_value = LOAD(right.values[j]);
+
+        f64 current_value = LOAD(workspace[right_col]);
+
+        f64 result_value = current_value;
+        FMADD(result_value, left_value, right_value);
+
+        STORE(workspace[right_col], result_value);
+      }
+    }
+
+    for (usize o = output_row_start; o < output_row_end; o++)
+    {
+      usize output_col = LOAD(output.col_indices[o]);
+      f64 value = LOAD(workspace[output_col]);
+      STORE(output.values[o], value);
+    }
+  }
+}
+
+// Only the symbolic pass is timed. Numeric runs after so verify still sees a whole product
+void spmm_matmul_csr_csr_symbolic(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSR_Matrix left  = params->left.csr;
+  CSR_Matrix right = params->right.csr;
+  Arena *arena = params->output_arena;
+
+  arena_clear(arena); // Previous call's plan
+
+  repetition_tester_begin_time(tester);
+
+  Spgemm_Plan plan = spmm_spgemm_symbolic(tester, arena, left, right);
+
+  repetition_tester_close_time(tester);
+
+  spgemm_numeric(NULL, &plan, left, right);
+
+  params->sparse_output = plan.output;
+}
+
+// Reuses the plan from init_params(), as if the values had changed but not the pattern
+void spmm_matmul_csr_csr_numeric(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSR_Matrix left  = params->left.csr;
+  CSR_Matrix right = params->right.csr;
+
+  repetition_tester_begin_time(tester);
+
+  spgemm_numeric(tester, &params->spgemm_plan, left, right);
+
+  repetition_tester_close_time(tester);
+
+  params->sparse_output = params->spgemm_plan.output;
+}
+
+void spmm_matmul_csc_csc(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSC_Matrix left  = params->left.csc;
+  CSC_Matrix right = params->right.csc;
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize right_col = 0; right_col < right.col_count; right_col++)
+  {
+    usize right_col_start = LOAD(right.col_pointers[right_col]);
+    usize right_col_end   = LOAD(right.col_pointers[right_col + 1]);
+
+    for (usize i = right_col_start; i < right_col_end; i++)
+    {
+      usize right_row = LOAD(right.row_indices[i]);
+      f64 right_value = LOAD(right.values[i]);
+
+      usize left_col_start = LOAD(left.col_pointers[right_row]);
+      usize left_col_end   = LOAD(left.col_pointers[right_row + 1]);
+      for (usize j = left_col_start; j < left_col_end; j++)
+      {
+        usize left_row = LOAD(left.row_indices[j]);
+        f64 left_value = LOAD(left.values[j]);
+
+        usize output_index = left_row * output.col_count + right_col;
+        f64 current_value = LOAD(output.values[output_index]);
+
+        f64 result_value = current_value;
+        FMADD(result_value, left_value, right_value);
+
+        STORE(output.values[output_index], result_value);
+      }
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+void spmm_matmul_csr_csc(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSR_Matrix left  = params->left.csr;
+  CSC_Matrix right = params->right.csc;
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize left_row = 0; left_row < left.row_count; left_row++)
+  {
+    usize left_row_start = LOAD(left.row_pointers[left_row]);
+    usize left_row_end   = LOAD(left.row_pointers[left_row + 1]);
+
+    for (usize right_col = 0; right_col < right.col_count; right_col++)
+    {
+      usize right_col_start = LOAD(right.col_pointers[right_col]);
+      usize right_col_end   = LOAD(right.col_pointers[right_col + 1]);
+
+      f64 result_value = 0.0;
+
+      usize left_cursor  = left_row_start;
+      usize right_cursor = right_col_start;
+      while (left_cursor < left_row_end && right_cursor < right_col_end)
+      {
+        usize left_col  = LOAD(left.col_indices[left_cursor]);
+        usize right_row = LOAD(right.row_indices[right_cursor]);
+        usize k = MIN(left_col, right_row);
+
+        if (left_col == k && right_row == k)
+        {
+          f64 left_value  = LOAD(left.values[left_cursor]);
+          f64 right_value = LOAD(right.values[right_cursor]);
+          FMADD(result_value, left_value, right_value);
+
+        }
+        left_cursor  += (usize)(left_col == k);
+        right_cursor += (usize)(right_row == k);
+      }
+
+      usize output_index = left_row * output.col_count + right_col;
+      STORE(output.values[output_index], result_value);
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+// One list this many times longer than the other is galloped through rather than merged
+#define INTERSECT_GALLOP_RATIO 32
+
+// For every short entry, double a step out from the cursor in the long list until past it, then
+// binary search what's left. Only touches about short_count * log(long_count / short_count)
+static
+f64 sorted_dot_gallop(u32 *short_indices, f64 *short_values, usize short_count,
+                      u32 *long_indices, f64 *long_values, usize long_count,
+                      u64 *out_match_count)
+{
+  f64 result = 0.0;
+
+  usize cursor = 0;
+  for (usize i = 0; i < short_count && cursor < long_count; i++)
+  {
+    u32 target = short_indices[i];
+
+    usize bound = 1;
+    while (cursor + bound < long_count && long_indices[cursor + bound] < target)
+    {
+      bound *= 2;
+    }
+
+    // Everything before low is known to be less than target
+    usize low  = cursor + bound / 2;
+    usize high = MIN(cursor + bound + 1, long_count);
+    while (low < high)
+    {
+      usize middle = low + (high - low) / 2;
+      if (long_indices[middle] < target)
+      {
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+
+    cursor = low;
+    if (cursor < long_count && long_indices[cursor] == target)
+    {
+      result += short_values[i] * long_values[cursor];
+      *out_match_count += 1;
+      cursor += 1;
+    }
+  }
+
+  return result;
+}
+
+// Left width, zeroed. Made the first time it's asked for, like params_gemm_workspace()
+static
+f64 *params_intersect_lookup(Operation_Parameters *params)
+{
+  if (!params->intersect_lookup)
+  {
+    params->intersect_lookup = arena_calloc(params->arena, MAX(params->left.csr.col_count, 1), f64);
+  }
+
+  return params->intersect_lookup;
+}
+
+// Same dot per output entry, but how each pair gets intersected depends on its lengths. Dense left
+// rows are scattered once and looked up, lopsided pairs gallop, and the rest go through the SIMD
+// block merge
+void spmm_matmul_csr_csc_adaptive(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSR_Matrix left  = params->left.csr;
+  CSC_Matrix right = params->right.csc;
+  Dense_Matrix output = params->output;
+
+  f64 *lookup = params_intersect_lookup(params);
+
+  Simd_Sorted_Dot *merge = simd_sorted_dot_kernels[simd_level()];
+
+  u64 match_count = 0;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize left_row = 0; left_row < left.row_count; left_row++)
+  {
+    usize left_row_start = left.row_pointers[left_row];
+    usize left_count     = left.row_pointers[left_row + 1] - left_row_start;
+
+    u32 *left_indices = left.col_indices + left_row_start;
+    f64 *left_values  = left.values + left_row_start;
+
+    b32 use_lookup = left_count && (u64)left_count * INTERSECT_LOOKUP_DENSITY >= left.col_count;
+    if (use_lookup)
+    {
+      for (usize i = 0; i < left_count; i++)
+      {
+        lookup[left_indices[i]] = left_values[i];
+      }
+    }
+
+    for (usize right_col = 0; right_col < right.col_count; right_col++)
+    {
+      usize right_col_start = right.col_pointers[right_col];
+      usize right_count     = right.col_pointers[right_col + 1] - right_col_start;
+
+      u32 *right_indices = right.row_indices + right_col_start;
+      f64 *right_values  = right.values + right_col_start;
+
+      f64 result_value = 0.0;
+      if (!left_count || !right_count)
+      {
+        // Most pairs, at the sparse end
+      }
+      else if (use_lookup && right_count <= left_count)
+      {
+        for (usize j = 0; j < right_count; j++)
+        {
+          result_value += lookup[right_indices[j]] * right_values[j];
+        }
+        match_count += right_count;
+      }
+      else if ((u64)left_count * INTERSECT_GALLOP_RATIO < right_count)
+      {
+        result_value = sorted_dot_gallop(left_indices, left_values, left_count,
+                                         right_indices, right_values, right_count, &match_count);
+      }
+      else if ((u64)right_count * INTERSECT_GALLOP_RATIO < left_count)
+      {
+        result_value = sorted_dot_gallop(right_indices, right_values, right_count,
+                                         left_indices, left_values, left_count, &match_count);
+      }
+      else if (MIN(left_count, right_count) < 8)
+      {
+        // Not a whole block on one side, the SIMD merge would only fall through to this anyway
+        result_value = sorted_dot_scalar(left_indices, left_values, left_count,
+                                         right_indices, right_values, right_count, &match_count);
+      }
+      else
+      {
+        result_value = merge(left_indices, left_values, left_count,
+                             right_indices, right_values, right_count, &match_count);
+      }
+
+      output.values[left_row * output.col_count + right_col] = result_value;
+    }
+
+    if (use_lookup)
+    {
+      for (usize i = 0; i < left_count; i++)
+      {
+        lookup[left_indices[i]] = 0.0;
+      }
+    }
+  }
+
+  repetition_tester_close_time(tester);
+
+  // How many indices get compared depends on the path, so only what every path has to do: the
+  // pointers, the matched values and the output
+  u64 output_count = (u64)output.row_count * output.col_count;
+  spmm_observe_counts(tester, 2 * match_count,
+                 2 * (u64)left.row_count + 2 * output_count + 2 * match_count + output_count,
+                 sizeof(u32) * (2 * (u64)left.row_count + 2 * output_count) +
+                 sizeof(f64) * (2 * match_count + output_count));
+}
+
+void spmm_matmul_csc_csr(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSC_Matrix left  = params->left.csc;
+  CSR_Matrix right = params->right.csr;
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize k = 0; k < right.row_count; k++)
+  {
+    usize left_col_start = LOAD(left.col_pointers[k]);
+    usize left_col_close = LOAD(left.col_pointers[k + 1]);
+
+    usize right_row_start = LOAD(right.row_pointers[k]);
+    usize right_row_close = LOAD(right.row_pointers[k + 1]);
+
+    for (usize left_col = left_col_start; left_col < left_col_close; left_col++)
+    {
+      usize row = LOAD(left.row_indices[left_col]);
+      f64 left_value  = LOAD(left.values[left_col]);
+
+      for (usize right_row = right_row_start; right_row < right_row_close; right_row++)
+      {
+        usize col = LOAD(right.col_indices[right_row]);
+        f64 right_value = LOAD(right.values[right_row]);
+
+        usize output_index = row * output.col_count + col;
+        f64 output_value   = LOAD(output.values[output_index]);
+        FMADD(output_value, left_value, right_value);
+
+        STORE(output.values[output_index], output_value);
+      }
+    }
+  }
+
+
+  repetition_tester_close_time(tester);
+}
+
+void spmm_matmul_dense_csr(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  Dense_Matrix left   = spmm_operand_dense(params, &params->left);
+  CSR_Matrix right    = params->right.csr;
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize row = 0; row < left.row_count; row++)
+  {
+    for (usize k = 0; k < right.row_count; k++)
+    {
+      usize left_index = row * left.col_count + k;
+      f64 left_value   = LOAD(left.values[left_index]);
+
+      usize right_row_start = LOAD(right.row_pointers[k]);
+      usize right_row_close = LOAD(right.row_pointers[k + 1]);
+
+      for (usize rj = right_row_start; rj < right_row_close; rj++)
+      {
+        usize col = LOAD(right.col_indices[rj]);
+        f64 right_value = LOAD(right.values[rj]);
+
+        usize output_index = row * output.col_count + col;
+        f64 output_value   = output.values[output_index];
+
+        FMADD(output_value, left_value, right_value);
+
+        STORE(output.values[output_index], output_value);
+      }
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+void spmm_matmul_dense_csr_simd(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  Dense_Matrix left   = spmm_operand_dense(params, &params->left);
+  CSR_Matrix right    = params->right.csr;
+  Dense_Matrix output = params->output;
+
+  Simd_Scatter_Axpy *axpy_kernel = simd_scatter_axpy_kernels[simd_level()];
+
+  repetition_tester_begin_time(tester);
+
+  for (usize row = 0; row < left.row_count; row++)
+  {
+    f64 *output_row = output.values + row * output.col_count;
+
+    for (usize k = 0; k < right.row_count; k++)
+    {
+      f64 left_value = left.values[row * left.col_count + k];
+
+      usize right_row_start = right.row_pointers[k];
+      usize right_row_close = right.row_pointers[k + 1];
+
+      axpy_kernel(output_row, left_value,
+                  right.col_indices + right_row_start, right.values + right_row_start,
+                  right_row_close - right_row_start);
+    }
+  }
+
+  repetition_tester_close_time(tester);
+
+  u64 product_count = (u64)left.row_count * right.non_zero_count;
+  u64 left_count    = (u64)left.row_count * right.row_count;
+  spmm_observe_counts(tester, 2 * product_count,
+                 3 * left_count + 4 * product_count,
+                 (sizeof(f64) + 2 * sizeof(u32)) * left_count +
+                 (sizeof(u32) + 3 * sizeof(f64)) * product_count);
+}
+
+void spmm_matmul_dense_csc(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  Dense_Matrix left   = spmm_operand_dense(params, &params->left);
+  CSC_Matrix right    = params->right.csc;
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize row = 0; row < left.row_count; row++)
+  {
+    for (usize col = 0; col < right.col_count; col++)
+    {
+      usize output_index = row * output.col_count + col;
+      f64 output_value = 0.0;
+
+      usize right_col_start = LOAD(right.col_pointers[col]);
+      usize right_col_close   = LOAD(right.col_pointers[col + 1]);
+      for (usize kc = right_col_start; kc < right_col_close; kc++)
+      {
+        usize k = right.row_indices[kc];
+        f64 right_value = LOAD(right.values[kc]);
+
+        usize left_index = row * left.col_count + k;
+        f64 left_value = LOAD(left.values[left_index]);
+
+        FMADD(output_value, left_value, right_value);
+      }
+
+      STORE(output.values[output_index], output_value);
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+// Same as csr_X_dense but only visits rows that have something, the empty ones cost nothing at
+// all rather than two pointer loads each
+void spmm_matmul_dcsr_dense(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  DCSR_Matrix left    = params->left.dcsr;
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize k = 0; k < left.non_empty_row_count; k++)
+  {
+    usize row       = LOAD(left.row_ids[k]);
+    usize row_start = LOAD(left.row_pointers[k]);
+    usize row_end   = LOAD(left.row_pointers[k + 1]);
+
+    for (usize i = row_start; i < row_end; i++)
+    {
+      usize left_col = LOAD(left.col_indices[i]);
+      f64 left_value = LOAD(left.values[i]);
+
+      for (usize right_col = 0; right_col < right.col_count; right_col++)
+      {
+        usize right_index  = left_col * right.col_count + right_col;
+        usize output_index = row * output.col_count + right_col;
+
+        f64 right_value   = LOAD(right.values[right_index]);
+        f64 current_value = LOAD(output.values[output_index]);
+
+        f64 result_value = current_value;
+        FMADD(result_value, left_value, right_value);
+
+        STORE(output.values[output_index], result_value);
+      }
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+void spmm_matmul_dcsr_csr(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  DCSR_Matrix left = params->left.dcsr;
+  CSR_Matrix right = params->right.csr;
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize k = 0; k < left.non_empty_row_count; k++)
+  {
+    usize left_row       = LOAD(left.row_ids[k]);
+    usize left_row_start = LOAD(left.row_pointers[k]);
+    usize left_row_end   = LOAD(left.row_pointers[k + 1]);
+
+    for (usize i = left_row_start; i < left_row_end; i++)
+    {
+      usize left_col = LOAD(left.col_indices[i]);
+      f64 left_value = LOAD(left.values[i]);
+
+      usize right_row_start = LOAD(right.row_pointers[left_col]);
+      usize right_row_end   = LOAD(right.row_pointers[left_col + 1]);
+      for (usize j = right_row_start; j < right_row_end; j++)
+      {
+        usize right_col = LOAD(right.col_indices[j]);
+        f64 right_value = LOAD(right.values[j]);
+
+        usize output_index = left_row * output.col_count + right_col;
+        f64 current_value = LOAD(output.values[output_index]);
+
+        f64 result_value = current_value;
+        FMADD(result_value, left_value, right_value);
+
+        STORE(output.values[output_index], result_value);
+      }
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+void spmm_matmul_dcsc_dense(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  DCSC_Matrix left    = params->left.dcsc;
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize k = 0; k < left.non_empty_col_count; k++)
+  {
+    usize col       = LOAD(left.col_ids[k]);
+    usize col_start = LOAD(left.col_pointers[k]);
+    usize col_end   = LOAD(left.col_pointers[k + 1]);
+
+    for (usize i = col_start; i < col_end; i++)
+    {
+      usize left_row = LOAD(left.row_indices[i]);
+      f64 left_value = LOAD(left.values[i]);
+
+      for (usize right_col = 0; right_col < right.col_count; right_col++)
+      {
+        usize right_index  = col * right.col_count + right_col;
+        usize output_index = left_row * output.col_count + right_col;
+
+        f64 right_value   = LOAD(right.values[right_index]);
+        f64 current_value = LOAD(output.values[output_index]);
+
+        f64 result_value = current_value;
+        FMADD(result_value, left_value, right_value);
+
+        STORE(output.values[output_index], result_value);
+      }
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+// Outer products like csc_X_csr, but only over the left's non empty columns
+void spmm_matmul_dcsc_csr(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  DCSC_Matrix left = params->left.dcsc;
+  CSR_Matrix right = params->right.csr;
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize k = 0; k < left.non_empty_col_count; k++)
+  {
+    usize inner          = LOAD(left.col_ids[k]);
+    usize left_col_start = LOAD(left.col_pointers[k]);
+    usize left_col_close = LOAD(left.col_pointers[k + 1]);
+
+    usize right_row_start = LOAD(right.row_pointers[inner]);
+    usize right_row_close = LOAD(right.row_pointers[inner + 1]);
+
+    for (usize i = left_col_start; i < left_col_close; i++)
+    {
+      usize row = LOAD(left.row_indices[i]);
+      f64 left_value = LOAD(left.values[i]);
+
+      for (usize j = right_row_start; j < right_row_close; j++)
+      {
+        usize col = LOAD(right.col_indices[j]);
+        f64 right_value = LOAD(right.values[j]);
+
+        usize output_index = row * output.col_count + col;
+        f64 output_value   = LOAD(output.values[output_index]);
+        FMADD(output_value, left_value, right_value);
+
+        STORE(output.values[output_index], output_value);
+      }
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+// No pointers at all, each non zero carries its own row. Costs a row index per non zero instead
+void spmm_matmul_coo_dense(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  COO_Matrix left     = params->left.coo;
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize i = 0; i < left.non_zero_count; i++)
+  {
+    usize left_row = LOAD(left.row_indices[i]);
+    usize left_col = LOAD(left.col_indices[i]);
+    f64 left_value = LOAD(left.values[i]);
+
+    for (usize right_col = 0; right_col < right.col_count; right_col++)
+    {
+      usize right_index  = left_col * right.col_count + right_col;
+      usize output_index = left_row * output.col_count + right_col;
+
+      f64 right_value   = LOAD(right.values[right_index]);
+      f64 current_value = LOAD(output.values[output_index]);
+
+      f64 result_value = current_value;
+      FMADD(result_value, left_value, right_value);
+
+      STORE(output.values[output_index], result_value);
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+void spmm_matmul_coo_csr(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  COO_Matrix left  = params->left.coo;
+  CSR_Matrix right = params->right.csr;
+  Dense_Matrix output = params->output;
+
+  repetition_tester_begin_time(tester);
+
+  for (usize i = 0; i < left.non_zero_count; i++)
+  {
+    usize left_row = LOAD(left.row_indices[i]);
+    usize left_col = LOAD(left.col_indices[i]);
+    f64 left_value = LOAD(left.values[i]);
+
+    usize right_row_start = LOAD(right.row_pointers[left_col]);
+    usize right_row_end   = LOAD(right.row_pointers[left_col + 1]);
+    for (usize j = right_row_start; j < right_row_end; j++)
+    {
+      usize right_col = LOAD(right.col_indices[j]);
+      f64 right_value = LOAD(right.values[j]);
+
+      usize output_index = left_row * output.col_count + right_col;
+      f64 current_value = LOAD(output.values[output_index]);
+
+      f64 result_value = current_value;
+      FMADD(result_value, left_value, right_value);
+
+      STORE(output.values[output_index], result_value);
+    }
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+static
+Dense_F32_Matrix operand_dense_f32(Operation_Parameters *params, Matrix_Reps *operand)
+{
+  if (!operand->dense_f32.values)
+  {
+    Dense_Matrix dense = spmm_operand_dense(params, operand);
+    operand->dense_f32 = dense_f32_from_dense(params->arena, &dense);
+  }
+
+  return operand->dense_f32;
+}
+
+static
+Dense_BF16_Matrix operand_dense_bf16(Operation_Parameters *params, Matrix_Reps *operand)
+{
+  if (!operand->dense_bf16.values)
+  {
+    Dense_Matrix dense = spmm_operand_dense(params, operand);
+    operand->dense_bf16 = dense_bf16_from_dense(params->arena, &dense);
+  }
+
+  return operand->dense_bf16;
+}
+
+// An f32 accumulator means an f32 output too. It's narrowed from the f64 one before timing and
+// widened back after, so it still accumulates onto whatever was there like every other kernel
+static
+Dense_F32_Matrix compact_output_begin_f32(Operation_Parameters *params)
+{
+  if (!params->output_f32.values)
+  {
+    params->output_f32 = dense_f32_from_dense(params->arena, &params->output);
+  }
+  else
+  {
+    for (usize i = 0; i < (usize)params->output.row_count * params->output.col_count; i++)
+    {
+      params->output_f32.values[i] = (f32)params->output.values[i];
+    }
+  }
+
+  return params->output_f32;
+}
+
+static
+void compact_output_end_f32(Operation_Parameters *params, Dense_F32_Matrix output)
+{
+  for (usize i = 0; i < (usize)output.row_count * output.col_count; i++)
+  {
+    params->output.values[i] = output.values[i];
+  }
+}
+
+static
+Dense_Matrix compact_output_begin_f64(Operation_Parameters *params)
+{
+  return params->output;
+}
+
+static
+void compact_output_end_f64(Operation_Parameters *params, Dense_Matrix output)
+{
+}
+
+#define COMPACT_WIDEN_NONE(value) (value)
+
+// csr_X_dense over the narrow formats, same loop so the only difference is the bytes behind each
+// load. Stored values widen to the Accumulator as they're loaded. A left that was never built,
+// the u16 ones when there are too many columns, times an empty loop
+#define COMPACT_CSR_DENSE(name, Left_Matrix, left_field, Right_Matrix, right_dense, Stored, widen, \
+                          Output_Matrix, Accumulator, output_begin, output_end)                   \
+void name(Repetition_Tester *tester, Operation_Parameters *params)                                \
+{                                                                                                 \
+  Left_Matrix   left   = params->left.left_field;                                                 \
+  Right_Matrix  right  = right_dense(params, &params->right);                                     \
+  Output_Matrix output = output_begin(params);                                                    \
+                                                                                                  \
+  repetition_tester_begin_time(tester);                                                           \
+                                                                                                  \
+  for (usize row = 0; left.row_pointers && row < left.row_count; row++)                           \
+  {                                                                                               \
+    usize row_start = LOAD(left.row_pointers[row]);                                               \
+    usize row_end   = LOAD(left.row_pointers[row + 1]);                                           \
+                                                                                                  \
+    for (usize i = row_start; i < row_end; i++)                                                   \
+    {                                                                                             \
+      usize left_col     = LOAD(left.col_indices[i]);                                             \
+      Stored left_stored = LOAD(left.values[i]);                                                  \
+      Accumulator left_value = widen(left_stored);                                                \
+                                                                                                  \
+      for (usize right_col = 0; right_col < right.col_count; right_col++)                         \
+      {                                                                                           \
+        usize right_index  = left_col * right.col_count + right_col;                              \
+        usize output_index = row * output.col_count + right_col;                                  \
+                                                                                                  \
+        Stored right_stored       = LOAD(right.values[right_index]);                              \
+        Accumulator current_value = LOAD(output.values[output_index]);                            \
+        Accumulator right_value   = widen(right_stored);                                          \
+                                                                                                  \
+        Accumulator result_value = current_value;                                                 \
+        FMADD(result_value, left_value, right_value);                                             \
+                                                                                                  \
+        STORE(output.values[output_index], result_value);                                         \
+      }                                                                                           \
+    }                                                                                             \
+  }                                                                                               \
+                                                                                                  \
+  repetition_tester_close_time(tester);                                                           \
+                                                                                                  \
+  output_end(params, output);                                                                     \
+}
+
+COMPACT_CSR_DENSE(spmm_matmul_csr_f32_dense_f32, CSR_F32_Matrix, csr_f32, Dense_F32_Matrix, operand_dense_f32,
+                  f32, COMPACT_WIDEN_NONE, Dense_F32_Matrix, f32, compact_output_begin_f32, compact_output_end_f32)
+
+// f32 storage for the bandwidth, f64 sums for the error
+COMPACT_CSR_DENSE(spmm_matmul_csr_f32_dense_f32_acc64, CSR_F32_Matrix, csr_f32, Dense_F32_Matrix, operand_dense_f32,
+                  f32, COMPACT_WIDEN_NONE, Dense_Matrix, f64, compact_output_begin_f64, compact_output_end_f64)
+
+COMPACT_CSR_DENSE(spmm_matmul_csr_bf16_dense_bf16, CSR_BF16_Matrix, csr_bf16, Dense_BF16_Matrix, operand_dense_bf16,
+                  bf16, f32_from_bf16, Dense_F32_Matrix, f32, compact_output_begin_f32, compact_output_end_f32)
+
+COMPACT_CSR_DENSE(spmm_matmul_csr_u16_dense, CSR_U16_Matrix, csr_u16, Dense_Matrix, spmm_operand_dense,
+                  f64, COMPACT_WIDEN_NONE, Dense_Matrix, f64, compact_output_begin_f64, compact_output_end_f64)
+
+COMPACT_CSR_DENSE(spmm_matmul_csr_f32_u16_dense_f32, CSR_F32_U16_Matrix, csr_f32_u16, Dense_F32_Matrix,
+                  operand_dense_f32, f32, COMPACT_WIDEN_NONE, Dense_F32_Matrix, f32, compact_output_begin_f32,
+                  compact_output_end_f32)
+
+// Vectorized across rows instead of along them, so uneven row lengths only cost the padding
+// within a chunk rather than a ragged remainder per row
+void spmm_matmul_sell_dense(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  SELL_Matrix left    = params->left.sell;
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  // Offsets past 32 bits would wrap in the gathers
+  b32 fits_offsets = (u64)right.row_count * right.col_count <= INT32_MAX &&
+                     (u64)output.row_count * output.col_count <= INT32_MAX;
+  Simd_SELL_Dense_Chunk *chunk_kernel = simd_sell_dense_chunk_kernels[fits_offsets ? simd_level() : SIMD_SCALAR];
+
+  repetition_tester_begin_time(tester);
+
+  for (usize chunk = 0; chunk < left.chunk_count; chunk++)
+  {
+    usize chunk_start = left.chunk_pointers[chunk];
+    usize chunk_end   = left.chunk_pointers[chunk + 1];
+    u32 lane_count    = MIN(SELL_CHUNK_HEIGHT, left.row_count - chunk * SELL_CHUNK_HEIGHT);
+
+    chunk_kernel(output.values, output.col_count, left.rows + chunk * SELL_CHUNK_HEIGHT, lane_count,
+                 left.col_indices + chunk_start, left.values + chunk_start,
+                 (chunk_end - chunk_start) / SELL_CHUNK_HEIGHT,
+                 right.values, right.col_count);
+  }
+
+  repetition_tester_close_time(tester);
+
+  // Padding included, it's all multiplied
+  u64 product_count = (u64)left.padded_count * right.col_count;
+  u64 output_count  = (u64)output.row_count * output.col_count;
+  spmm_observe_counts(tester, 2 * product_count,
+                 2 * (u64)left.chunk_count + 2 * (u64)left.padded_count + product_count + output_count,
+                 sizeof(u32) * (u64)left.chunk_count * (2 + SELL_CHUNK_HEIGHT) +
+                 (sizeof(u32) + sizeof(f64)) * (u64)left.padded_count +
+                 sizeof(f64) * (product_count + output_count));
+}
+
+// Blocks hanging off the matrix's edge, or the right operand's, go the slow way with bounds
+static
+void bcsr_dense_edge_block(Repetition_Tester *tester, f64 *block, u32 block_rows, u32 block_cols,
+                           usize row_base, usize col_base, usize row_limit, usize col_limit,
+                           Dense_Matrix right, Dense_Matrix output)
+{
+  for (usize r = 0; r < row_limit; r++)
+  {
+    for (usize c = 0; c < col_limit; c++)
+    {
+      f64 left_value = LOAD(block[r * block_cols + c]);
+
+      for (usize right_col = 0; right_col < right.col_count; right_col++)
+      {
+        usize right_index  = (col_base + c) * right.col_count + right_col;
+        usize output_index = (row_base + r) * output.col_count + right_col;
+
+        f64 right_value   = LOAD(right.values[right_index]);
+        f64 current_value = LOAD(output.values[output_index]);
+
+        f64 result_value = current_value;
+        FMADD(result_value, left_value, right_value);
+
+        STORE(output.values[output_index], result_value);
+      }
+    }
+  }
+}
+
+static
+void bcsr_bcsr_edge_block(Repetition_Tester *tester, f64 *left_block, f64 *right_block,
+                          u32 block_rows, u32 block_cols, usize row_base, usize col_base,
+                          usize row_limit, usize col_limit, Dense_Matrix output)
+{
+  for (usize r = 0; r < row_limit; r++)
+  {
+    for (usize cc = 0; cc < col_limit; cc++)
+    {
+      usize output_index = (row_base + r) * output.col_count + col_base + cc;
+      f64 sum = LOAD(output.values[output_index]);
+
+      for (usize c = 0; c < block_cols; c++)
+      {
+        f64 left_value  = LOAD(left_block[r * block_cols + c]);
+        f64 right_value = LOAD(right_block[c * block_cols + cc]);
+        FMADD(sum, left_value, right_value);
+      }
+
+      STORE(output.values[output_index], sum);
+    }
+  }
+}
+
+// One pair of kernels per block shape, so every loop over R and C has a constant trip count and
+// unrolls into straight line code. The left block sits in registers while it sweeps across the
+// right, one column index per R * C values instead of one per value.
+//
+// BCSR X BCSR wants the right in C x C blocks, so the left's block columns line up with its
+// block rows. Both with dense output, like csr_X_csr
+#define BCSR_KERNELS(R, C)                                                                        \
+static                                                                                            \
+void bcsr_dense_##R##x##C(Repetition_Tester *tester, BCSR_Matrix left, Dense_Matrix right,        \
+                          Dense_Matrix output)                                                    \
+{                                                                                                 \
+  for (usize block_row = 0; block_row < left.block_row_count; block_row++)                        \
+  {                                                                                               \
+    usize row_base  = block_row * R;                                                              \
+    usize row_limit = MIN(R, left.row_count - row_base);                                          \
+                                                                                                  \
+    usize block_start = LOAD(left.block_row_pointers[block_row]);                                 \
+    usize block_end   = LOAD(left.block_row_pointers[block_row + 1]);                             \
+                                                                                                  \
+    for (usize k = block_start; k < block_end; k++)                                               \
+    {                                                                                             \
+      usize block_col = LOAD(left.block_col_indices[k]);                                          \
+      usize col_base  = block_col * C;                                                            \
+      usize col_limit = MIN(C, left.col_count - col_base);                                        \
+      f64 *block = left.values + k * R * C;                                                       \
+                                                                                                  \
+      if (row_limit < R || col_limit < C)                                                         \
+      {                                                                                           \
+        bcsr_dense_edge_block(tester, block, R, C, row_base, col_base, row_limit, col_limit,      \
+                              right, output);                                                     \
+        continue;                                                                                 \
+      }                                                                                           \
+                                                                                                  \
+      f64 a[R][C];                                                                                \
+      for (usize r = 0; r < R; r++)                                                               \
+      {                                                                                           \
+        for (usize c = 0; c < C; c++)                                                             \
+        {                                                                                         \
+          a[r][c] = LOAD(block[r * C + c]);                                                       \
+        }                                                                                         \
+      }                                                                                           \
+                                                                                                  \
+      for (usize right_col = 0; right_col < right.col_count; right_col++)                         \
+      {                                                                                           \
+        f64 b[C];                                                                                 \
+        for (usize c = 0; c < C; c++)                                                             \
+        {                                                                                         \
+          b[c] = LOAD(right.values[(col_base + c) * right.col_count + right_col]);                \
+        }                                                                                         \
+                                                                                                  \
+        for (usize r = 0; r < R; r++)                                                             \
+        {                                                                                         \
+          usize output_index = (row_base + r) * output.col_count + right_col;                     \
+          f64 sum = LOAD(output.values[output_index]);                                            \
+                                                                                                  \
+          for (usize c = 0; c < C; c++)                                                           \
+          {                                                                                       \
+            FMADD(sum, a[r][c], b[c]);                                                            \
+          }                                                                                       \
+                                                                                                  \
+          STORE(output.values[output_index], sum);                                                \
+        }                                                                                         \
+      }                                                                                           \
+    }                                                                                             \
+  }                                                                                               \
+}                                                                                                 \
+                                                                                                  \
+static                                                                                            \
+void bcsr_bcsr_##R##x##C(Repetition_Tester *tester, BCSR_Matrix left, BCSR_Matrix right,         \
+                         Dense_Matrix output)                                                     \
+{                                                                                                 \
+  for (usize block_row = 0; block_row < left.block_row_count; block_row++)                        \
+  {                                                                                               \
+    usize row_base  = block_row * R;                                                              \
+    usize row_limit = MIN(R, left.row_count - row_base);                                          \
+                                                                                                  \
+    usize block_start = LOAD(left.block_row_pointers[block_row]);                                 \
+    usize block_end   = LOAD(left.block_row_pointers[block_row + 1]);                             \
+                                                                                                  \
+    for (usize k = block_start; k < block_end; k++)                                               \
+    {                                                                                             \
+      usize block_col = LOAD(left.block_col_indices[k]);                                          \
+      f64 *left_block = left.values + k * R * C;                                                  \
+                                                                                                  \
+      f64 a[R][C];                                                                                \
+      for (usize r = 0; r < R; r++)                                                               \
+      {                                                                                           \
+        for (usize c = 0; c < C; c++)                                                             \
+        {                                                                                         \
+          a[r][c] = LOAD(left_block[r * C + c]);                                                  \
+        }                                                                                         \
+      }                                                                                           \
+                                                                                                  \
+      usize right_start = LOAD(right.block_row_pointers[block_col]);                              \
+      usize right_end   = LOAD(right.block_row_pointers[block_col + 1]);                          \
+                                                                                                  \
+      for (usize j = right_start; j < right_end; j++)                                             \
+      {                                                                                           \
+        usize right_block_col = LOAD(right.block_col_indices[j]);                                 \
+        usize col_base  = right_block_col * C;                                                    \
+        usize col_limit = MIN(C, right.col_count - col_base);                                     \
+        f64 *right_block = right.values + j * C * C;                                              \
+                                                                                                  \
+        if (row_limit < R || col_limit < C)                                                       \
+        {                                                                                         \
+          bcsr_bcsr_edge_block(tester, left_block, right_block, R, C, row_base, col_base,         \
+                               row_limit, col_limit, output);                                     \
+          continue;                                                                               \
+        }                                                                                         \
+                                                                                                  \
+        f64 b[C][C];                                                                              \
+        for (usize c = 0; c < C; c++)                                                             \
+        {                                                                                         \
+          for (usize cc = 0; cc < C; cc++)                                                        \
+          {                                                                                       \
+            b[c][cc] = LOAD(right_block[c * C + cc]);                                             \
+          }                                                                                       \
+        }                                                                                         \
+                                                                                                  \
+        for (usize r = 0; r < R; r++)                                                             \
+        {                                                                                         \
+          for (usize cc = 0; cc < C; cc++)                                                        \
+          {                                                                                       \
+            usize output_index = (row_base + r) * output.col_count + col_base + cc;               \
+            f64 sum = LOAD(output.values[output_index]);                                          \
+                                                                                                  \
+            for (usize c = 0; c < C; c++)                                                         \
+            {                                                                                     \
+              FMADD(sum, a[r][c], b[c][cc]);                                                      \
+            }                                                                                     \
+                                                                                                  \
+            STORE(output.values[output_index], sum);                                              \
+          }                                                                                       \
+        }                                                                                         \
+      }                                                                                           \
+    }                                                                                             \
+  }                                                                                               \
+}
+
+BCSR_KERNELS(1, 1)
+BCSR_KERNELS(2, 2)
+BCSR_KERNELS(3, 3)
+BCSR_KERNELS(4, 4)
+BCSR_KERNELS(2, 4)
+BCSR_KERNELS(4, 2)
+
+// The block shapes the autotuner picks from. 1x1 is just CSR, so there's always a fallback
+BCSR_Kernels spmm_bcsr_kernels[BCSR_KERNEL_COUNT] =
+{
+  {1, 1, bcsr_dense_1x1, bcsr_bcsr_1x1},
+  {2, 2, bcsr_dense_2x2, bcsr_bcsr_2x2},
+  {3, 3, bcsr_dense_3x3, bcsr_bcsr_3x3},
+  {4, 4, bcsr_dense_4x4, bcsr_bcsr_4x4},
+  {2, 4, bcsr_dense_2x4, bcsr_bcsr_2x4},
+  {4, 2, bcsr_dense_4x2, bcsr_bcsr_4x2},
+};
+
+static
+BCSR_Kernels *bcsr_kernels_for(u32 block_rows, u32 block_cols)
+{
+  BCSR_Kernels *result = NULL;
+
+  for (usize i = 0; i < STATIC_COUNT(spmm_bcsr_kernels); i++)
+  {
+    if (spmm_bcsr_kernels[i].block_rows == block_rows && spmm_bcsr_kernels[i].block_cols == block_cols)
+    {
+      result = spmm_bcsr_kernels + i;
+    }
+  }
+
+  return result;
+}
+
+void spmm_matmul_bcsr_dense(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  BCSR_Matrix left    = params->left.bcsr;
+  Dense_Matrix right  = spmm_operand_dense(params, &params->right);
+  Dense_Matrix output = params->output;
+
+  BCSR_Dense_Kernel *kernel = bcsr_kernels_for(left.block_rows, left.block_cols)->dense;
+
+  repetition_tester_begin_time(tester);
+
+  kernel(tester, left, right, output);
+
+  repetition_tester_close_time(tester);
+}
+
+void spmm_matmul_bcsr_bcsr(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  BCSR_Matrix left    = params->left.bcsr;
+  BCSR_Matrix right   = params->right.bcsr;
+  Dense_Matrix output = params->output;
+
+  BCSR_BCSR_Kernel *kernel = bcsr_kernels_for(left.block_rows, left.block_cols)->bcsr;
+
+  repetition_tester_begin_time(tester);
+
+  kernel(tester, left, right, output);
+
+  repetition_tester_close_time(tester);
+}
+
+// Runtime selection. Every kernel that makes the whole product gets a flop and byte estimate from
+// the operands' counts alone, the same formulas as table.md and plot.py, extended to the other
+// formats. Put against the roofline's two ceilings, whichever takes longer is the kernel's time,
+// plus streaming through a conversion for any format an operand doesn't have yet
+
+static Roofline_Ceilings roofline_ceilings =
+{
+  .flops_per_tick = 27.311,
+  .bytes_per_tick = 30.041,
+};
+
+// fmadd_asm is 4 wide, a scalar kernel at best gets one of those lanes
+#define COST_SCALAR_LANES 4.0
+
+Spmm_Shape spmm_shape_from(Operation_Parameters *params)
+{
+  Matrix_Reps *left  = &params->left;
+  Matrix_Reps *right = &params->right;
+
+  Spmm_Shape result =
+  {
+    .row_count            = left->csr.row_count,
+    .inner_count          = left->csr.col_count,
+    .col_count            = right->csr.col_count,
+    .left_non_zero_count  = left->csr.non_zero_count,
+    .right_non_zero_count = right->csr.non_zero_count,
+  };
+
+  result.product_count = result.left_non_zero_count * result.right_non_zero_count / MAX(result.inner_count, 1.0);
+
+  result.left_non_empty_row_count = left->dcsr.row_pointers ? left->dcsr.non_empty_row_count : result.row_count;
+  result.left_non_empty_col_count = left->dcsc.col_pointers ? left->dcsc.non_empty_col_count : result.inner_count;
+
+  result.left_sell_padded_count = left->sell.chunk_pointers ? left->sell.padded_count : result.left_non_zero_count;
+  result.left_sell_chunk_count  = left->sell.chunk_pointers ? left->sell.chunk_count
+                                                            : (result.row_count + SELL_CHUNK_HEIGHT - 1) / SELL_CHUNK_HEIGHT;
+
+  b32 has_blocks = left->bcsr.block_row_pointers && right->bcsr.block_row_pointers;
+
+  result.left_block_count      = has_blocks ? left->bcsr.block_count     : result.left_non_zero_count;
+  result.left_block_row_count  = has_blocks ? left->bcsr.block_row_count : result.row_count;
+  result.left_block_rows       = has_blocks ? left->bcsr.block_rows      : 1.0;
+  result.left_block_cols       = has_blocks ? left->bcsr.block_cols      : 1.0;
+  result.right_block_count     = has_blocks ? right->bcsr.block_count     : result.right_non_zero_count;
+  result.right_block_row_count = has_blocks ? right->bcsr.block_row_count : result.inner_count;
+
+  return result;
+}
+
+static
+Spmm_Cost cost_dense_dense(Spmm_Shape *s)
+{
+  f64 products = s->row_count * s->inner_count * s->col_count;
+
+  Spmm_Cost result =
+  {
+    .flops = 2 * products,
+    .bytes = sizeof(f64) * (2 * products + s->row_count * s->col_count),
+  };
+
+  return result;
+}
+
+// Only what goes past the caches, packing and the output slices. The packed panels are reread
+// out of L1/L2 and don't count against the bandwidth
+static
+Spmm_Cost cost_dense_dense_blocked(Spmm_Shape *s)
+{
+  f64 col_blocks = (f64)(((u64)s->col_count + GEMM_NC - 1) / GEMM_NC);
+  f64 k_blocks   = (f64)(((u64)s->inner_count + GEMM_KC - 1) / GEMM_KC);
+
+  Spmm_Cost result =
+  {
+    .flops = 2 * s->row_count * s->inner_count * s->col_count,
+    .bytes = sizeof(f64) * (2 * s->row_count * s->inner_count * col_blocks + 2 * s->inner_count * s->col_count +
+                            2 * s->row_count * s->col_count * k_blocks),
+  };
+
+  return result;
+}
+
+// Also the SIMD one, it moves the same bytes
+static
+Spmm_Cost cost_dense_csr(Spmm_Shape *s)
+{
+  f64 products = s->row_count * s->right_non_zero_count;
+
+  Spmm_Cost result =
+  {
+    .flops = 2 * products,
+    .bytes = (sizeof(f64) + 2 * sizeof(u32)) * s->row_count * s->inner_count +
+             (sizeof(u32) + 3 * sizeof(f64)) * products,
+  };
+
+  return result;
+}
+
+static
+Spmm_Cost cost_dense_csc(Spmm_Shape *s)
+{
+  f64 products = s->row_count * s->right_non_zero_count;
+
+  Spmm_Cost result =
+  {
+    .flops = 2 * products,
+    .bytes = (2 * sizeof(u32) + sizeof(f64)) * s->row_count * s->col_count +
+             (sizeof(u32) + 2 * sizeof(f64)) * products,
+  };
+
+  return result;
+}
+
+static
+Spmm_Cost cost_csr_dense(Spmm_Shape *s)
+{
+  f64 products = s->left_non_zero_count * s->col_count;
+
+  Spmm_Cost result =
+  {
+    .flops = 2 * products,
+    .bytes = 2 * sizeof(u32) * s->row_count + (sizeof(u32) + sizeof(f64)) * s->left_non_zero_count +
+             3 * sizeof(f64) * products,
+  };
+
+  return result;
+}
+
+// Output row stays in registers, so each product is just the one right load
+static
+Spmm_Cost cost_csr_dense_simd(Spmm_Shape *s)
+{
+  f64 products = s->left_non_zero_count * s->col_count;
+
+  Spmm_Cost result =
+  {
+    .flops = 2 * products,
+    .bytes = 2 * sizeof(u32) * s->row_count + (sizeof(u32) + sizeof(f64)) * s->left_non_zero_count +
+             sizeof(f64) * (products + s->row_count * s->col_count),
+  };
+
+  return result;
+}
+
+// The SIMD one's traffic plus another pass over left per panel, same as count_csr_dense_tiled().
+// What the panels save is L2 misses on right that a byte count can't see, and measured that
+// doesn't make up for the extra passes, so this never comes in under the SIMD one
+static
+Spmm_Cost cost_csr_dense_tiled(Spmm_Shape *s)
+{
+  usize panel_width = spmm_dense_panel_width((usize)s->inner_count, (usize)s->col_count);
+  f64 panel_count   = panel_width ? (f64)(((usize)s->col_count + panel_width - 1) / panel_width) : 0.0;
+
+  Spmm_Cost result = cost_csr_dense_simd(s);
+  result.bytes += MAX(panel_count - 1.0, 0.0) *
+                  (2 * sizeof(u32) * s->row_count + (sizeof(u32) + sizeof(f64)) * s->left_non_zero_count);
+
+  return result;
+}
+
+static
+Spmm_Cost cost_csc_dense(Spmm_Shape *s)
+{
+  f64 products = s->left_non_zero_count * s->col_count;
+
+  Spmm_Cost result =
+  {
+    .flops = 2 * products,
+    .bytes = 2 * sizeof(u32) * s->inner_count + (sizeof(u32) + sizeof(f64)) * s->left_non_zero_count +
+             3 * sizeof(f64) * products,
+  };
+
+  return result;
+}
+
+static
+Spmm_Cost cost_csc_dense_simd(Spmm_Shape *s)
+{
+  f64 products = s->left_non_zero_count * s->col_count;
+
+  Spmm_Cost result =
+  {
+    .flops = 2 * products,
+    .bytes = 2 * sizeof(u32) * s->inner_count + (sizeof(u32) + sizeof(f64)) * s->left_non_zero_count +
+             sizeof(f64) * (s->inner_count * s->col_count + 2 * products),
+  };
+
+  return result;
+}
+
+static
+Spmm_Cost cost_csr_csr(Spmm_Shape *s)
+{
+  Spmm_Cost result =
+  {
+    .flops = 2 * s->product_count,
+    .bytes = 2 * sizeof(u32) * s->row_count + (3 * sizeof(u32) + sizeof(f64)) * s->left_non_zero_count +
+             (sizeof(u32) + 3 * sizeof(f64)) * s->product_count,
+  };
+
+  return result;
+}
+
+// Same as the CSR one, the SIMD traffic plus the extra passes over left
+static
+Spmm_Cost cost_csc_dense_tiled(Spmm_Shape *s)
+{
+  usize panel_width = spmm_dense_panel_width((usize)s->row_count, (usize)s->col_count);
+  f64 panel_count   = panel_width ? (f64)(((usize)s->col_count + panel_width - 1) / panel_width) : 0.0;
+
+  Spmm_Cost result = cost_csc_dense_simd(s);
+  result.bytes += MAX(panel_count - 1.0, 0.0) *
+                  (2 * sizeof(u32) * s->inner_count + (sizeof(u32) + sizeof(f64)) * s->left_non_zero_count);
+
+  return result;
+}
+
+// Plus writing out whatever the products land on
+static
+Spmm_Cost cost_csr_csr_sparse(Spmm_Shape *s)
+{
+  Spmm_Cost result = cost_csr_csr(s);
+  result.bytes += (sizeof(u32) + sizeof(f64)) * MIN(s->product_count, s->row_count * s->col_count);
+
+  return result;
+}
+
+// Every output entry merges a left row against a right column
+static
+Spmm_Cost cost_csr_csc(Spmm_Shape *s)
+{
+  Spmm_Cost result =
+  {
+    .flops = 2 * s->product_count,
+    .bytes = 2 * sizeof(u32) * s->row_count + (2 * sizeof(u32) + sizeof(f64)) * s->row_count * s->col_count +
+             sizeof(u32) * (s->left_non_zero_count * s->col_count + s->right_non_zero_count * s->row_count) +
+             2 * sizeof(f64) * s->product_count,
+  };
+
+  return result;
+}
+
+// Rows and columns are all about the same length in these estimates, so it's the SIMD merge,
+// which reads the same indices, just 8 at a time
+static
+Spmm_Cost cost_csr_csc_adaptive(Spmm_Shape *s)
+{
+  return cost_csr_csc(s);
+}
+
+static
+Spmm_Cost cost_csc_csr(Spmm_Shape *s)
+{
+  Spmm_Cost result =
+  {
+    .flops = 2 * s->product_count,
+    .bytes = 4 * sizeof(u32) * s->inner_count + (sizeof(u32) + sizeof(f64)) * s->left_non_zero_count +
+             (sizeof(u32) + 3 * sizeof(f64)) * s->product_count,
+  };
+
+  return result;
+}
+
+static
+Spmm_Cost cost_csc_csc(Spmm_Shape *s)
+{
+  Spmm_Cost result =
+  {
+    .flops = 2 * s->product_count,
+    .bytes = 2 * sizeof(u32) * s->col_count + (3 * sizeof(u32) + sizeof(f64)) * s->right_non_zero_count +
+             (sizeof(u32) + 3 * sizeof(f64)) * s->product_count,
+  };
+
+  return result;
+}
+
+// Padding is multiplied like anything else
+static
+Spmm_Cost cost_bcsr_dense(Spmm_Shape *s)
+{
+  f64 block_size = s->left_block_rows * s->left_block_cols;
+
+  Spmm_Cost result =
+  {
+    .flops = 2 * s->left_block_count * block_size * s->col_count,
+    .bytes = 2 * sizeof(u32) * s->left_block_row_count +
+             s->left_block_count * (sizeof(u32) + sizeof(f64) * block_size) +
+             sizeof(f64) * s->left_block_count * s->col_count * (s->left_block_cols + 2 * s->left_block_rows),
+  };
+
+  return result;
+}
+
+static
+Spmm_Cost cost_bcsr_bcsr(Spmm_Shape *s)
+{
+  f64 block_size = s->left_block_rows * s->left_block_cols;
+  f64 right_size = s->left_block_cols * s->left_block_cols;
+  f64 pairs      = s->left_block_count * s->right_block_count / MAX(s->right_block_row_count, 1.0);
+
+  Spmm_Cost result =
+  {
+    .flops = 2 * pairs * s->left_block_rows * right_size,
+    .bytes = 2 * sizeof(u32) * s->left_block_row_count +
+             s->left_block_count * (3 * sizeof(u32) + sizeof(f64) * block_size) +
+             pairs * (sizeof(u32) + sizeof(f64) * (right_size + 2 * block_size)),
+  };
+
+  return result;
+}
+
+static
+Spmm_Cost cost_sell_dense(Spmm_Shape *s)
+{
+  f64 products = s->left_sell_padded_count * s->col_count;
+
+  Spmm_Cost result =
+  {
+    .flops = 2 * products,
+    .bytes = sizeof(u32) * s->left_sell_chunk_count * (2 + SELL_CHUNK_HEIGHT) +
+             (sizeof(u32) + sizeof(f64)) * s->left_sell_padded_count +
+             sizeof(f64) * (products + s->row_count * s->col_count),
+  };
+
+  return result;
+}
+
+// The doubly compressed ones swap the pointer pairs for an id and a pair per non empty row/col
+static
+Spmm_Cost cost_dcsr_dense(Spmm_Shape *s)
+{
+  Spmm_Cost result = cost_csr_dense(s);
+  result.bytes += sizeof(u32) * (3 * s->left_non_empty_row_count - 2 * s->row_count);
+
+  return result;
+}
+
+static
+Spmm_Cost cost_dcsr_csr(Spmm_Shape *s)
+{
+  Spmm_Cost result = cost_csr_csr(s);
+  result.bytes += sizeof(u32) * (3 * s->left_non_empty_row_count - 2 * s->row_count);
+
+  return result;
+}
+
+static
+Spmm_Cost cost_dcsc_dense(Spmm_Shape *s)
+{
+  Spmm_Cost result = cost_csc_dense(s);
+  result.bytes += sizeof(u32) * (3 * s->left_non_empty_col_count - 2 * s->inner_count);
+
+  return result;
+}
+
+static
+Spmm_Cost cost_dcsc_csr(Spmm_Shape *s)
+{
+  Spmm_Cost result = cost_csc_csr(s);
+  result.bytes += sizeof(u32) * (5 * s->left_non_empty_col_count - 4 * s->inner_count);
+
+  return result;
+}
+
+// Row index per non zero instead of the pointers
+static
+Spmm_Cost cost_coo_dense(Spmm_Shape *s)
+{
+  Spmm_Cost result = cost_csr_dense(s);
+  result.bytes += sizeof(u32) * (s->left_non_zero_count - 2 * s->row_count);
+
+  return result;
+}
+
+static
+Spmm_Cost cost_coo_csr(Spmm_Shape *s)
+{
+  Spmm_Cost result = cost_csr_csr(s);
+  result.bytes += sizeof(u32) * (s->left_non_zero_count - 2 * s->row_count);
+
+  return result;
+}
+
+// Reading the CSR or CSC it's built from, then writing the new format
+static
+f64 conversion_bytes(Spmm_Shape *s, Matrix_Format format, b32 is_right)
+{
+  f64 major_count    = is_right ? s->inner_count : s->row_count;
+  f64 minor_count    = is_right ? s->col_count   : s->inner_count;
+  f64 non_zero_count = is_right ? s->right_non_zero_count : s->left_non_zero_count;
+
+  f64 read = 2 * sizeof(u32) * major_count + (sizeof(u32) + sizeof(f64)) * non_zero_count;
+
+  // Same as observe_transpose()
+  f64 transpose = (3 * sizeof(u32) + 2 * sizeof(f64)) * non_zero_count +
+                  sizeof(u32) * (major_count + 2 * minor_count);
+
+  f64 result = 0.0;
+  switch (format)
+  {
+    case MAT_DENSE:
+    {
+      result = read + sizeof(f64) * major_count * minor_count;
+    } break;
+    case MAT_CSR:
+    case MAT_CSC:
+    {
+      result = transpose;
+    } break;
+    case MAT_BCSR:
+    {
+      f64 block_count     = is_right ? s->right_block_count     : s->left_block_count;
+      f64 block_row_count = is_right ? s->right_block_row_count : s->left_block_row_count;
+      f64 block_size      = s->left_block_cols * (is_right ? s->left_block_cols : s->left_block_rows);
+
+      result = read + sizeof(u32) * block_row_count + block_count * (sizeof(u32) + sizeof(f64) * block_size);
+    } break;
+    case MAT_SELL:
+    {
+      result = read + sizeof(u32) * s->left_sell_chunk_count * (2 + SELL_CHUNK_HEIGHT) +
+               (sizeof(u32) + sizeof(f64)) * s->left_sell_padded_count;
+    } break;
+    case MAT_DCSR:
+    {
+      result = read + 3 * sizeof(u32) * s->left_non_empty_row_count + (sizeof(u32) + sizeof(f64)) * non_zero_count;
+    } break;
+    case MAT_DCSC:
+    {
+      // Off the CSC, so the pointers walked are the columns'
+      result = 2 * sizeof(u32) * minor_count + (sizeof(u32) + sizeof(f64)) * non_zero_count +
+               3 * sizeof(u32) * s->left_non_empty_col_count + (sizeof(u32) + sizeof(f64)) * non_zero_count;
+    } break;
+    case MAT_COO:
+    {
+      result = read + (2 * sizeof(u32) + sizeof(f64)) * non_zero_count;
+    } break;
+    default: break;
+  }
+
+  return result;
+}
+
+// Not the threaded ones, the ceilings are one core's. Nor the split SpGEMM, half a product each
+Auto_Candidate spmm_auto_candidates[AUTO_CANDIDATE_COUNT] =
+{
+  {spmm_matmul_dense_dense,         cost_dense_dense,         MAT_DENSE, MAT_DENSE, false},
+  {spmm_matmul_dense_dense_blocked, cost_dense_dense_blocked, MAT_DENSE, MAT_DENSE, true},
+  {spmm_matmul_dense_csr,           cost_dense_csr,           MAT_DENSE, MAT_CSR,   false},
+  {spmm_matmul_dense_csr_simd,      cost_dense_csr,           MAT_DENSE, MAT_CSR,   true},
+  {spmm_matmul_dense_csc,           cost_dense_csc,           MAT_DENSE, MAT_CSC,   false},
+  {spmm_matmul_csr_dense,           cost_csr_dense,           MAT_CSR,   MAT_DENSE, false},
+  {spmm_matmul_csr_dense_simd,      cost_csr_dense_simd,      MAT_CSR,   MAT_DENSE, true},
+  {spmm_matmul_csr_dense_tiled,     cost_csr_dense_tiled,     MAT_CSR,   MAT_DENSE, true},
+  {spmm_matmul_csr_csr,             cost_csr_csr,             MAT_CSR,   MAT_CSR,   false},
+  {spmm_matmul_csr_csr_sparse,      cost_csr_csr_sparse,      MAT_CSR,   MAT_CSR,   false},
+  {spmm_matmul_csr_csc,             cost_csr_csc,             MAT_CSR,   MAT_CSC,   false},
+  {spmm_matmul_csr_csc_adaptive,    cost_csr_csc_adaptive,    MAT_CSR,   MAT_CSC,   true},
+  {spmm_matmul_csc_dense,           cost_csc_dense,           MAT_CSC,   MAT_DENSE, false},
+  {spmm_matmul_csc_dense_simd,      cost_csc_dense_simd,      MAT_CSC,   MAT_DENSE, true},
+  {spmm_matmul_csc_dense_tiled,     cost_csc_dense_tiled,     MAT_CSC,   MAT_DENSE, true},
+  {spmm_matmul_csc_csr,             cost_csc_csr,             MAT_CSC,   MAT_CSR,   false},
+  {spmm_matmul_csc_csc,             cost_csc_csc,             MAT_CSC,   MAT_CSC,   false},
+  {spmm_matmul_bcsr_dense,          cost_bcsr_dense,          MAT_BCSR,  MAT_DENSE, false},
+  {spmm_matmul_bcsr_bcsr,           cost_bcsr_bcsr,           MAT_BCSR,  MAT_BCSR,  false},
+  {spmm_matmul_sell_dense,          cost_sell_dense,          MAT_SELL,  MAT_DENSE, true},
+  {spmm_matmul_dcsr_dense,          cost_dcsr_dense,          MAT_DCSR,  MAT_DENSE, false},
+  {spmm_matmul_dcsr_csr,            cost_dcsr_csr,            MAT_DCSR,  MAT_CSR,   false},
+  {spmm_matmul_dcsc_dense,          cost_dcsc_dense,          MAT_DCSC,  MAT_DENSE, false},
+  {spmm_matmul_dcsc_csr,            cost_dcsc_csr,            MAT_DCSC,  MAT_CSR,   false},
+  {spmm_matmul_coo_dense,           cost_coo_dense,           MAT_COO,   MAT_DENSE, false},
+  {spmm_matmul_coo_csr,             cost_coo_csr,             MAT_COO,   MAT_CSR,   false},
+};
+
+// Which formats an operand already has, by whether their arrays were ever allocated
+u32 spmm_held_formats(Matrix_Reps *operand)
+{
+  u32 result = 0;
+  result |= operand->dense.values             ? FORMAT_BIT(MAT_DENSE) : 0;
+  result |= operand->csr.row_pointers         ? FORMAT_BIT(MAT_CSR)   : 0;
+  result |= operand->csc.col_pointers         ? FORMAT_BIT(MAT_CSC)   : 0;
+  result |= operand->bcsr.block_row_pointers  ? FORMAT_BIT(MAT_BCSR)  : 0;
+  result |= operand->sell.chunk_pointers      ? FORMAT_BIT(MAT_SELL)  : 0;
+  result |= operand->dcsr.row_pointers        ? FORMAT_BIT(MAT_DCSR)  : 0;
+  result |= operand->dcsc.col_pointers        ? FORMAT_BIT(MAT_DCSC)  : 0;
+  result |= operand->coo.row_indices          ? FORMAT_BIT(MAT_COO)   : 0;
+
+  return result;
+}
+
+// Estimated time of one candidate, in the tester's time units, converting whatever isn't held
+static
+f64 auto_estimate(Auto_Candidate *candidate, Spmm_Shape *shape, u32 left_held, u32 right_held)
+{
+  f64 flop_ceiling = roofline_ceilings.flops_per_tick;
+  if (!candidate->vectorized || simd_level() == SIMD_SCALAR)
+  {
+    flop_ceiling /= COST_SCALAR_LANES;
+  }
+
+  Spmm_Cost cost = candidate->cost(shape);
+
+  f64 conversion = 0.0;
+  if (!(left_held & FORMAT_BIT(candidate->left)))
+  {
+    conversion += conversion_bytes(shape, candidate->left, false);
+
+    // DCSC comes off the CSC, which has to be made first if it isn't there
+    if (candidate->left == MAT_DCSC && !(left_held & FORMAT_BIT(MAT_CSC)))
+    {
+      conversion += conversion_bytes(shape, MAT_CSC, false);
+    }
+  }
+  if (!(right_held & FORMAT_BIT(candidate->right)))
+  {
+    conversion += conversion_bytes(shape, candidate->right, true);
+  }
+
+  f64 result = MAX(cost.flops / flop_ceiling, cost.bytes / roofline_ceilings.bytes_per_tick) +
+               conversion / roofline_ceilings.bytes_per_tick;
+
+  return result;
+}
+
+// Index into spmm_auto_candidates[]
+usize spmm_auto_choose(Operation_Parameters *params, u32 left_held, u32 right_held, f64 *out_estimate)
+{
+  Spmm_Shape shape = spmm_shape_from(params);
+
+  usize result = 0;
+  f64 best = auto_estimate(&spmm_auto_candidates[0], &shape, left_held, right_held);
+
+  for (usize candidate_idx = 1; candidate_idx < STATIC_COUNT(spmm_auto_candidates); candidate_idx++)
+  {
+    f64 estimate = auto_estimate(&spmm_auto_candidates[candidate_idx], &shape, left_held, right_held);
+    if (estimate < best)
+    {
+      best   = estimate;
+      result = candidate_idx;
+    }
+  }
+
+  if (out_estimate)
+  {
+    *out_estimate = best;
+  }
+
+  return result;
+}
+
+// Builds what the chosen kernel needs and keeps it in the params, like spmm_operand_dense(), so only
+// the first call pays for it. Always from the CSR, except DCSC which comes off the CSC
+static
+void auto_convert(Operation_Parameters *params, Matrix_Reps *operand, Matrix_Format format)
+{
+  b32 is_right = operand == &params->right;
+
+  if (spmm_held_formats(operand) & FORMAT_BIT(format))
+  {
+    // A right BCSR only works if its blocks line up with the left's
+    if (!(format == MAT_BCSR && is_right && operand->bcsr.block_rows != params->left.bcsr.block_cols))
+    {
+      return;
+    }
+  }
+
+  switch (format)
+  {
+    case MAT_DENSE:
+    {
+      spmm_operand_dense(params, operand);
+    } break;
+    case MAT_CSC:
+    {
+      operand->csc = csc_from_csr(params->arena, params->pool, &operand->csr);
+    } break;
+    case MAT_BCSR:
+    {
+      u32 block_rows = is_right ? params->left.bcsr.block_cols : 1;
+      u32 block_cols = is_right ? params->left.bcsr.block_cols : 1;
+      operand->bcsr = bcsr_from_csr(params->arena, &operand->csr, block_rows, block_cols);
+    } break;
+    case MAT_SELL:
+    {
+      operand->sell = sell_from_csr(params->arena, &operand->csr, SELL_DEFAULT_SORT_WINDOW);
+    } break;
+    case MAT_DCSR:
+    {
+      operand->dcsr = dcsr_from_csr(params->arena, &operand->csr);
+    } break;
+    case MAT_DCSC:
+    {
+      auto_convert(params, operand, MAT_CSC);
+      operand->dcsc = dcsc_from_csc(params->arena, &operand->csc);
+    } break;
+    case MAT_COO:
+    {
+      operand->coo = coo_from_csr(params->arena, &operand->csr);
+    } break;
+    default: break;
+  }
+}
+
+// Picks using what the operands have right now, then hands off to the kernel, which does the timing
+void spmm_auto(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  usize choice = spmm_auto_choose(params, spmm_held_formats(&params->left), spmm_held_formats(&params->right), NULL);
+  Auto_Candidate *candidate = &spmm_auto_candidates[choice];
+
+  auto_convert(params, &params->left,  candidate->left);
+  auto_convert(params, &params->right, candidate->right);
+
+  candidate->function(tester, params);
+}
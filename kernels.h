@@ -0,0 +1,217 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "../common.h"
+#include "formats.h"
+#include "threads.h"
+#include "simd.h"
+#include "spgemm.h"
+#include "gemm.h"
+#include "reorder.h"
+#include "spmm.h"
+
+// Every product kernel and the runtime selection between them, built into libspmm.a through
+// spmm.c and linked from there by reptest_spmm.c, so what it times is what ships. They all take
+// the tester and time their own region through the hooks in spmm.h, so whatever they build up
+// front stays out of the time. Built with OBSERVE_FLOPS/OBSERVE_MEMOPS (libspmm_observe.a) they
+// count into it through the same hooks. Whatever the benchmark needs is exported, all of it
+// prefixed spmm_ so nothing clashes with what else libspmm.a gets linked into, the rest stays
+// static to spmm.o
+
+#ifdef SPMM_LIBRARY
+// Only ever handed back to the hooks, the library never looks inside
+typedef struct Repetition_Tester Repetition_Tester;
+#endif // SPMM_LIBRARY
+
+typedef struct Operation_Parameters Operation_Parameters;
+struct Operation_Parameters
+{
+  // Dense operands are only built once a kernel asks for one, see spmm_operand_dense()
+  Matrix_Reps  left;
+  Matrix_Reps  right;
+  Dense_Matrix output;
+  Arena *arena;
+
+  // For kernels with sparse output, cleared by them every call
+  CSR_Matrix sparse_output;
+  Arena *output_arena;
+
+  // Built up front for the numeric only kernel
+  Spgemm_Plan spgemm_plan;
+
+  // Made the first time the blocked GEMM runs
+  Gemm_Workspace gemm_workspace;
+
+  // One left row scattered dense, for the adaptive CSR X CSC. Zeroed again after every row
+  f64 *intersect_lookup;
+
+  // Output of the f32 accumulating kernels, see compact_output_begin_f32()
+  Dense_F32_Matrix output_f32;
+
+  // See params_reordering(), and the permuted output the reordered kernels scatter back from
+  Reordering   reorderings[REORDER_COUNT];
+  Dense_Matrix reorder_output;
+
+  // Made the first time the libspmm entry runs, see spmm.h
+  struct Spmm_Plan *library_plan;
+
+  Thread_Pool *pool;
+};
+
+// Handed in with spmm_set_ceilings(), in the tester's own time units. Until then, what plot.py has
+// hardcoded from the dev machine
+typedef struct Roofline_Ceilings Roofline_Ceilings;
+struct Roofline_Ceilings
+{
+  f64 flops_per_tick;
+  f64 bytes_per_tick;
+};
+
+// Counts as f64, they only feed the estimates. Formats the operands don't have yet are guessed as
+// if nothing were padded or empty, and BCSR as if blocked 1x1, which is what spmm_auto() builds
+typedef struct Spmm_Shape Spmm_Shape;
+struct Spmm_Shape
+{
+  f64 row_count;   // LRC
+  f64 inner_count; // LCC = RRC
+  f64 col_count;   // RCC
+  f64 left_non_zero_count;
+  f64 right_non_zero_count;
+
+  // Multiply adds if the non zeros are spread evenly, LNZ * RNZ / RRC
+  f64 product_count;
+
+  f64 left_non_empty_row_count;
+  f64 left_non_empty_col_count;
+
+  f64 left_sell_padded_count;
+  f64 left_sell_chunk_count;
+
+  f64 left_block_count;
+  f64 left_block_row_count;
+  f64 left_block_rows;
+  f64 left_block_cols;
+  f64 right_block_count;
+  f64 right_block_row_count;
+};
+
+typedef struct Spmm_Cost Spmm_Cost;
+struct Spmm_Cost
+{
+  f64 flops;
+  f64 bytes;
+};
+
+typedef struct Auto_Candidate Auto_Candidate;
+struct Auto_Candidate
+{
+  void (*function)(Repetition_Tester *, Operation_Parameters *);
+  Spmm_Cost (*cost)(Spmm_Shape *);
+
+  // What it reads off each operand
+  Matrix_Format left;
+  Matrix_Format right;
+
+  // Otherwise held to one lane of the flop ceiling
+  b32 vectorized;
+};
+
+#define AUTO_CANDIDATE_COUNT 26
+
+extern Auto_Candidate spmm_auto_candidates[AUTO_CANDIDATE_COUNT];
+
+typedef void BCSR_Dense_Kernel(Repetition_Tester *tester, BCSR_Matrix left, Dense_Matrix right, Dense_Matrix output);
+typedef void BCSR_BCSR_Kernel(Repetition_Tester *tester, BCSR_Matrix left, BCSR_Matrix right, Dense_Matrix output);
+
+typedef struct BCSR_Kernels BCSR_Kernels;
+struct BCSR_Kernels
+{
+  u32 block_rows;
+  u32 block_cols;
+  BCSR_Dense_Kernel *dense;
+  BCSR_BCSR_Kernel  *bcsr;
+};
+
+#define BCSR_KERNEL_COUNT 6
+
+// The block shapes the autotuner picks from
+extern BCSR_Kernels spmm_bcsr_kernels[BCSR_KERNEL_COUNT];
+
+// Left rows with at least 1 / this of the inner dimension filled get scattered dense, so each
+// column is only a lookup per its own non zeros
+#define INTERSECT_LOOKUP_DENSITY 16
+
+Dense_Matrix spmm_operand_dense(Operation_Parameters *params, Matrix_Reps *operand);
+
+// Counts into the tester with OBSERVE_FLOPS/OBSERVE_MEMOPS, nothing otherwise
+void spmm_observe_counts(Repetition_Tester *tester, u64 flops, u64 memops, u64 bytes);
+
+// Columns of the right operand the tiled kernels take per pass over the left
+usize spmm_dense_panel_width(usize reused_rows, usize col_count);
+
+// NULL tester for none, it's only counted into
+Spgemm_Plan spmm_spgemm_symbolic(Repetition_Tester *tester, Arena *arena, CSR_Matrix left, CSR_Matrix right);
+
+Spmm_Shape spmm_shape_from(Operation_Parameters *params);
+
+#define FORMAT_BIT(format) (1u << (format))
+
+// Which formats an operand already has, one FORMAT_BIT() each
+u32 spmm_held_formats(Matrix_Reps *operand);
+
+// Index into spmm_auto_candidates[]
+usize spmm_auto_choose(Operation_Parameters *params, u32 left_held, u32 right_held, f64 *out_estimate);
+
+void spmm_auto(Repetition_Tester *tester, Operation_Parameters *params);
+
+void spmm_matmul_dense_dense(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_dense_dense_blocked(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_dense_csr(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_dense_csr_simd(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_dense_csc(Repetition_Tester *tester, Operation_Parameters *params);
+
+void spmm_matmul_csr_dense(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_dense_simd(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_dense_tiled(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_dense_threads_2(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_dense_threads_4(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_dense_threads_8(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_dense_threads_16(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_dense_threads_32(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_dense_rcm(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_dense_degree(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_dense_cluster(Repetition_Tester *tester, Operation_Parameters *params);
+
+void spmm_matmul_csc_dense(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csc_dense_simd(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csc_dense_tiled(Repetition_Tester *tester, Operation_Parameters *params);
+
+void spmm_matmul_csr_csr(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_csr_rcm(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_csr_degree(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_csr_cluster(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_csr_sparse(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_csr_symbolic(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_csr_numeric(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_csc(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_csc_adaptive(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csc_csr(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csc_csc(Repetition_Tester *tester, Operation_Parameters *params);
+
+void spmm_matmul_bcsr_dense(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_bcsr_bcsr(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_sell_dense(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_dcsr_dense(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_dcsr_csr(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_dcsc_dense(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_dcsc_csr(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_coo_dense(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_coo_csr(Repetition_Tester *tester, Operation_Parameters *params);
+
+void spmm_matmul_csr_f32_dense_f32(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_f32_dense_f32_acc64(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_bf16_dense_bf16(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_u16_dense(Repetition_Tester *tester, Operation_Parameters *params);
+void spmm_matmul_csr_f32_u16_dense_f32(Repetition_Tester *tester, Operation_Parameters *params);
+
+#endif // KERNELS_H
@@ -0,0 +1,481 @@
+#include "matrix_market.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct Matrix_Market_Parse Matrix_Market_Parse;
+struct Matrix_Market_Parse
+{
+  Matrix_Market_Field field;
+
+  u32 row_count;
+  u32 col_count;
+
+  // task_count + 1 of each, chunks always start at the beginning of a line
+  u8  **chunk_starts;
+  u64 *chunk_entry_offsets;
+
+  // Triplets, in file order
+  u32 *rows;
+  u32 *cols;
+  f64 *values;
+
+  // Set by whichever parse tasks find one, only read after the dispatch
+  b32 had_bad_entry;
+};
+
+static
+b32 mtx_is_space(u8 c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static
+b32 mtx_is_digit(u8 c)
+{
+  return c >= '0' && c <= '9';
+}
+
+static
+u8 *mtx_skip_line(u8 *at, u8 *end)
+{
+  u8 *newline = memchr(at, '\n', end - at);
+
+  return newline ? newline + 1 : end;
+}
+
+// Entry lines are anything that isn't blank or a % comment
+static
+b32 mtx_line_has_entry(u8 *at, u8 *end)
+{
+  while (at < end && mtx_is_space(*at))
+  {
+    at++;
+  }
+
+  return at < end && *at != '\n' && *at != '%';
+}
+
+static
+u64 mtx_parse_u64(u8 **cursor, u8 *end)
+{
+  u8 *at = *cursor;
+  while (at < end && mtx_is_space(*at))
+  {
+    at++;
+  }
+
+  // Saturates, so anything too long still fails the size checks instead of wrapping into range
+  u64 result = 0;
+  while (at < end && mtx_is_digit(*at))
+  {
+    u64 digit = *at - '0';
+    result = result <= ((u64)-1 - digit) / 10 ? result * 10 + digit : (u64)-1;
+    at++;
+  }
+
+  *cursor = at;
+  return result;
+}
+
+// Exact for the common case of a short mantissa and small exponent, where one multiply or divide
+// by an exactly representable power of ten rounds correctly. Anything else goes to strtod()
+static
+f64 mtx_parse_f64(u8 **cursor, u8 *end)
+{
+  static const f64 powers_of_ten[] =
+  {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+
+  u8 *at = *cursor;
+  while (at < end && mtx_is_space(*at))
+  {
+    at++;
+  }
+  u8 *start = at;
+
+  b32 negative = false;
+  if (at < end && (*at == '-' || *at == '+'))
+  {
+    negative = *at == '-';
+    at++;
+  }
+
+  u64 mantissa = 0;
+  i32 exponent = 0;
+  i32 digit_count = 0;
+  b32 exact = true;
+
+  while (at < end && mtx_is_digit(*at))
+  {
+    if (mantissa < (1ull << 53) / 10) { mantissa = mantissa * 10 + (*at - '0'); }
+    else                              { exponent += 1; exact &= *at == '0'; }
+    digit_count += 1;
+    at++;
+  }
+
+  if (at < end && *at == '.')
+  {
+    at++;
+    while (at < end && mtx_is_digit(*at))
+    {
+      if (mantissa < (1ull << 53) / 10) { mantissa = mantissa * 10 + (*at - '0'); exponent -= 1; }
+      else                              { exact &= *at == '0'; }
+      digit_count += 1;
+      at++;
+    }
+  }
+
+  if (at < end && (*at == 'e' || *at == 'E'))
+  {
+    at++;
+
+    b32 exponent_negative = false;
+    if (at < end && (*at == '-' || *at == '+'))
+    {
+      exponent_negative = *at == '-';
+      at++;
+    }
+
+    i32 written_exponent = 0;
+    while (at < end && mtx_is_digit(*at))
+    {
+      written_exponent = MIN(written_exponent * 10 + (*at - '0'), 100000);
+      at++;
+    }
+
+    exponent += exponent_negative ? -written_exponent : written_exponent;
+  }
+
+  f64 result = 0.0;
+
+  if (digit_count > 0 && exact && exponent >= -22 && exponent <= 22)
+  {
+    result = exponent < 0 ? (f64)mantissa / powers_of_ten[-exponent]
+                          : (f64)mantissa * powers_of_ten[exponent];
+    result = negative ? -result : result;
+  }
+  else
+  {
+    // Mapping isn't null terminated
+    char buffer[128] = {0};
+    u8 *token_end = start;
+    while (token_end < end && !mtx_is_space(*token_end) && *token_end != '\n')
+    {
+      token_end++;
+    }
+    MEM_COPY(buffer, start, MIN(token_end - start, (isize)sizeof(buffer) - 1));
+
+    result = strtod(buffer, NULL);
+    at = token_end;
+  }
+
+  *cursor = at;
+  return result;
+}
+
+static
+void mtx_count_task(void *user, u32 task_index, u32 task_count)
+{
+  Matrix_Market_Parse *parse = user;
+
+  u8 *at  = parse->chunk_starts[task_index];
+  u8 *end = parse->chunk_starts[task_index + 1];
+
+  u64 entry_count = 0;
+  while (at < end)
+  {
+    entry_count += mtx_line_has_entry(at, end);
+    at = mtx_skip_line(at, end);
+  }
+
+  // Prefix summed once every task is done
+  parse->chunk_entry_offsets[task_index + 1] = entry_count;
+}
+
+static
+void mtx_parse_task(void *user, u32 task_index, u32 task_count)
+{
+  Matrix_Market_Parse *parse = user;
+
+  u8 *at  = parse->chunk_starts[task_index];
+  u8 *end = parse->chunk_starts[task_index + 1];
+
+  u64 entry_index = parse->chunk_entry_offsets[task_index];
+
+  while (at < end)
+  {
+    u8 *line_end = mtx_skip_line(at, end);
+
+    if (mtx_line_has_entry(at, line_end))
+    {
+      // 1 based
+      u64 row = mtx_parse_u64(&at, line_end);
+      u64 col = mtx_parse_u64(&at, line_end);
+
+      f64 value = 1.0;
+      if (parse->field != MTX_FIELD_PATTERN)
+      {
+        value = mtx_parse_f64(&at, line_end);
+      }
+
+      if (row == 0 || col == 0 || row > parse->row_count || col > parse->col_count)
+      {
+        __atomic_store_n(&parse->had_bad_entry, true, __ATOMIC_RELAXED);
+        row = 1;
+        col = 1;
+      }
+
+      parse->rows[entry_index]   = (u32)(row - 1);
+      parse->cols[entry_index]   = (u32)(col - 1);
+      parse->values[entry_index] = value;
+      entry_index += 1;
+    }
+
+    at = line_end;
+  }
+}
+
+// Matrix market entries at the same coordinate add up. Each row's columns are already sorted so
+// duplicates sit next to each other, summed and packed down in place
+static
+void mtx_merge_duplicates(CSR_Matrix *csr)
+{
+  u32 write = 0;
+  u32 read  = 0;
+
+  for (u32 row = 0; row < csr->row_count; row++)
+  {
+    u32 row_close = csr->row_pointers[row + 1];
+    u32 row_start = write;
+
+    for (; read < row_close; read++)
+    {
+      if (write > row_start && csr->col_indices[write - 1] == csr->col_indices[read])
+      {
+        csr->values[write - 1] += csr->values[read];
+      }
+      else
+      {
+        csr->col_indices[write] = csr->col_indices[read];
+        csr->values[write]      = csr->values[read];
+        write += 1;
+      }
+    }
+
+    csr->row_pointers[row + 1] = write;
+  }
+
+  csr->non_zero_count = write;
+}
+
+// Next whitespace separated token on the line, lower cased into the buffer
+static
+void mtx_header_token(u8 **cursor, u8 *end, char *buffer, usize buffer_size)
+{
+  u8 *at = *cursor;
+  while (at < end && mtx_is_space(*at))
+  {
+    at++;
+  }
+
+  usize length = 0;
+  while (at < end && !mtx_is_space(*at) && *at != '\n')
+  {
+    if (length + 1 < buffer_size)
+    {
+      u8 c = *at;
+      buffer[length++] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+    at++;
+  }
+  buffer[length] = 0;
+
+  *cursor = at;
+}
+
+static
+b32 matrix_market_load(Arena *arena, Thread_Pool *pool, char *path, CSR_Matrix *out_csr, CSC_Matrix *out_csc)
+{
+  b32 result = false;
+
+  int file = open(path, O_RDONLY);
+  if (file < 0)
+  {
+    LOG_ERROR("Unable to open matrix market file: %s", path);
+    return result;
+  }
+
+  struct stat file_stat = {0};
+  fstat(file, &file_stat);
+  usize file_size = file_stat.st_size;
+
+  u8 *mapping = file_size ? mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+  close(file);
+
+  if (mapping == MAP_FAILED)
+  {
+    LOG_ERROR("Unable to map matrix market file: %s", path);
+    return result;
+  }
+  madvise(mapping, file_size, MADV_SEQUENTIAL);
+
+  u8 *at  = mapping;
+  u8 *end = mapping + file_size;
+
+  // Banner
+  char banner[32], object[32], format[32], field_name[32], symmetry_name[32];
+  mtx_header_token(&at, end, banner, sizeof(banner));
+  mtx_header_token(&at, end, object, sizeof(object));
+  mtx_header_token(&at, end, format, sizeof(format));
+  mtx_header_token(&at, end, field_name, sizeof(field_name));
+  mtx_header_token(&at, end, symmetry_name, sizeof(symmetry_name));
+  at = mtx_skip_line(at, end);
+
+  Matrix_Market_Parse parse = {0};
+  Matrix_Market_Symmetry symmetry = MTX_SYMMETRY_GENERAL;
+
+  b32 header_ok = strcmp(banner, "%%matrixmarket") == 0 &&
+                  strcmp(object, "matrix") == 0 &&
+                  strcmp(format, "coordinate") == 0;
+
+  if      (strcmp(field_name, "real") == 0 || strcmp(field_name, "double") == 0) parse.field = MTX_FIELD_REAL;
+  else if (strcmp(field_name, "integer") == 0)                                   parse.field = MTX_FIELD_INTEGER;
+  else if (strcmp(field_name, "pattern") == 0)                                   parse.field = MTX_FIELD_PATTERN;
+  else header_ok = false;
+
+  if      (strcmp(symmetry_name, "general") == 0)        symmetry = MTX_SYMMETRY_GENERAL;
+  else if (strcmp(symmetry_name, "symmetric") == 0)      symmetry = MTX_SYMMETRY_SYMMETRIC;
+  else if (strcmp(symmetry_name, "skew-symmetric") == 0) symmetry = MTX_SYMMETRY_SKEW_SYMMETRIC;
+  else header_ok = false;
+
+  if (!header_ok)
+  {
+    LOG_ERROR("Unsupported matrix market header in %s (%s %s %s %s), only real/integer/pattern coordinate matrices",
+              path, object, format, field_name, symmetry_name);
+    munmap(mapping, file_size);
+    return result;
+  }
+
+  // Comments, then the size line
+  while (at < end && !mtx_line_has_entry(at, end))
+  {
+    at = mtx_skip_line(at, end);
+  }
+
+  u8 *size_line_end = mtx_skip_line(at, end);
+  u64 row_count   = mtx_parse_u64(&at, size_line_end);
+  u64 col_count   = mtx_parse_u64(&at, size_line_end);
+  u64 entry_count = mtx_parse_u64(&at, size_line_end);
+  at = size_line_end;
+
+  // Sizes, indices and pointers are all u32, counting the mirrored triangle
+  u64 max_triplet_count = symmetry == MTX_SYMMETRY_GENERAL ? entry_count : 2 * entry_count;
+  if (row_count > (u32)-1 || col_count > (u32)-1 || max_triplet_count > (u32)-1)
+  {
+    LOG_ERROR("Matrix market file %s is %lux%lu with %lu entries, too big for u32 indices",
+              path, row_count, col_count, entry_count);
+    munmap(mapping, file_size);
+    return result;
+  }
+
+  parse.row_count = (u32)row_count;
+  parse.col_count = (u32)col_count;
+
+  // Chunk boundaries pushed forward to the next line start
+  u32 task_count = (u32)MIN(MAX((end - at) / MTX_MIN_CHUNK_SIZE, 1), 4 * (pool->worker_count + 1));
+
+  parse.chunk_starts        = arena_calloc(arena, task_count + 1, u8 *);
+  parse.chunk_entry_offsets = arena_calloc(arena, task_count + 1, u64);
+
+  parse.chunk_starts[0] = at;
+  for (u32 task_index = 1; task_index < task_count; task_index++)
+  {
+    u8 *guess = at + (end - at) * task_index / task_count;
+    guess = MAX(guess, parse.chunk_starts[task_index - 1]);
+
+    parse.chunk_starts[task_index] = guess == at ? at : mtx_skip_line(guess - 1, end);
+  }
+  parse.chunk_starts[task_count] = end;
+
+  thread_pool_dispatch(pool, task_count, mtx_count_task, &parse);
+
+  for (u32 task_index = 0; task_index < task_count; task_index++)
+  {
+    parse.chunk_entry_offsets[task_index + 1] += parse.chunk_entry_offsets[task_index];
+  }
+
+  if (parse.chunk_entry_offsets[task_count] != entry_count)
+  {
+    LOG_ERROR("Matrix market file %s says it has %lu entries, but has %lu",
+              path, entry_count, parse.chunk_entry_offsets[task_count]);
+    munmap(mapping, file_size);
+    return result;
+  }
+
+  // Room for the mirrored triangle if there is one
+  parse.rows   = arena_calloc(arena, max_triplet_count, u32);
+  parse.cols   = arena_calloc(arena, max_triplet_count, u32);
+  parse.values = arena_calloc(arena, max_triplet_count, f64);
+
+  thread_pool_dispatch(pool, task_count, mtx_parse_task, &parse);
+
+  munmap(mapping, file_size);
+
+  if (parse.had_bad_entry)
+  {
+    LOG_ERROR("Matrix market file %s has entries at index 0 or outside of its %lux%lu size", path, row_count, col_count);
+    return result;
+  }
+
+  u64 triplet_count = entry_count;
+  if (symmetry != MTX_SYMMETRY_GENERAL)
+  {
+    f64 mirror_sign = symmetry == MTX_SYMMETRY_SKEW_SYMMETRIC ? -1.0 : 1.0;
+
+    for (u64 i = 0; i < entry_count; i++)
+    {
+      if (parse.rows[i] != parse.cols[i])
+      {
+        parse.rows[triplet_count]   = parse.cols[i];
+        parse.cols[triplet_count]   = parse.rows[i];
+        parse.values[triplet_count] = mirror_sign * parse.values[i];
+        triplet_count += 1;
+      }
+    }
+  }
+
+  // Bucketing by column then (stably) by row leaves each CSR row's columns sorted. Then the same
+  // again from the CSR for a CSC with sorted rows
+  u32 *by_col_pointers = arena_calloc(arena, col_count + 1, u32);
+  u32 *by_col_rows     = arena_calloc(arena, triplet_count, u32);
+  f64 *by_col_values   = arena_calloc(arena, triplet_count, f64);
+  compress_triplets(triplet_count, parse.cols, parse.rows, parse.values,
+                    col_count, by_col_pointers, by_col_rows, by_col_values);
+
+  u32 *by_col_cols = parse.cols; // Done with these
+  expand_pointers(by_col_pointers, col_count, by_col_cols);
+
+  CSR_Matrix csr = csr_alloc(arena, row_count, col_count, triplet_count);
+  compress_triplets(triplet_count, by_col_rows, by_col_cols, by_col_values,
+                    row_count, csr.row_pointers, csr.col_indices, csr.values);
+
+  mtx_merge_duplicates(&csr);
+
+  u32 *csr_rows = parse.rows;
+  expand_pointers(csr.row_pointers, row_count, csr_rows);
+
+  CSC_Matrix csc = csc_alloc(arena, row_count, col_count, csr.non_zero_count);
+  compress_triplets(csr.non_zero_count, csr.col_indices, csr_rows, csr.values,
+                    col_count, csc.col_pointers, csc.row_indices, csc.values);
+
+  *out_csr = csr;
+  *out_csc = csc;
+  result = true;
+
+  return result;
+}
@@ -0,0 +1,32 @@
+#ifndef MATRIX_MARKET_H
+#define MATRIX_MARKET_H
+
+#include "../common.h"
+#include "formats.h"
+#include "threads.h"
+
+// Coordinate .mtx files only (real, integer or pattern; general, symmetric or skew-symmetric),
+// which is what SuiteSparse ships. Symmetric files only store one triangle, the other is
+// mirrored in on load
+
+typedef enum Matrix_Market_Field
+{
+  MTX_FIELD_REAL,
+  MTX_FIELD_INTEGER,
+  MTX_FIELD_PATTERN, // No values, all 1.0
+} Matrix_Market_Field;
+
+typedef enum Matrix_Market_Symmetry
+{
+  MTX_SYMMETRY_GENERAL,
+  MTX_SYMMETRY_SYMMETRIC,
+  MTX_SYMMETRY_SKEW_SYMMETRIC,
+} Matrix_Market_Symmetry;
+
+// Files smaller than this aren't worth splitting across threads
+#define MTX_MIN_CHUNK_SIZE MB(1)
+
+static
+b32 matrix_market_load(Arena *arena, Thread_Pool *pool, char *path, CSR_Matrix *out_csr, CSC_Matrix *out_csc);
+
+#endif // MATRIX_MARKET_H
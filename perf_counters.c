@@ -0,0 +1,161 @@
+#include "perf_counters.h"
+
+#include <cpuid.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// glibc has no wrapper
+static
+int perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags)
+{
+  return (int)syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+static
+u64 perf_cache_config(u64 cache, u64 op, u64 result)
+{
+  return cache | (op << 8) | (result << 16);
+}
+
+// No generic event for floating point, so it's the vendor's raw one with every width and
+// precision in the unit mask: FP_ARITH_INST_RETIRED on Intel for PERF_FP_INSTRUCTIONS,
+// RETIRED_SSE_AVX_FLOPS on AMD for PERF_FP_FLOPS. 0 if the counter isn't this vendor's
+static
+u64 perf_fp_raw_config(Perf_Counter counter)
+{
+  u32 eax = 0, ebx = 0, ecx = 0, edx = 0;
+  __get_cpuid(0, &eax, &ebx, &ecx, &edx);
+
+  char vendor[13] = {0};
+  MEM_COPY(vendor + 0, &ebx, 4);
+  MEM_COPY(vendor + 4, &edx, 4);
+  MEM_COPY(vendor + 8, &ecx, 4);
+
+  u64 result = 0;
+  if (counter == PERF_FP_INSTRUCTIONS && strcmp(vendor, "GenuineIntel") == 0)
+  {
+    result = 0xffc7;
+  }
+  else if (counter == PERF_FP_FLOPS && strcmp(vendor, "AuthenticAMD") == 0)
+  {
+    result = 0xff03;
+  }
+
+  return result;
+}
+
+static
+b32 perf_counters_open(Perf_Counters *counters)
+{
+  struct
+  {
+    u32 type;
+    u64 config;
+  } events[PERF_COUNTER_COUNT] =
+  {
+    [PERF_CYCLES]          = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [PERF_INSTRUCTIONS]    = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [PERF_L1D_MISSES]      = {PERF_TYPE_HW_CACHE, perf_cache_config(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                                                    PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    [PERF_LLC_MISSES]      = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    [PERF_DTLB_MISSES]     = {PERF_TYPE_HW_CACHE, perf_cache_config(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                                                    PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    [PERF_FP_INSTRUCTIONS] = {PERF_TYPE_RAW,      perf_fp_raw_config(PERF_FP_INSTRUCTIONS)},
+    [PERF_FP_FLOPS]        = {PERF_TYPE_RAW,      perf_fp_raw_config(PERF_FP_FLOPS)},
+  };
+
+  b32 result = false;
+
+  for (usize i = 0; i < PERF_COUNTER_COUNT; i++)
+  {
+    counters->fds[i] = -1;
+
+    if (events[i].type == PERF_TYPE_RAW && !events[i].config)
+    {
+      continue;
+    }
+
+    struct perf_event_attr attr = {0};
+    attr.size           = sizeof(attr);
+    attr.type           = events[i].type;
+    attr.config         = events[i].config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.inherit        = 1;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    counters->fds[i] = perf_event_open(&attr, 0, -1, -1, 0);
+    result = result || counters->fds[i] >= 0;
+  }
+
+  return result;
+}
+
+static
+void perf_counters_close(Perf_Counters *counters)
+{
+  for (usize i = 0; i < PERF_COUNTER_COUNT; i++)
+  {
+    if (counters->fds[i] >= 0)
+    {
+      close(counters->fds[i]);
+    }
+
+    counters->fds[i] = -1;
+  }
+}
+
+static
+void perf_counters_ioctl(Perf_Counters *counters, unsigned long request)
+{
+  for (usize i = 0; i < PERF_COUNTER_COUNT; i++)
+  {
+    if (counters->fds[i] >= 0)
+    {
+      ioctl(counters->fds[i], request, 0);
+    }
+  }
+}
+
+static
+void perf_counters_reset(Perf_Counters *counters)
+{
+  perf_counters_ioctl(counters, PERF_EVENT_IOC_RESET);
+}
+
+static
+void perf_counters_start(Perf_Counters *counters)
+{
+  perf_counters_ioctl(counters, PERF_EVENT_IOC_ENABLE);
+}
+
+static
+void perf_counters_stop(Perf_Counters *counters)
+{
+  perf_counters_ioctl(counters, PERF_EVENT_IOC_DISABLE);
+}
+
+static
+Perf_Counter_Values perf_counters_read(Perf_Counters *counters)
+{
+  Perf_Counter_Values result = {0};
+
+  for (usize i = 0; i < PERF_COUNTER_COUNT; i++)
+  {
+    // value, time enabled, time running
+    u64 read_values[3] = {0};
+
+    if (counters->fds[i] >= 0 && read(counters->fds[i], read_values, sizeof(read_values)) == sizeof(read_values))
+    {
+      f64 scale = read_values[2] ? (f64)read_values[1] / (f64)read_values[2] : 1.0;
+
+      result.v[i]     = (u64)((f64)read_values[0] * scale);
+      result.valid[i] = true;
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,76 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include "../common.h"
+
+// Hardware counters through perf_event_open, for why a kernel is slow rather than only that it
+// is. Unlike OBSERVE_FLOPS/OBSERVE_MEMOPS nothing is added to the loop being measured, the PMU
+// counts on the side. Each counter opens on its own so one the machine lacks doesn't take the
+// others down with it, and the kernel multiplexes them if there are more than it has slots for
+typedef enum Perf_Counter
+{
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_DTLB_MISSES,
+
+  // Raw events, so one per vendor and the other's column stays empty. Intel counts instructions,
+  // a packed one once, AMD counts the flops in them
+  PERF_FP_INSTRUCTIONS,
+  PERF_FP_FLOPS,
+
+  PERF_COUNTER_COUNT,
+} Perf_Counter;
+
+// CSV column names
+static char *perf_counter_names[PERF_COUNTER_COUNT] =
+{
+  [PERF_CYCLES]          = "cycles",
+  [PERF_INSTRUCTIONS]    = "instructions",
+  [PERF_L1D_MISSES]      = "l1d_misses",
+  [PERF_LLC_MISSES]      = "llc_misses",
+  [PERF_DTLB_MISSES]     = "dtlb_misses",
+  [PERF_FP_INSTRUCTIONS] = "fp_instructions",
+  [PERF_FP_FLOPS]        = "fp_flops",
+};
+
+typedef struct Perf_Counter_Values Perf_Counter_Values;
+struct Perf_Counter_Values
+{
+  u64 v[PERF_COUNTER_COUNT];
+  b32 valid[PERF_COUNTER_COUNT];
+};
+
+typedef struct Perf_Counters Perf_Counters;
+struct Perf_Counters
+{
+  int fds[PERF_COUNTER_COUNT]; // -1 if it couldn't be opened
+};
+
+// This thread and every thread it starts from here on, user space only. Open before making any
+// thread pool, or the workers' share of a dispatched kernel goes uncounted. Reads sum over all of
+// them. False if nothing could be opened, perf_event_paranoid or a VM without a virtual PMU, in
+// which case the rest are all no ops
+static
+b32 perf_counters_open(Perf_Counters *counters);
+
+static
+void perf_counters_close(Perf_Counters *counters);
+
+// Zero without starting
+static
+void perf_counters_reset(Perf_Counters *counters);
+
+// Counts accumulate across start/stop pairs until the next reset
+static
+void perf_counters_start(Perf_Counters *counters);
+
+static
+void perf_counters_stop(Perf_Counters *counters);
+
+// Scaled up by enabled / running time if the counter was multiplexed
+static
+Perf_Counter_Values perf_counters_read(Perf_Counters *counters);
+
+#endif // PERF_COUNTERS_H
@@ -2,6 +2,8 @@ import pandas as pd
 import numpy as np
 import matplotlib.pyplot as plt
 import sys
+import re
+import os
 
 def formula_dense_dense(LRC, LCC, RCC, LNZ, RNZ):
     flops = 2 * LRC * LCC * RCC
@@ -49,6 +51,8 @@ def formula_csc_csc(LRC, LCC, RCC, LNZ, RNZ):
 
 formula_map = {
     'dense_X_dense': formula_dense_dense,
+    # Same flops, but the packed panels are reused out of cache so its memops come in well under
+    'dense_X_dense_blocked': formula_dense_dense,
     'dense_X_csr':   formula_dense_csr,
     'dense_X_csc':   formula_dense_csc,
     'csr_X_dense':   formula_csr_dense,
@@ -57,10 +61,42 @@ formula_map = {
     'csc_X_dense':   formula_csc_dense,
     'csc_X_csr':     formula_csc_csr,
     'csc_X_csc':     formula_csc_csc,
+    # Ignores SELL's padding, so its observed flops sit a little above this
+    'sell_X_dense':  formula_csr_dense,
+    # Same products as the singly compressed versions, they only skip empty rows/columns
+    'dcsr_X_dense':  formula_csr_dense,
+    'dcsr_X_csr':    formula_csr_csr,
+    'dcsc_X_dense':  formula_csc_dense,
+    'dcsc_X_csr':    formula_csc_csr,
+    'coo_X_dense':   formula_csr_dense,
+    'coo_X_csr':     formula_csr_csr,
+    # Same loop as csr_X_dense over narrower storage, only the bytes per memop shrink
+    'csr_f32_X_dense_f32':       formula_csr_dense,
+    'csr_f32_X_dense_f32_acc64': formula_csr_dense,
+    'csr_bf16_X_dense_bf16':     formula_csr_dense,
+    'csr_u16_X_dense':           formula_csr_dense,
+    'csr_f32_u16_X_dense_f32':   formula_csr_dense,
 }
 
 csv_files = sys.argv[1:]
 
+# Written by the roofline suite next to the entries' csvs
+roofline_file = os.path.join(os.path.dirname(csv_files[0]), 'roofline.csv') if csv_files else ''
+roofline = pd.read_csv(roofline_file) if os.path.exists(roofline_file) else None
+
+# Best of any width at the most threads measured that the kernel doesn't exceed, so a csr_X_dense_t8
+# is held against 8 threads' worth and everything else against one
+def roofline_ceilings(thread_count):
+    measured = roofline['thread_count'].unique()
+    threads = max([t for t in measured if t <= thread_count], default=1)
+    at_threads = roofline[roofline['thread_count'] == threads]
+
+    flops = at_threads[at_threads['kind'] == 'fmadd']['per_tick'].max()
+    reads = at_threads[at_threads['kind'] == 'read'].groupby('level', sort=False)['per_tick'].max()
+    return threads, flops, reads
+
+drawn_thread_counts = set()
+
 plt.figure(figsize=(24,5))
 
 colors = plt.cm.tab10(np.linspace(0, 1, len(csv_files)))
@@ -79,7 +115,15 @@ for i, csv_file in enumerate(csv_files):
     time = data['time'].values
     byte = data['bytes'].values
 
-    formula_func = formula_map.get(csv_file.removesuffix('.csv'), None)
+    # Uninstrumented builds leave the observed counts at 0, the counting pass fills in the same numbers
+    if 'counted_flops' in data and not observed_flops.any():
+        observed_flops  = data['counted_flops'].values
+        observed_memops = data['counted_memops'].values
+        byte            = data['counted_bytes'].values
+
+    # Threaded (csr_X_dense_t8), SIMD, sparse output and reordered variants do the same flops as the serial kernel
+    combo_name = re.sub(r'_(t\d+|simd|sparse|numeric|rcm|degree|cluster)$', '', csv_file.removesuffix('.csv'))
+    formula_func = formula_map.get(combo_name, None)
 
     if not formula_func:
         print(f"No formula defined for file: {csv_file}")
@@ -133,14 +177,29 @@ for i, csv_file in enumerate(csv_files):
 
     flops_per_byte = observed_flops / byte
     flops_per_cycle = observed_flops / time
-    # HACK: Just hardcoding after measuring. Automate this by dumping it from roofline test
-    peak_flops_per_cycle = 27.311
-    peak_bytes_per_cycle = 30.041
-
-    plt.axhline(y=peak_flops_per_cycle, color='black', linestyle='--', label='Peak FLOP/cycle')
     x = np.logspace(-3, 3, 100)
-    plt.plot(x, np.minimum(peak_bytes_per_cycle * x, peak_flops_per_cycle),
-            color='black', linestyle='-', label='Memory bound')
+
+    thread_match = re.search(r'_t(\d+)\.csv$', csv_file)
+    thread_count = int(thread_match.group(1)) if thread_match else 1
+
+    if roofline is not None:
+        threads, peak_flops_per_cycle, peak_bytes_per_cycle = roofline_ceilings(thread_count)
+
+        if threads not in drawn_thread_counts:
+            drawn_thread_counts.add(threads)
+
+            plt.axhline(y=peak_flops_per_cycle, color='black', linestyle='--', label=f'Peak FLOP/cycle, {threads} threads')
+            for level, bytes_per_cycle in peak_bytes_per_cycle.items():
+                plt.plot(x, np.minimum(bytes_per_cycle * x, peak_flops_per_cycle),
+                         color='black', linestyle='-', linewidth=0.75, label=f'{level} bound, {threads} threads')
+    else:
+        # No roofline.csv, the dev machine's numbers
+        peak_flops_per_cycle = 27.311
+        peak_bytes_per_cycle = 30.041
+
+        plt.axhline(y=peak_flops_per_cycle, color='black', linestyle='--', label='Peak FLOP/cycle')
+        plt.plot(x, np.minimum(peak_bytes_per_cycle * x, peak_flops_per_cycle),
+                color='black', linestyle='-', label='Memory bound')
 
     plt.plot(flops_per_byte, flops_per_cycle, 'o-', color=colors[i], label=csv_file, markersize=4)
     plt.xscale('log')
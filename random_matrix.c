@@ -0,0 +1,172 @@
+#include "random_matrix.h"
+
+#include <math.h>
+
+static
+u64 random_mix(u64 value)
+{
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+  value =  value ^ (value >> 31);
+
+  return value;
+}
+
+static
+Random_Series random_seed(u64 seed, u64 stream)
+{
+  // Mixed twice so neighbouring streams of the same seed don't start out correlated
+  Random_Series result = { .state = random_mix(seed ^ random_mix(stream + 0x9e3779b97f4a7c15ull)) };
+
+  return result;
+}
+
+static
+u64 random_next(Random_Series *series)
+{
+  series->state += 0x9e3779b97f4a7c15ull;
+
+  return random_mix(series->state);
+}
+
+static
+f64 random_unit(Random_Series *series)
+{
+  // Top 53 bits, all a double can hold
+  return (f64)(random_next(series) >> 11) * (1.0 / (f64)(1ull << 53));
+}
+
+typedef struct Random_CSR_Generation Random_CSR_Generation;
+struct Random_CSR_Generation
+{
+  CSR_Matrix *matrix;
+  f64 density;
+  f64 log_miss; // log(1 - density), for the geometric skips
+  u64 seed;
+};
+
+// Instead of a coin flip per entry, jump straight to the next non zero. The gap before it is
+// geometric, floor(log(u) / log(1 - density)) for a uniform u in (0, 1]. Writes nothing if
+// col_indices is NULL, just counts, and since the series is per row both passes agree
+static
+u32 random_csr_row(Random_CSR_Generation *generation, u32 row, u32 *col_indices, f64 *values)
+{
+  u32 col_count = generation->matrix->col_count;
+
+  Random_Series series = random_seed(generation->seed, row);
+
+  u32 result = 0;
+  for (u64 col = 0; col < col_count; col++)
+  {
+    if (generation->density < 1.0)
+    {
+      f64 skip = floor(log(1.0 - random_unit(&series)) / generation->log_miss);
+      if (skip >= (f64)(col_count - col))
+      {
+        break;
+      }
+
+      col += (u64)skip;
+    }
+
+    // Drawn in the counting pass too, so the value stream lines up
+    f64 value = random_unit(&series) * 2.0 - 1.0;
+
+    if (col_indices)
+    {
+      col_indices[result] = (u32)col;
+      values[result]      = value;
+    }
+
+    result += 1;
+  }
+
+  return result;
+}
+
+static
+void random_csr_row_range(Random_CSR_Generation *generation, u32 task_index, u32 task_count,
+                          u32 *out_row_begin, u32 *out_row_end)
+{
+  u32 row_count = generation->matrix->row_count;
+
+  *out_row_begin = (u32)((u64)row_count * task_index / task_count);
+  *out_row_end   = (u32)((u64)row_count * (task_index + 1) / task_count);
+}
+
+static
+void random_csr_count_task(void *user, u32 task_index, u32 task_count)
+{
+  Random_CSR_Generation *generation = user;
+  CSR_Matrix *matrix = generation->matrix;
+
+  u32 row_begin, row_end;
+  random_csr_row_range(generation, task_index, task_count, &row_begin, &row_end);
+
+  // Prefix summed once every task is done
+  for (u32 row = row_begin; row < row_end; row++)
+  {
+    matrix->row_pointers[row + 1] = random_csr_row(generation, row, NULL, NULL);
+  }
+}
+
+static
+void random_csr_fill_task(void *user, u32 task_index, u32 task_count)
+{
+  Random_CSR_Generation *generation = user;
+  CSR_Matrix *matrix = generation->matrix;
+
+  u32 row_begin, row_end;
+  random_csr_row_range(generation, task_index, task_count, &row_begin, &row_end);
+
+  for (u32 row = row_begin; row < row_end; row++)
+  {
+    u32 start = matrix->row_pointers[row];
+    random_csr_row(generation, row, matrix->col_indices + start, matrix->values + start);
+  }
+}
+
+static
+CSR_Matrix make_random_csr_matrix(Arena *arena, Thread_Pool *pool,
+                                  u32 row_count, u32 col_count, f64 density, u64 seed)
+{
+  CSR_Matrix result =
+  {
+    .row_count    = row_count,
+    .col_count    = col_count,
+    .row_pointers = arena_calloc(arena, (usize)row_count + 1, u32),
+  };
+
+  Random_CSR_Generation generation =
+  {
+    .matrix   = &result,
+    .density  = density,
+    .log_miss = log1p(-density),
+    .seed     = seed,
+  };
+
+  // Only the row split depends on the thread count, never what ends up in a row
+  u32 task_count = MIN(MAX(row_count / 64, 1), 4 * (pool->worker_count + 1));
+
+  if (density > 0.0)
+  {
+    thread_pool_dispatch(pool, task_count, random_csr_count_task, &generation);
+  }
+
+  for (u32 row = 0; row < row_count; row++)
+  {
+    result.row_pointers[row + 1] += result.row_pointers[row];
+  }
+
+  // Now the size is known, move into a packed block for the fill
+  u32 *row_pointers = result.row_pointers;
+  result = csr_alloc(arena, row_count, col_count, row_pointers[row_count]);
+  MEM_COPY(result.row_pointers, row_pointers, sizeof(u32) * ((usize)row_count + 1));
+
+  if (result.non_zero_count)
+  {
+    thread_pool_dispatch(pool, task_count, random_csr_fill_task, &generation);
+  }
+
+  return result;
+}
@@ -0,0 +1,32 @@
+#ifndef RANDOM_MATRIX_H
+#define RANDOM_MATRIX_H
+
+#include "../common.h"
+#include "formats.h"
+#include "threads.h"
+
+// splitmix64. Tiny state so every row gets its own series, derived from the seed and the row
+// index, which keeps the matrix the same no matter how many threads generate it
+typedef struct Random_Series Random_Series;
+struct Random_Series
+{
+  u64 state;
+};
+
+static
+Random_Series random_seed(u64 seed, u64 stream);
+
+static
+u64 random_next(Random_Series *series);
+
+// [0, 1)
+static
+f64 random_unit(Random_Series *series);
+
+// Each entry is a non zero with probability density, same as the old dense generator, but only
+// ever touches the non zeros. Values uniform in [-1, 1)
+static
+CSR_Matrix make_random_csr_matrix(Arena *arena, Thread_Pool *pool,
+                                  u32 row_count, u32 col_count, f64 density, u64 seed);
+
+#endif // RANDOM_MATRIX_H
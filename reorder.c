@@ -0,0 +1,307 @@
+#include "reorder.h"
+
+static
+u32 reorder_degree(u32 *pointers, u32 index)
+{
+  return pointers[index + 1] - pointers[index];
+}
+
+// Stable, ascending by key. Keys must be below key_limit
+static
+void reorder_counting_sort(Arena *arena, u32 count, u32 *keys, u32 key_limit, u32 *out_order)
+{
+  u32 *starts = arena_calloc(arena, (usize)key_limit + 1, u32);
+
+  for (u32 i = 0; i < count; i++)
+  {
+    starts[keys[i] + 1] += 1;
+  }
+
+  for (u32 key = 0; key < key_limit; key++)
+  {
+    starts[key + 1] += starts[key];
+  }
+
+  for (u32 i = 0; i < count; i++)
+  {
+    out_order[starts[keys[i]]++] = i;
+  }
+}
+
+// Indices from pointers (row or column), most non zeros first
+static
+void reorder_by_degree_descending(Arena *arena, u32 *pointers, u32 count, u32 max_degree, u32 *out_order)
+{
+  u32 *keys = arena_calloc(arena, MAX(count, 1), u32);
+
+  for (u32 i = 0; i < count; i++)
+  {
+    keys[i] = max_degree - reorder_degree(pointers, i);
+  }
+
+  reorder_counting_sort(arena, count, keys, max_degree + 1, out_order);
+}
+
+// Stable bottom up merge sort of a batch of neighbours by ascending degree. Batches can be a whole
+// dense column's worth of rows, so no insertion sort
+static
+void reorder_sort_neighbours(u32 *items, u32 count, u32 *pointers, u32 *scratch)
+{
+  u32 *from = items;
+  u32 *to   = scratch;
+
+  for (u32 width = 1; width < count; width *= 2)
+  {
+    for (u32 begin = 0; begin < count; begin += 2 * width)
+    {
+      u32 middle = MIN(begin + width, count);
+      u32 end    = MIN(begin + 2 * width, count);
+
+      u32 a = begin, b = middle, out = begin;
+      while (a < middle && b < end)
+      {
+        to[out++] = reorder_degree(pointers, from[b]) < reorder_degree(pointers, from[a]) ? from[b++] : from[a++];
+      }
+      while (a < middle) to[out++] = from[a++];
+      while (b < end)    to[out++] = from[b++];
+    }
+
+    u32 *swap = from;
+    from = to;
+    to   = swap;
+  }
+
+  if (from != items)
+  {
+    MEM_COPY(items, from, sizeof(u32) * count);
+  }
+}
+
+// Breadth first from the lowest degree row still unvisited, one component at a time. Visiting a
+// row places the columns it reads, lowest degree first, and each of those places the rows it
+// reaches, also lowest degree first. Both orders come out reversed, which is what keeps the
+// profile small. Columns nothing reads go last
+static
+void reorder_rcm(Arena *arena, CSR_Matrix *left, CSC_Matrix *left_csc, u32 *out_row_order, u32 *out_inner_order)
+{
+  u32 row_count   = left->row_count;
+  u32 inner_count = left->col_count;
+
+  u8 *row_seen = arena_calloc(arena, MAX(row_count, 1), u8);
+  u8 *col_seen = arena_calloc(arena, MAX(inner_count, 1), u8);
+  u32 *scratch = arena_calloc(arena, MAX(MAX(row_count, inner_count), 1), u32);
+
+  u32 *starts = arena_calloc(arena, MAX(row_count, 1), u32);
+  reorder_by_degree_descending(arena, left->row_pointers, row_count, inner_count, starts);
+
+  // out_row_order doubles as the queue
+  u32 row_head = 0, row_tail = 0, col_tail = 0;
+
+  // Descending order walked backwards, so lowest degree first
+  for (u32 start_idx = row_count; start_idx > 0; start_idx--)
+  {
+    u32 start = starts[start_idx - 1];
+    if (row_seen[start])
+    {
+      continue;
+    }
+
+    row_seen[start] = true;
+    out_row_order[row_tail++] = start;
+
+    while (row_head < row_tail)
+    {
+      u32 row = out_row_order[row_head++];
+
+      u32 col_begin = col_tail;
+      for (u32 i = left->row_pointers[row]; i < left->row_pointers[row + 1]; i++)
+      {
+        u32 col = left->col_indices[i];
+        if (!col_seen[col])
+        {
+          col_seen[col] = true;
+          out_inner_order[col_tail++] = col;
+        }
+      }
+      reorder_sort_neighbours(out_inner_order + col_begin, col_tail - col_begin, left_csc->col_pointers, scratch);
+
+      for (u32 c = col_begin; c < col_tail; c++)
+      {
+        u32 col = out_inner_order[c];
+
+        u32 row_begin = row_tail;
+        for (u32 j = left_csc->col_pointers[col]; j < left_csc->col_pointers[col + 1]; j++)
+        {
+          u32 reached = left_csc->row_indices[j];
+          if (!row_seen[reached])
+          {
+            row_seen[reached] = true;
+            out_row_order[row_tail++] = reached;
+          }
+        }
+        reorder_sort_neighbours(out_row_order + row_begin, row_tail - row_begin, left->row_pointers, scratch);
+      }
+    }
+  }
+
+  u32 reached_col_count = col_tail;
+  for (u32 col = 0; col < inner_count; col++)
+  {
+    if (!col_seen[col])
+    {
+      out_inner_order[col_tail++] = col;
+    }
+  }
+
+  for (u32 i = 0; i < row_count / 2; i++)
+  {
+    u32 swap = out_row_order[i];
+    out_row_order[i] = out_row_order[row_count - 1 - i];
+    out_row_order[row_count - 1 - i] = swap;
+  }
+
+  for (u32 i = 0; i < reached_col_count / 2; i++)
+  {
+    u32 swap = out_inner_order[i];
+    out_inner_order[i] = out_inner_order[reached_col_count - 1 - i];
+    out_inner_order[reached_col_count - 1 - i] = swap;
+  }
+}
+
+static
+Reordering reorder_make(Arena *arena, Reorder_Method method, CSR_Matrix *left, CSC_Matrix *left_csc,
+                        CSR_Matrix *right)
+{
+  u32 row_count   = left->row_count;
+  u32 inner_count = left->col_count;
+
+  Reordering result =
+  {
+    .method      = method,
+    .row_count   = row_count,
+    .inner_count = inner_count,
+    .row_order   = arena_calloc(arena, MAX(row_count, 1), u32),
+    .inner_rank  = arena_calloc(arena, MAX(inner_count, 1), u32),
+  };
+
+  u32 *inner_order = arena_calloc(arena, MAX(inner_count, 1), u32);
+
+  switch (method)
+  {
+    case REORDER_RCM:
+    {
+      reorder_rcm(arena, left, left_csc, result.row_order, inner_order);
+    }
+    break;
+
+    case REORDER_DEGREE:
+    {
+      reorder_by_degree_descending(arena, left->row_pointers, row_count, inner_count, result.row_order);
+      reorder_by_degree_descending(arena, left_csc->col_pointers, inner_count, row_count, inner_order);
+    }
+    break;
+
+    case REORDER_CLUSTER:
+    {
+      reorder_by_degree_descending(arena, left_csc->col_pointers, inner_count, row_count, inner_order);
+      for (u32 i = 0; i < inner_count; i++)
+      {
+        result.inner_rank[inner_order[i]] = i;
+      }
+
+      // Rows keyed by the first column they read once renumbered, empty ones after everything
+      u32 *keys = arena_calloc(arena, MAX(row_count, 1), u32);
+      for (u32 row = 0; row < row_count; row++)
+      {
+        keys[row] = inner_count;
+        for (u32 i = left->row_pointers[row]; i < left->row_pointers[row + 1]; i++)
+        {
+          keys[row] = MIN(keys[row], result.inner_rank[left->col_indices[i]]);
+        }
+      }
+
+      reorder_counting_sort(arena, row_count, keys, inner_count + 1, result.row_order);
+    }
+    break;
+
+    default:
+    {
+      LOG_ERROR("Unknown reorder method %d", method);
+    }
+    break;
+  }
+
+  for (u32 i = 0; i < inner_count; i++)
+  {
+    result.inner_rank[inner_order[i]] = i;
+  }
+
+  result.left.csr  = csr_permute(arena, left, result.row_order, result.inner_rank);
+  result.right.csr = csr_permute(arena, right, inner_order, NULL);
+
+  return result;
+}
+
+static
+CSR_Matrix csr_permute(Arena *arena, CSR_Matrix *csr, u32 *row_order, u32 *col_rank)
+{
+  CSR_Matrix result = csr_alloc(arena, csr->row_count, csr->col_count, csr->non_zero_count);
+
+  if (!col_rank)
+  {
+    // Rows move whole, already sorted
+    for (u32 row = 0; row < csr->row_count; row++)
+    {
+      u32 source = row_order ? row_order[row] : row;
+      u32 start  = csr->row_pointers[source];
+      u32 count  = csr->row_pointers[source + 1] - start;
+
+      result.row_pointers[row + 1] = result.row_pointers[row] + count;
+      MEM_COPY(result.col_indices + result.row_pointers[row], csr->col_indices + start, sizeof(u32) * count);
+      MEM_COPY(result.values + result.row_pointers[row], csr->values + start, sizeof(f64) * count);
+    }
+
+    return result;
+  }
+
+  // Triplets in the new row order, compressed by new column and then back by row. Both counting
+  // sorts are stable, so each row's columns come out sorted without a comparison sort
+  u64 count = csr->non_zero_count;
+  u32 *cols   = arena_calloc(arena, MAX(count, 1), u32);
+  u32 *rows   = arena_calloc(arena, MAX(count, 1), u32);
+  f64 *values = arena_calloc(arena, MAX(count, 1), f64);
+
+  u64 cursor = 0;
+  for (u32 row = 0; row < csr->row_count; row++)
+  {
+    u32 source = row_order ? row_order[row] : row;
+    for (u32 i = csr->row_pointers[source]; i < csr->row_pointers[source + 1]; i++)
+    {
+      cols[cursor]   = col_rank[csr->col_indices[i]];
+      rows[cursor]   = row;
+      values[cursor] = csr->values[i];
+      cursor += 1;
+    }
+  }
+
+  CSC_Matrix by_col = csc_alloc(arena, csr->row_count, csr->col_count, csr->non_zero_count);
+  compress_triplets(count, cols, rows, values, csr->col_count, by_col.col_pointers, by_col.row_indices, by_col.values);
+
+  expand_pointers(by_col.col_pointers, by_col.col_count, cols);
+  compress_triplets(count, by_col.row_indices, cols, by_col.values, csr->row_count,
+                    result.row_pointers, result.col_indices, result.values);
+
+  return result;
+}
+
+static
+void reorder_unpermute_rows(Dense_Matrix *permuted, Dense_Matrix *output, u32 *row_order)
+{
+  usize col_count = output->col_count;
+
+  for (usize row = 0; row < permuted->row_count; row++)
+  {
+    MEM_COPY(output->values + row_order[row] * col_count, permuted->values + row * col_count,
+             sizeof(f64) * col_count);
+  }
+}
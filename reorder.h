@@ -0,0 +1,50 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include "../common.h"
+#include "formats.h"
+
+// Which rows of the right a left row reads is just its column pattern, so consecutive left rows
+// only share cache if their columns land close together. A reordering renumbers the left's rows,
+// and its columns along with the right's rows. Renumbering the inner dimension on both sides
+// leaves the product alone, renumbering the rows permutes the output's, which
+// reorder_unpermute_rows() puts back
+typedef enum Reorder_Method
+{
+  REORDER_RCM,     // Reverse Cuthill-McKee, over the bipartite row/column graph so any shape works
+  REORDER_DEGREE,  // Rows and columns by descending non zero count
+  REORDER_CLUSTER, // Columns by degree, then rows grouped by the first column they read
+
+  REORDER_COUNT,
+} Reorder_Method;
+
+typedef struct Reordering Reordering;
+struct Reordering
+{
+  Reorder_Method method;
+
+  u32 row_count;
+  u32 inner_count;
+  u32 *row_order;  // New row -> old row
+  u32 *inner_rank; // Old inner index -> new
+
+  // Only csr filled, the rest left for whoever needs them
+  Matrix_Reps left;
+  Matrix_Reps right;
+};
+
+// left_csc is the same matrix as left, for walking from a column back to its rows
+static
+Reordering reorder_make(Arena *arena, Reorder_Method method, CSR_Matrix *left, CSC_Matrix *left_csc,
+                        CSR_Matrix *right);
+
+// Row r of the result is row row_order[r] of csr, and column c becomes col_rank[c], with each row's
+// columns sorted again. NULL for either keeps that order
+static
+CSR_Matrix csr_permute(Arena *arena, CSR_Matrix *csr, u32 *row_order, u32 *col_rank);
+
+// Row r of permuted goes back to row row_order[r] of output
+static
+void reorder_unpermute_rows(Dense_Matrix *permuted, Dense_Matrix *output, u32 *row_order);
+
+#endif // REORDER_H
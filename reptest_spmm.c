@@ -5,571 +5,2194 @@
 #include "../common.h"
 #include "formats.h"
 #include "formats.c"
+#include "threads.h"
+#include "threads.c"
+#include "random_matrix.h"
+#include "random_matrix.c"
+#include "simd.h"
+#include "simd.c"
+#include "spgemm.h"
+#include "gemm.h"
+#include "reorder.h"
+#include "reorder.c"
+#include "matrix_market.h"
+#include "matrix_market.c"
+#include "sparse_file.h"
+#include "sparse_file.c"
+#include "perf_counters.h"
+#include "perf_counters.c"
+#include "sweep.h"
+#include "sweep.c"
+#include "batch.h"
 #include "../benchmark/benchmark_inc.h"
 #include "../benchmark/benchmark_inc.c"
-
-#ifndef OBSERVE_FLOPS
-#define FMADD(dst, a, b) dst += (a * b)
-#else
-#define FMADD(dst, a, b) dst += (a * b); repetition_tester_count_flops(tester, 2)
-#endif // OBSERVE_FLOPS
-
-#ifndef OBSERVE_MEMOPS
-#define LOAD(src)       src
-#define STORE(dst, src) dst = src
-#else
-#define LOAD(src)       src;                          \
-  repetition_tester_count_memops(tester, 1);          \
-  repetition_tester_count_bytes(tester, sizeof(src))
-#define STORE(dst, src) dst = src;                    \
-  repetition_tester_count_memops(tester, 1);          \
-  repetition_tester_count_bytes(tester, sizeof(dst))
-#endif // OBSERVE_MEMOPS
-
-typedef struct Operation_Parameters Operation_Parameters;
-struct Operation_Parameters
-{
-  Matrix_Reps  left;
-  Matrix_Reps  right;
-  Dense_Matrix output;
-};
-
-extern void read256_asm(u64 count, u8 *data);
-extern void fmadd_asm(u64 count);
-
-static u8 bandwidth_buffer[GB(1)] = {0};
-
+#include "roofline.h"
+#include "roofline.c"
+
+// Only opened with OBSERVE_PMU, until then every call on it does nothing
+static Perf_Counters perf_counters = {.fds = {[0 ... PERF_COUNTER_COUNT - 1] = -1}};
+
+#ifdef OBSERVE_PMU
+// Every timed region runs the PMU counters too. Started before the tester reads its timer and
+// stopped after, so the ioctls stay outside the time. A function like macro doesn't expand inside
+// itself, so the inner calls are still the tester's own
+#define repetition_tester_begin_time(tester) \
+  (perf_counters_start(&perf_counters), repetition_tester_begin_time(tester))
+#define repetition_tester_close_time(tester) \
+  (repetition_tester_close_time(tester), perf_counters_stop(&perf_counters))
+#endif // OBSERVE_PMU
+
+// Linked from libspmm.a, along with the kernels in kernels.h and the batch in batch.h
+#include "spmm.h"
+#include "kernels.h"
+
+// What the kernels time and count through, see spmm_set_tester_hooks(). After the PMU wrappers,
+// so the kernels' timed regions get them too
 static
-void roofline_bandwidth(Repetition_Tester *tester)
+void reptest_begin_time(void *tester)
 {
-  u64 byte_count = STATIC_COUNT(bandwidth_buffer);
+  repetition_tester_begin_time((Repetition_Tester *)tester);
+}
 
-  repetition_tester_begin_time(tester);
+static
+void reptest_close_time(void *tester)
+{
+  repetition_tester_close_time((Repetition_Tester *)tester);
+}
 
-  read256_asm(byte_count, bandwidth_buffer);
+static
+void reptest_count(void *tester, u64 flops, u64 memops, u64 bytes)
+{
+  if (flops)
+  {
+    repetition_tester_count_flops((Repetition_Tester *)tester, flops);
+  }
 
-  repetition_tester_close_time(tester);
+  if (memops)
+  {
+    repetition_tester_count_memops((Repetition_Tester *)tester, memops);
+  }
 
-  repetition_tester_count_bytes(tester, byte_count);
+  if (bytes)
+  {
+    repetition_tester_count_bytes((Repetition_Tester *)tester, bytes);
+  }
 }
 
+// Startup cost of getting a file's matrices into memory, the arena is cleared each time
 static
-void roofline_flops(Repetition_Tester *tester)
+void load_matrix_market_text(Repetition_Tester *tester, Arena *arena, Thread_Pool *pool, char *path)
 {
-  u64 flop_count = GB(4);
+  arena_clear(arena);
+
+  CSR_Matrix csr = {0};
+  CSC_Matrix csc = {0};
 
   repetition_tester_begin_time(tester);
 
-  fmadd_asm(flop_count);
+  matrix_market_load(arena, pool, path, &csr, &csc);
 
   repetition_tester_close_time(tester);
-
-  repetition_tester_count_flops(tester, flop_count);
 }
 
+// Mapping alone is nearly free, the cost shows up as page faults on first use. So touch every page
+// to make it comparable with the text path, which has everything resident when it's done
 static
-void matmul_dense_dense(Repetition_Tester *tester, Operation_Parameters *params)
+void load_sparse_file_binary(Repetition_Tester *tester, char *path)
 {
-  Dense_Matrix left   = params->left.dense;
-  Dense_Matrix right  = params->right.dense;
-  Dense_Matrix output = params->output;
+  Sparse_File file = {0};
+  CSR_Matrix csr = {0};
+  CSC_Matrix csc = {0};
 
   repetition_tester_begin_time(tester);
 
-  for (usize row = 0; row < left.row_count; row++)
+  if (sparse_file_map(path, &file, &csr, &csc))
   {
-    for (usize col = 0; col < right.col_count; col++)
+    volatile u8 sink = 0;
+    for (usize offset = 0; offset < file.size; offset += KB(4))
     {
-      f64 dot = 0.0;
-
-      for (usize i = 0; i < left.col_count; i++)
-      {
-        usize left_index  = row * left.col_count + i;
-        usize right_index = i * right.col_count + col;
-        f64 left_value  = LOAD(left.values[left_index]);
-        f64 right_value = LOAD(right.values[right_index]);
-
-        FMADD(dot, left_value, right_value);
-      }
-
-      usize output_index = row * output.col_count + col;
-      STORE(output.values[output_index], dot);
+      sink += file.mapping[offset];
     }
   }
 
   repetition_tester_close_time(tester);
+
+  sparse_file_unmap(&file);
 }
 
+// What ships, libspmm.a's plan and execute, with the pick and its conversions made once. Planned
+// from the CSRs on the first call, like spmm_operand_dense(), so only the execute is timed
 static
-void matmul_csr_dense(Repetition_Tester *tester, Operation_Parameters *params)
+void matmul_libspmm(Repetition_Tester *tester, Operation_Parameters *params)
 {
-  CSR_Matrix left     = params->left.csr;
-  Dense_Matrix right  = params->right.dense;
-  Dense_Matrix output = params->output;
+  if (!params->library_plan)
+  {
+    Matrix_Union left  = {.format = MAT_CSR, .csr = params->left.csr};
+    Matrix_Union right = {.format = MAT_CSR, .csr = params->right.csr};
+    params->library_plan = spmm_plan(params->arena, params->pool, &left, &right);
+  }
 
   repetition_tester_begin_time(tester);
 
-  for (usize row = 0; row < left.row_count; row++)
-  {
-    // Double count?
-    usize row_start = LOAD(left.row_pointers[row]);
-    usize row_end   = LOAD(left.row_pointers[row + 1]);
-
-    for (usize i = row_start; i < row_end; i++)
-    {
-      usize left_col = LOAD(left.col_indices[i]);
-      f64 left_value = LOAD(left.values[i]);
+  spmm_execute(params->library_plan, params->output);
 
-      for (usize right_col = 0; right_col < right.col_count; right_col++)
-      {
-        usize right_index  = left_col * right.col_count + right_col; // ALU op
-        usize output_index = row * output.col_count + right_col;     // ALU op
+  repetition_tester_close_time(tester);
+}
 
-        f64 right_value   = LOAD(right.values[right_index]);
-        f64 current_value = LOAD(output.values[output_index]);
+// How every CSR was allocated before csr_alloc(), kept to benchmark the packed layout against
+static
+CSR_Matrix csr_copy_separate(Arena *arena, CSR_Matrix *csr)
+{
+  CSR_Matrix result = {0};
+  result.non_zero_count = csr->non_zero_count;
+  result.row_count = csr->row_count;
+  result.col_count = csr->col_count;
 
-        f64 result_value = current_value;
-        FMADD(result_value, left_value, right_value);
+  result.values       = arena_calloc(arena, result.non_zero_count, f64);
+  result.col_indices  = arena_calloc(arena, result.non_zero_count, u32);
+  result.row_pointers = arena_calloc(arena, result.row_count + 1, u32);
 
-        STORE(output.values[output_index], result_value);
-      }
-    }
-  }
+  MEM_COPY(result.row_pointers, csr->row_pointers, sizeof(u32) * ((usize)csr->row_count + 1));
+  MEM_COPY(result.col_indices,  csr->col_indices,  sizeof(u32) * (usize)csr->non_zero_count);
+  MEM_COPY(result.values,       csr->values,       sizeof(f64) * (usize)csr->non_zero_count);
 
-  repetition_tester_close_time(tester);
+  return result;
 }
 
+// What it costs to switch the right operand's format instead of running a mixed format kernel.
+// Into the output arena, cleared each call like the sparse output kernels
 static
-void matmul_csc_dense(Repetition_Tester *tester, Operation_Parameters *params)
+void observe_transpose(Repetition_Tester *tester, u32 major_count, u32 minor_count, u64 non_zero_count)
 {
-  CSC_Matrix left     = params->left.csc;
-  Dense_Matrix right  = params->right.dense;
-  Dense_Matrix output = params->output;
-
-  repetition_tester_begin_time(tester);
-
-  for (usize col = 0; col < left.col_count; col++)
-  {
-    usize col_start = LOAD(left.col_pointers[col]);
-    usize col_end   = LOAD(left.col_pointers[col + 1]);
+  // Minors read twice (count then scatter), values read once, index and value written once
+  u64 memops = 5 * non_zero_count + (u64)major_count + 2 * (u64)minor_count;
+  u64 bytes  = (2 * sizeof(u32) + sizeof(f64)) * non_zero_count + (sizeof(u32) + sizeof(f64)) * non_zero_count +
+               sizeof(u32) * ((u64)major_count + 2 * (u64)minor_count);
 
-    for (usize i = col_start; i < col_end; i++)
-    {
-      usize left_row = LOAD(left.row_indices[i]);
-      f64 left_value = LOAD(left.values[i]);
+  spmm_observe_counts(tester, 0, memops, bytes);
+}
 
-      for (usize right_col = 0; right_col < right.col_count; right_col++)
-      {
-        usize right_index  = col * right.col_count + right_col;
-        usize output_index = left_row * output.col_count + right_col;
+static
+void convert_csr_to_csc(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  CSR_Matrix right = params->right.csr;
 
-        f64 right_value   = LOAD(right.values[right_index]);
-        f64 current_value = LOAD(output.values[output_index]);
+  arena_clear(params->output_arena);
 
-        f64 result_value = current_value;
-        FMADD(result_value, left_value, right_value);
+  repetition_tester_begin_time(tester);
 
-        STORE(output.values[output_index], result_value);
-      }
-    }
-  }
+  csc_from_csr(params->output_arena, params->pool, &right);
 
   repetition_tester_close_time(tester);
+
+  observe_transpose(tester, right.row_count, right.col_count, right.non_zero_count);
 }
 
 static
-void matmul_csr_csr(Repetition_Tester *tester, Operation_Parameters *params)
+void convert_csc_to_csr(Repetition_Tester *tester, Operation_Parameters *params)
 {
-  CSR_Matrix left  = params->left.csr;
-  CSR_Matrix right = params->right.csr;
-  Dense_Matrix output = params->output;
+  CSC_Matrix right = params->right.csc;
+
+  arena_clear(params->output_arena);
 
   repetition_tester_begin_time(tester);
 
-  for (usize left_row = 0; left_row < left.row_count; left_row++)
-  {
-    usize left_row_start = LOAD(left.row_pointers[left_row]);
-    usize left_row_end   = LOAD(left.row_pointers[left_row + 1]);
+  csr_from_csc(params->output_arena, params->pool, &right);
 
-    for (usize i = left_row_start; i < left_row_end; i++)
-    {
-      usize left_col = LOAD(left.col_indices[i]);
-      f64 left_value = LOAD(left.values[i]);
+  repetition_tester_close_time(tester);
 
-      usize right_row_start = LOAD(right.row_pointers[left_col]);
-      usize right_row_end   = LOAD(right.row_pointers[left_col + 1]);
-      for (usize j = right_row_start; j < right_row_end; j++)
-      {
-        usize right_col = LOAD(right.col_indices[j]);
-        f64 right_value = LOAD(right.values[j]);
+  observe_transpose(tester, right.col_count, right.row_count, right.non_zero_count);
+}
 
-        usize output_index = left_row * output.col_count + right_col;
-        f64 current_value = LOAD(output.values[output_index]);
+// Everything the reordered kernels get built ahead of time: the orders, and both permuted operands
+static
+void convert_reorder(Repetition_Tester *tester, Operation_Parameters *params, Reorder_Method method)
+{
+  arena_clear(params->output_arena);
 
-        f64 result_value = current_value;
-        FMADD(result_value, left_value, right_value);
+  repetition_tester_begin_time(tester);
 
-        STORE(output.values[output_index], result_value);
-      }
-    }
-  }
+  reorder_make(params->output_arena, method, &params->left.csr, &params->left.csc, &params->right.csr);
 
   repetition_tester_close_time(tester);
 }
 
 static
-void matmul_csc_csc(Repetition_Tester *tester, Operation_Parameters *params)
+void convert_reorder_rcm(Repetition_Tester *tester, Operation_Parameters *params)
 {
-  CSC_Matrix left  = params->left.csc;
-  CSC_Matrix right = params->right.csc;
-  Dense_Matrix output = params->output;
-
-  repetition_tester_begin_time(tester);
+  convert_reorder(tester, params, REORDER_RCM);
+}
 
-  for (usize right_col = 0; right_col < right.col_count; right_col++)
-  {
-    usize right_col_start = LOAD(right.col_pointers[right_col]);
-    usize right_col_end   = LOAD(right.col_pointers[right_col + 1]);
+static
+void convert_reorder_degree(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  convert_reorder(tester, params, REORDER_DEGREE);
+}
 
-    for (usize i = right_col_start; i < right_col_end; i++)
-    {
-      usize right_row = LOAD(right.row_indices[i]);
-      f64 right_value = LOAD(right.values[i]);
+static
+void convert_reorder_cluster(Repetition_Tester *tester, Operation_Parameters *params)
+{
+  convert_reorder(tester, params, REORDER_CLUSTER);
+}
 
-      usize left_col_start = LOAD(left.col_pointers[right_row]);
-      usize left_col_end   = LOAD(left.col_pointers[right_row + 1]);
-      for (usize j = left_col_start; j < left_col_end; j++)
-      {
-        usize left_row = LOAD(left.row_indices[j]);
-        f64 left_value = LOAD(left.values[j]);
+// Not multiplies, so they aren't verified or dumped, just weighed against the mixed kernels
+Operation_Entry conversion_entries[] =
+{
+  {STR("csr_to_csc"),      convert_csr_to_csc},
+  {STR("csc_to_csr"),      convert_csc_to_csr},
+  {STR("reorder_rcm"),     convert_reorder_rcm},
+  {STR("reorder_degree"),  convert_reorder_degree},
+  {STR("reorder_cluster"), convert_reorder_cluster},
+};
 
-        usize output_index = left_row * output.col_count + right_col;
-        f64 current_value = LOAD(output.values[output_index]);
+// Exact counts. What OBSERVE_FLOPS/OBSERVE_MEMOPS would add up for each kernel, worked out from the
+// dimensions and a walk over the sparsity structure only, so an uninstrumented timing run gets
+// them in the same CSV. Instrumented builds check the two against each other, see main()
+typedef struct Operation_Counts Operation_Counts;
+struct Operation_Counts
+{
+  u64 flops;
+  u64 memops;
+  u64 bytes;
+};
 
-        f64 result_value = current_value;
-        FMADD(result_value, left_value, right_value);
+// Products between a sparse left and right, one per left non zero per entry of the right row it
+// meets. The same total whichever way either side is compressed
+static
+u64 sparse_product_count(CSR_Matrix *left, CSR_Matrix *right)
+{
+  u64 result = 0;
 
-        STORE(output.values[output_index], result_value);
-      }
-    }
+  for (usize i = 0; i < left->non_zero_count; i++)
+  {
+    u32 k = left->col_indices[i];
+    result += right->row_pointers[k + 1] - right->row_pointers[k];
   }
 
-  repetition_tester_close_time(tester);
+  return result;
 }
 
+// Elements of a sorted list at or below value
 static
-void matmul_csr_csc(Repetition_Tester *tester, Operation_Parameters *params)
+u64 sorted_count_at_most(u32 *indices, u64 count, u32 value)
 {
-  CSR_Matrix left  = params->left.csr;
-  CSC_Matrix right = params->right.csc;
-  Dense_Matrix output = params->output;
-
-  repetition_tester_begin_time(tester);
-
-  for (usize left_row = 0; left_row < left.row_count; left_row++)
+  u64 low = 0, high = count;
+  while (low < high)
   {
-    usize left_row_start = LOAD(left.row_pointers[left_row]);
-    usize left_row_end   = LOAD(left.row_pointers[left_row + 1]);
-
-    for (usize right_col = 0; right_col < right.col_count; right_col++)
+    u64 middle = low + (high - low) / 2;
+    if (indices[middle] <= value)
+    {
+      low = middle + 1;
+    }
+    else
     {
-      usize right_col_start = LOAD(right.col_pointers[right_col]);
-      usize right_col_end   = LOAD(right.col_pointers[right_col + 1]);
+      high = middle;
+    }
+  }
 
-      f64 result_value = 0.0;
+  return low;
+}
 
-      usize left_cursor  = left_row_start;
-      usize right_cursor = right_col_start;
-      while (left_cursor < left_row_end && right_cursor < right_col_end)
-      {
-        usize left_col  = LOAD(left.col_indices[left_cursor]);
-        usize right_row = LOAD(right.row_indices[right_cursor]);
-        usize k = MIN(left_col, right_row);
+// Scalar csr_X_dense and everything shaped like it, with each array's element size
+static
+Operation_Counts count_csr_dense_sized(u64 pointer_count, u64 non_zero_count, u64 right_col_count,
+                                       u64 pointer_size, u64 index_size, u64 value_size,
+                                       u64 right_size, u64 output_size)
+{
+  u64 product_count = non_zero_count * right_col_count;
 
-        if (left_col == k && right_row == k)
-        {
-          f64 left_value  = LOAD(left.values[left_cursor]);
-          f64 right_value = LOAD(right.values[right_cursor]);
-          FMADD(result_value, left_value, right_value);
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = pointer_count + 2 * non_zero_count + 3 * product_count,
+    .bytes  = pointer_size * pointer_count + (index_size + value_size) * non_zero_count +
+              (right_size + 2 * output_size) * product_count,
+  };
 
-        }
-        left_cursor  += (usize)(left_col == k);
-        right_cursor += (usize)(right_row == k);
-      }
+  return result;
+}
 
-      usize output_index = left_row * output.col_count + right_col;
-      STORE(output.values[output_index], result_value);
-    }
-  }
+static
+Operation_Counts count_dense_dense(Operation_Parameters *params)
+{
+  u64 product_count = (u64)params->left.csr.row_count * params->left.csr.col_count * params->right.csr.col_count;
+  u64 output_count  = (u64)params->output.row_count * params->output.col_count;
 
-  repetition_tester_close_time(tester);
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 2 * product_count + output_count,
+    .bytes  = sizeof(f64) * (2 * product_count + output_count),
+  };
+
+  return result;
 }
 
 static
-void matmul_csc_csr(Repetition_Tester *tester, Operation_Parameters *params)
+Operation_Counts count_dense_dense_blocked(Operation_Parameters *params)
 {
-  CSC_Matrix left  = params->left.csc;
-  CSR_Matrix right = params->right.csr;
-  Dense_Matrix output = params->output;
+  u64 row_count   = params->left.csr.row_count;
+  u64 inner_count = params->left.csr.col_count;
+  u64 col_count   = params->right.csr.col_count;
 
-  repetition_tester_begin_time(tester);
+  Simd_Gemm_Kernel kernel = simd_gemm_kernels[simd_level()];
+  u64 col_blocks = (col_count + GEMM_NC - 1) / GEMM_NC;
+  u64 k_blocks   = (inner_count + GEMM_KC - 1) / GEMM_KC;
 
-  for (usize k = 0; k < right.row_count; k++)
-  {
-    usize left_col_start = LOAD(left.col_pointers[k]);
-    usize left_col_close = LOAD(left.col_pointers[k + 1]);
+  u64 product_count = row_count * inner_count * col_count;
+  u64 packing       = 2 * (row_count * inner_count * col_blocks + inner_count * col_count);
+  u64 tile_loads    = product_count / kernel.tile_cols + product_count / kernel.tile_rows;
+  u64 output_count  = 2 * row_count * col_count * k_blocks;
 
-    usize right_row_start = LOAD(right.row_pointers[k]);
-    usize right_row_close = LOAD(right.row_pointers[k + 1]);
+  u64 memops = packing + tile_loads + output_count;
 
-    for (usize left_col = left_col_start; left_col < left_col_close; left_col++)
-    {
-      usize row = LOAD(left.row_indices[left_col]);
-      f64 left_value  = LOAD(left.values[left_col]);
+  Operation_Counts result = {2 * product_count, memops, sizeof(f64) * memops};
 
-      for (usize right_row = right_row_start; right_row < right_row_close; right_row++)
-      {
-        usize col = LOAD(right.col_indices[right_row]);
-        f64 right_value = LOAD(right.values[right_row]);
+  return result;
+}
 
-        usize output_index = row * output.col_count + col;
-        f64 output_value   = LOAD(output.values[output_index]);
-        FMADD(output_value, left_value, right_value);
+static
+Operation_Counts count_dense_csr(Operation_Parameters *params)
+{
+  CSR_Matrix *right = &params->right.csr;
 
-        STORE(output.values[output_index], output_value);
-      }
-    }
-  }
+  // The output is read without a LOAD, only its store counts
+  u64 left_count    = (u64)params->left.csr.row_count * right->row_count;
+  u64 product_count = (u64)params->left.csr.row_count * right->non_zero_count;
 
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 3 * left_count + 3 * product_count,
+    .bytes  = (sizeof(f64) + 2 * sizeof(u32)) * left_count + (sizeof(u32) + 2 * sizeof(f64)) * product_count,
+  };
 
-  repetition_tester_close_time(tester);
+  return result;
 }
 
 static
-void matmul_dense_csr(Repetition_Tester *tester, Operation_Parameters *params)
+Operation_Counts count_dense_csr_simd(Operation_Parameters *params)
 {
-  Dense_Matrix left   = params->left.dense;
-  CSR_Matrix right    = params->right.csr;
-  Dense_Matrix output = params->output;
+  CSR_Matrix *right = &params->right.csr;
 
-  repetition_tester_begin_time(tester);
+  u64 product_count = (u64)params->left.csr.row_count * right->non_zero_count;
+  u64 left_count    = (u64)params->left.csr.row_count * right->row_count;
 
-  for (usize row = 0; row < left.row_count; row++)
+  Operation_Counts result =
   {
-    for (usize k = 0; k < right.row_count; k++)
-    {
-      usize left_index = row * left.col_count + k;
-      f64 left_value   = LOAD(left.values[left_index]);
+    .flops  = 2 * product_count,
+    .memops = 3 * left_count + 4 * product_count,
+    .bytes  = (sizeof(f64) + 2 * sizeof(u32)) * left_count + (sizeof(u32) + 3 * sizeof(f64)) * product_count,
+  };
 
-      usize right_row_start = LOAD(right.row_pointers[k]);
-      usize right_row_close = LOAD(right.row_pointers[k + 1]);
+  return result;
+}
 
-      for (usize rj = right_row_start; rj < right_row_close; rj++)
-      {
-        usize col = LOAD(right.col_indices[rj]);
-        f64 right_value = LOAD(right.values[rj]);
+static
+Operation_Counts count_dense_csc(Operation_Parameters *params)
+{
+  CSR_Matrix *right = &params->right.csr;
 
-        usize output_index = row * output.col_count + col;
-        f64 output_value   = output.values[output_index];
+  // Row indices are read without a LOAD
+  u64 output_count  = (u64)params->output.row_count * params->output.col_count;
+  u64 product_count = (u64)params->left.csr.row_count * right->non_zero_count;
 
-        FMADD(output_value, left_value, right_value);
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 3 * output_count + 2 * product_count,
+    .bytes  = (2 * sizeof(u32) + sizeof(f64)) * output_count + 2 * sizeof(f64) * product_count,
+  };
 
-        STORE(output.values[output_index], output_value);
-      }
-    }
-  }
+  return result;
+}
 
-  repetition_tester_close_time(tester);
+static
+Operation_Counts count_csr_dense(Operation_Parameters *params)
+{
+  CSR_Matrix *left = &params->left.csr;
+
+  return count_csr_dense_sized(2 * (u64)left->row_count, left->non_zero_count, params->right.csr.col_count,
+                               sizeof(u32), sizeof(u32), sizeof(f64), sizeof(f64), sizeof(f64));
 }
 
 static
-void matmul_dense_csc(Repetition_Tester *tester, Operation_Parameters *params)
+Operation_Counts count_csr_dense_simd(Operation_Parameters *params)
 {
-  Dense_Matrix left   = params->left.dense;
-  CSC_Matrix right    = params->right.csc;
-  Dense_Matrix output = params->output;
+  CSR_Matrix *left = &params->left.csr;
 
-  repetition_tester_begin_time(tester);
+  u64 product_count = (u64)left->non_zero_count * params->right.csr.col_count;
+  u64 output_count  = (u64)params->output.row_count * params->output.col_count;
 
-  for (usize row = 0; row < left.row_count; row++)
+  Operation_Counts result =
   {
-    for (usize col = 0; col < right.col_count; col++)
-    {
-      usize output_index = row * output.col_count + col;
-      f64 output_value = 0.0;
+    .flops  = 2 * product_count,
+    .memops = 2 * (u64)left->row_count + 2 * (u64)left->non_zero_count + product_count + output_count,
+    .bytes  = 2 * sizeof(u32) * (u64)left->row_count + (sizeof(u32) + sizeof(f64)) * (u64)left->non_zero_count +
+              sizeof(f64) * (product_count + output_count),
+  };
 
-      usize right_col_start = LOAD(right.col_pointers[col]);
-      usize right_col_close   = LOAD(right.col_pointers[col + 1]);
-      for (usize kc = right_col_start; kc < right_col_close; kc++)
-      {
-        usize k = right.row_indices[kc];
-        f64 right_value = LOAD(right.values[kc]);
+  return result;
+}
 
-        usize left_index = row * left.col_count + k;
-        f64 left_value = LOAD(left.values[left_index]);
+static
+Operation_Counts count_csr_dense_tiled(Operation_Parameters *params)
+{
+  CSR_Matrix *left = &params->left.csr;
+  u64 col_count    = params->right.csr.col_count;
 
-        FMADD(output_value, left_value, right_value);
-      }
+  usize panel_width = spmm_dense_panel_width(params->right.csr.row_count, col_count);
+  u64 panel_count   = panel_width ? (col_count + panel_width - 1) / panel_width : 0;
+  u64 product_count = (u64)left->non_zero_count * col_count;
+  u64 output_count  = (u64)params->output.row_count * params->output.col_count;
 
-      STORE(output.values[output_index], output_value);
-    }
-  }
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = panel_count * (2 * (u64)left->row_count + 2 * (u64)left->non_zero_count) + product_count + output_count,
+    .bytes  = panel_count * (2 * sizeof(u32) * (u64)left->row_count +
+                             (sizeof(u32) + sizeof(f64)) * (u64)left->non_zero_count) +
+              sizeof(f64) * (product_count + output_count),
+  };
 
-  repetition_tester_close_time(tester);
+  return result;
 }
 
-Operation_Entry test_entries[] =
+static
+Operation_Counts count_reorder_scatter(Operation_Parameters *params)
 {
-  {STR("dense_X_dense"), matmul_dense_dense},
-  {STR("dense_X_csr"),   matmul_dense_csr},
-  {STR("dense_X_csc"),   matmul_dense_csc},
-  {STR("csr_X_dense"),   matmul_csr_dense},
-  {STR("csr_X_csr"),     matmul_csr_csr},
-  {STR("csr_X_csc"),     matmul_csr_csc},
-  {STR("csc_X_dense"),   matmul_csc_dense},
-  {STR("csc_X_csr"),     matmul_csc_csr},
-  {STR("csc_X_csc"),     matmul_csc_csc},
-};
+  u64 count = (u64)params->output.row_count * params->output.col_count;
 
-#include <math.h>
+  Operation_Counts result = {0, 2 * count, 2 * sizeof(f64) * count};
+
+  return result;
+}
 
 static
-b32 epsilon_equal(f64 a, f64 b)
+Operation_Counts count_csr_dense_reordered(Operation_Parameters *params)
 {
-  f64 epsilon = 0.00001;
+  Operation_Counts result  = count_csr_dense(params);
+  Operation_Counts scatter = count_reorder_scatter(params);
 
-  return fabs(a - b) <= epsilon;
+  result.memops += scatter.memops;
+  result.bytes  += scatter.bytes;
+
+  return result;
 }
 
-Operation_Parameters init_params(Arena *arena, u32 row_count, u32 col_count, u32 inner_count, f64 density)
+static
+Operation_Counts count_csr_csr(Operation_Parameters *params)
 {
-  Dense_Matrix left_dense  = make_random_dense_matrix(arena, row_count, inner_count, density);
-  Dense_Matrix right_dense = make_random_dense_matrix(arena, inner_count, col_count, density);
-  Dense_Matrix output =
+  CSR_Matrix *left = &params->left.csr;
+  u64 product_count = sparse_product_count(left, &params->right.csr);
+
+  Operation_Counts result =
   {
-    .row_count = row_count,
-    .col_count = col_count,
-    .values = arena_calloc(arena, row_count * col_count, f64),
+    .flops  = 2 * product_count,
+    .memops = 2 * (u64)left->row_count + 4 * (u64)left->non_zero_count + 4 * product_count,
+    .bytes  = 2 * sizeof(u32) * (u64)left->row_count + (3 * sizeof(u32) + sizeof(f64)) * (u64)left->non_zero_count +
+              (sizeof(u32) + 3 * sizeof(f64)) * product_count,
   };
 
-  Operation_Parameters params =
-  {
-    .left.dense = left_dense,
-    .left.csr = csr_from_dense(arena, &left_dense),
-    .left.csc = csc_from_dense(arena, &left_dense),
+  return result;
+}
 
-    .right.dense = right_dense,
-    .right.csr = csr_from_dense(arena, &right_dense),
-    .right.csc = csc_from_dense(arena, &right_dense),
+// Permuting both sides leaves the product count alone
+static
+Operation_Counts count_csr_csr_reordered(Operation_Parameters *params)
+{
+  Operation_Counts result  = count_csr_csr(params);
+  Operation_Counts scatter = count_reorder_scatter(params);
 
-    .output = output,
-  };
+  result.memops += scatter.memops;
+  result.bytes  += scatter.bytes;
 
-  return params;
+  return result;
 }
 
-int main(int arg_count, char **args)
+// Upper bound pass, then the accumulate pass
+static
+Operation_Counts count_csr_csr_sparse(Operation_Parameters *params)
 {
-  if (arg_count < 5)
-  {
-    printf("Usage: %s [seconds_to_try_for_min] [row_count] [col_count] [inner_count] [verify/no-verify]\n", args[0]);
-    return -1;
-  }
+  CSR_Matrix *left = &params->left.csr;
+  u64 product_count = sparse_product_count(left, &params->right.csr);
 
-  Arena arena = arena_make(.reserve_size = GB(64));
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 4 * (u64)left->row_count + 7 * (u64)left->non_zero_count + 2 * product_count,
+    .bytes  = 4 * sizeof(u32) * (u64)left->row_count + (6 * sizeof(u32) + sizeof(f64)) * (u64)left->non_zero_count +
+              (sizeof(u32) + sizeof(f64)) * product_count,
+  };
 
-  u32 seconds_to_try_for_min = atoi(args[1]);
-  u64 cpu_timer_frequency = estimate_cpu_timer_freq();
+  return result;
+}
 
-  u32 row_count = atoi(args[2]);
-  u32 col_count = atoi(args[3]);
-  u32 inner_count = atoi(args[4]);
+// Upper bound pass, then spgemm_symbolic_row() twice, for the sizes and the pattern
+static
+Operation_Counts count_csr_csr_symbolic(Operation_Parameters *params)
+{
+  CSR_Matrix *left = &params->left.csr;
+  u64 product_count = sparse_product_count(left, &params->right.csr);
 
-  if (arg_count == 6)
+  Operation_Counts result =
   {
-    if (strcmp(args[5], "verify") == 0)
-    {
-      // Arbitrary sparsity to check
-      Operation_Parameters params = init_params(&arena, row_count, col_count, inner_count, 0.4);
+    .flops  = 0,
+    .memops = 6 * (u64)left->row_count + 9 * (u64)left->non_zero_count + 2 * product_count,
+    .bytes  = sizeof(u32) * (6 * (u64)left->row_count + 9 * (u64)left->non_zero_count + 2 * product_count),
+  };
 
-      b32 had_failure = false;
-      Repetition_Tester dummy = {0};
-      // Just gonna take a copy of the dense dense to compare against
-      matmul_dense_dense(&dummy, &params);
+  return result;
+}
 
-      usize count = params.output.row_count * params.output.col_count;
-      f64 *reference = arena_calloc(&arena, count, f64);
-      MEM_COPY(reference, params.output.values, sizeof(f64) * count);
+static
+Operation_Counts count_csr_csr_numeric(Operation_Parameters *params)
+{
+  CSR_Matrix *left = &params->left.csr;
+  u64 product_count    = sparse_product_count(left, &params->right.csr);
+  u64 output_non_zeros = params->spgemm_plan.output.non_zero_count;
 
-      for (isize i = 1; i < STATIC_COUNT(test_entries); i++)
-      {
-        Operation_Entry *entry = test_entries + i;
+  // Output pattern zeroed in the workspace then gathered back, around the same products as csr_X_csr
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 4 * (u64)left->row_count + 5 * output_non_zeros + 4 * (u64)left->non_zero_count + 4 * product_count,
+    .bytes  = 4 * sizeof(u32) * (u64)left->row_count + (2 * sizeof(u32) + 3 * sizeof(f64)) * output_non_zeros +
+              (3 * sizeof(u32) + sizeof(f64)) * (u64)left->non_zero_count +
+              (sizeof(u32) + 3 * sizeof(f64)) * product_count,
+  };
 
-        MEM_SET(params.output.values, sizeof(f64) * params.output.row_count * params.output.col_count, 0);
-        entry->function(&dummy, &params);
+  return result;
+}
 
-        for (isize v = 0; v < count; v++)
-        {
-          if (!epsilon_equal(params.output.values[v], reference[v]))
-          {
-            LOG_ERROR("Entry '%.*s' does not match reference (%f:%f)",
-                      STRF(entry->name), reference[v], params.output.values[v]);
-            had_failure = true;
-            break;
-          }
-        }
-      }
+// A merge stops once either list runs out, so both only get consumed up to the smaller of their
+// last indices. Every step consumes one index from each side that holds the current smallest,
+// which is steps = consumed left + consumed right - matches. Matches over every pair are just the
+// product count
+static
+Operation_Counts count_csr_csc(Operation_Parameters *params)
+{
+  CSR_Matrix *left  = &params->left.csr;
+  CSC_Matrix *right = &params->right.csc;
 
-      arena_clear(&arena);
+  u64 consumed_count = 0;
+  for (usize row = 0; row < left->row_count; row++)
+  {
+    u32 *left_indices = left->col_indices + left->row_pointers[row];
+    u64 left_count    = left->row_pointers[row + 1] - left->row_pointers[row];
+    if (!left_count)
+    {
+      continue;
+    }
 
-      if (!had_failure)
+    for (usize col = 0; col < right->col_count; col++)
+    {
+      u32 *right_indices = right->row_indices + right->col_pointers[col];
+      u64 right_count    = right->col_pointers[col + 1] - right->col_pointers[col];
+      if (!right_count)
       {
-        LOG_INFO("All entries match reference");
+        continue;
       }
+
+      u32 last = MIN(left_indices[left_count - 1], right_indices[right_count - 1]);
+      consumed_count += sorted_count_at_most(left_indices, left_count, last) +
+                        sorted_count_at_most(right_indices, right_count, last);
     }
   }
 
-  // Roofline
+  u64 product_count = sparse_product_count(left, &params->right.csr);
+  u64 step_count    = consumed_count - product_count;
+  u64 pair_count    = (u64)left->row_count * right->col_count;
+
+  Operation_Counts result =
   {
-    {
-      Repetition_Tester bandwidth_tester = {0};
-      repetition_tester_new_wave(&bandwidth_tester, 0, cpu_timer_frequency, seconds_to_try_for_min);
+    .flops  = 2 * product_count,
+    .memops = 2 * (u64)left->row_count + 3 * pair_count + 2 * step_count + 2 * product_count,
+    .bytes  = 2 * sizeof(u32) * (u64)left->row_count + (2 * sizeof(u32) + sizeof(f64)) * pair_count +
+              2 * sizeof(u32) * step_count + 2 * sizeof(f64) * product_count,
+  };
 
-      printf("\n--- Roofline Bandwidth ---\n");
-      printf("                                                          \r");
-      while (repetition_tester_is_testing(&bandwidth_tester))
-      {
-        roofline_bandwidth(&bandwidth_tester);
-      }
-      Repetition_Test_Values v = bandwidth_tester.results.min;
-      u64 time    = v.v[REPTEST_VALUE_TIME];
-      u64 bytes   = v.v[REPTEST_VALUE_BYTE_COUNT];
+  return result;
+}
+
+// Only what every path has to do, same as the kernel observes. The lookup path multiplies every
+// entry of the column, misses included, so those pairs count their whole length
+static
+Operation_Counts count_csr_csc_adaptive(Operation_Parameters *params)
+{
+  CSR_Matrix *left  = &params->left.csr;
+  CSC_Matrix *right = &params->right.csc;
+
+  u64 match_count = sparse_product_count(left, &params->right.csr);
+
+  u8 *marked = arena_calloc(params->arena, MAX(left->col_count, 1), u8);
+  for (usize row = 0; row < left->row_count; row++)
+  {
+    u32 *left_indices = left->col_indices + left->row_pointers[row];
+    u64 left_count    = left->row_pointers[row + 1] - left->row_pointers[row];
 
-      printf("Roofline bandwidth: %f\n", (f64)bytes/time);
+    if (!left_count || left_count * INTERSECT_LOOKUP_DENSITY < left->col_count)
+    {
+      continue;
     }
 
+    for (usize i = 0; i < left_count; i++)
     {
-      Repetition_Tester flop_tester = {0};
-      repetition_tester_new_wave(&flop_tester, 0, cpu_timer_frequency, seconds_to_try_for_min);
+      marked[left_indices[i]] = true;
+    }
 
-      printf("\n--- Roofline flops/s ---\n");
-      printf("                                                          \r");
-      while (repetition_tester_is_testing(&flop_tester))
+    for (usize col = 0; col < right->col_count; col++)
+    {
+      u64 right_count = right->col_pointers[col + 1] - right->col_pointers[col];
+      if (!right_count || right_count > left_count)
       {
-        roofline_flops(&flop_tester);
+        continue;
       }
 
-      Repetition_Test_Values v = flop_tester.results.min;
-      u64 time    = v.v[REPTEST_VALUE_TIME];
-      u64 flops   = v.v[REPTEST_VALUE_FLOP_COUNT];
-
-      printf("Roofline flops/cycle: %f\n", (f64)flops/time);
+      for (usize j = right->col_pointers[col]; j < right->col_pointers[col + 1]; j++)
+      {
+        match_count += !marked[right->row_indices[j]];
+      }
     }
+
+    for (usize i = 0; i < left_count; i++)
+    {
+      marked[left_indices[i]] = false;
+    }
+  }
+
+  u64 output_count = (u64)params->output.row_count * params->output.col_count;
+  u64 row_count    = params->left.csr.row_count;
+
+  Operation_Counts result =
+  {
+    .flops  = 2 * match_count,
+    .memops = 2 * row_count + 2 * output_count + 2 * match_count + output_count,
+    .bytes  = sizeof(u32) * (2 * row_count + 2 * output_count) + sizeof(f64) * (2 * match_count + output_count),
+  };
+
+  return result;
+}
+
+static
+Operation_Counts count_csc_dense(Operation_Parameters *params)
+{
+  CSC_Matrix *left = &params->left.csc;
+
+  return count_csr_dense_sized(2 * (u64)left->col_count, left->non_zero_count, params->right.csr.col_count,
+                               sizeof(u32), sizeof(u32), sizeof(f64), sizeof(f64), sizeof(f64));
+}
+
+static
+Operation_Counts count_csc_dense_simd(Operation_Parameters *params)
+{
+  CSC_Matrix *left = &params->left.csc;
+
+  u64 product_count = (u64)left->non_zero_count * params->right.csr.col_count;
+  u64 right_count   = (u64)params->right.csr.row_count * params->right.csr.col_count;
+
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 2 * (u64)left->col_count + 2 * (u64)left->non_zero_count + right_count + 2 * product_count,
+    .bytes  = 2 * sizeof(u32) * (u64)left->col_count + (sizeof(u32) + sizeof(f64)) * (u64)left->non_zero_count +
+              sizeof(f64) * (right_count + 2 * product_count),
+  };
+
+  return result;
+}
+
+static
+Operation_Counts count_csc_dense_tiled(Operation_Parameters *params)
+{
+  CSC_Matrix *left = &params->left.csc;
+  u64 col_count    = params->right.csr.col_count;
+
+  usize panel_width = spmm_dense_panel_width(params->output.row_count, col_count);
+  u64 panel_count   = panel_width ? (col_count + panel_width - 1) / panel_width : 0;
+  u64 product_count = (u64)left->non_zero_count * col_count;
+  u64 right_count   = (u64)params->right.csr.row_count * col_count;
+
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = panel_count * (2 * (u64)left->col_count + 2 * (u64)left->non_zero_count) + right_count + 2 * product_count,
+    .bytes  = panel_count * (2 * sizeof(u32) * (u64)left->col_count +
+                             (sizeof(u32) + sizeof(f64)) * (u64)left->non_zero_count) +
+              sizeof(f64) * (right_count + 2 * product_count),
+  };
+
+  return result;
+}
+
+static
+Operation_Counts count_csc_csr(Operation_Parameters *params)
+{
+  CSR_Matrix *right = &params->right.csr;
+  u64 product_count = sparse_product_count(&params->left.csr, right);
+  u64 non_zeros     = params->left.csc.non_zero_count;
+
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 4 * (u64)right->row_count + 2 * non_zeros + 4 * product_count,
+    .bytes  = 4 * sizeof(u32) * (u64)right->row_count + (sizeof(u32) + sizeof(f64)) * non_zeros +
+              (sizeof(u32) + 3 * sizeof(f64)) * product_count,
+  };
+
+  return result;
+}
+
+static
+Operation_Counts count_csc_csc(Operation_Parameters *params)
+{
+  CSC_Matrix *right = &params->right.csc;
+  u64 product_count = sparse_product_count(&params->left.csr, &params->right.csr);
+
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 2 * (u64)right->col_count + 4 * (u64)right->non_zero_count + 4 * product_count,
+    .bytes  = 2 * sizeof(u32) * (u64)right->col_count + (3 * sizeof(u32) + sizeof(f64)) * (u64)right->non_zero_count +
+              (sizeof(u32) + 3 * sizeof(f64)) * product_count,
+  };
+
+  return result;
+}
+
+// Walks the blocks, since the ones hanging off the edge go through the per value path
+static
+Operation_Counts count_bcsr_dense(Operation_Parameters *params)
+{
+  BCSR_Matrix *left = &params->left.bcsr;
+  u64 R = left->block_rows, C = left->block_cols;
+  u64 col_count = params->right.csr.col_count;
+
+  Operation_Counts result = {0};
+  result.memops = 2 * (u64)left->block_row_count + left->block_count;
+  result.bytes  = sizeof(u32) * result.memops;
+
+  for (usize block_row = 0; block_row < left->block_row_count; block_row++)
+  {
+    u64 row_limit = MIN(R, left->row_count - block_row * R);
+
+    for (usize k = left->block_row_pointers[block_row]; k < left->block_row_pointers[block_row + 1]; k++)
+    {
+      u64 col_limit = MIN(C, left->col_count - left->block_col_indices[k] * C);
+
+      u64 memops = 0;
+      if (row_limit < R || col_limit < C)
+      {
+        memops = row_limit * col_limit * (1 + 3 * col_count);
+        result.flops += 2 * row_limit * col_limit * col_count;
+      }
+      else
+      {
+        memops = R * C + col_count * (C + 2 * R);
+        result.flops += 2 * R * C * col_count;
+      }
+
+      result.memops += memops;
+      result.bytes  += sizeof(f64) * memops;
+    }
+  }
+
+  return result;
+}
+
+static
+Operation_Counts count_bcsr_bcsr(Operation_Parameters *params)
+{
+  BCSR_Matrix *left  = &params->left.bcsr;
+  BCSR_Matrix *right = &params->right.bcsr;
+  u64 R = left->block_rows, C = left->block_cols;
+
+  // Pointers and block indices are u32, every value f64
+  u64 index_memops = 2 * (u64)left->block_row_count + left->block_count;
+  u64 value_memops = 0;
+
+  Operation_Counts result = {0};
+
+  for (usize block_row = 0; block_row < left->block_row_count; block_row++)
+  {
+    u64 row_limit = MIN(R, left->row_count - block_row * R);
+
+    for (usize k = left->block_row_pointers[block_row]; k < left->block_row_pointers[block_row + 1]; k++)
+    {
+      u32 block_col = left->block_col_indices[k];
+
+      value_memops += R * C;
+      index_memops += 2;
+
+      for (usize j = right->block_row_pointers[block_col]; j < right->block_row_pointers[block_col + 1]; j++)
+      {
+        u64 col_limit = MIN(C, right->col_count - right->block_col_indices[j] * C);
+
+        index_memops += 1;
+        if (row_limit < R || col_limit < C)
+        {
+          value_memops += row_limit * col_limit * (2 + 2 * C);
+          result.flops += 2 * row_limit * col_limit * C;
+        }
+        else
+        {
+          value_memops += C * C + 2 * R * C;
+          result.flops += 2 * R * C * C;
+        }
+      }
+    }
+  }
+
+  result.memops = index_memops + value_memops;
+  result.bytes  = sizeof(u32) * index_memops + sizeof(f64) * value_memops;
+
+  return result;
+}
+
+static
+Operation_Counts count_sell_dense(Operation_Parameters *params)
+{
+  SELL_Matrix *left = &params->left.sell;
+
+  u64 product_count = (u64)left->padded_count * params->right.csr.col_count;
+  u64 output_count  = (u64)params->output.row_count * params->output.col_count;
+
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 2 * (u64)left->chunk_count + 2 * (u64)left->padded_count + product_count + output_count,
+    .bytes  = sizeof(u32) * (u64)left->chunk_count * (2 + SELL_CHUNK_HEIGHT) +
+              (sizeof(u32) + sizeof(f64)) * (u64)left->padded_count + sizeof(f64) * (product_count + output_count),
+  };
+
+  return result;
+}
+
+// Row id and both pointers per stored row
+static
+Operation_Counts count_dcsr_dense(Operation_Parameters *params)
+{
+  DCSR_Matrix *left = &params->left.dcsr;
+
+  return count_csr_dense_sized(3 * (u64)left->non_empty_row_count, left->non_zero_count, params->right.csr.col_count,
+                               sizeof(u32), sizeof(u32), sizeof(f64), sizeof(f64), sizeof(f64));
+}
+
+static
+Operation_Counts count_dcsr_csr(Operation_Parameters *params)
+{
+  DCSR_Matrix *left = &params->left.dcsr;
+  u64 product_count = sparse_product_count(&params->left.csr, &params->right.csr);
+
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 3 * (u64)left->non_empty_row_count + 4 * (u64)left->non_zero_count + 4 * product_count,
+    .bytes  = 3 * sizeof(u32) * (u64)left->non_empty_row_count +
+              (3 * sizeof(u32) + sizeof(f64)) * (u64)left->non_zero_count +
+              (sizeof(u32) + 3 * sizeof(f64)) * product_count,
+  };
+
+  return result;
+}
+
+static
+Operation_Counts count_dcsc_dense(Operation_Parameters *params)
+{
+  DCSC_Matrix *left = &params->left.dcsc;
+
+  return count_csr_dense_sized(3 * (u64)left->non_empty_col_count, left->non_zero_count, params->right.csr.col_count,
+                               sizeof(u32), sizeof(u32), sizeof(f64), sizeof(f64), sizeof(f64));
+}
+
+// Column id, its pointers and the right row's pointers per stored column
+static
+Operation_Counts count_dcsc_csr(Operation_Parameters *params)
+{
+  DCSC_Matrix *left = &params->left.dcsc;
+  u64 product_count = sparse_product_count(&params->left.csr, &params->right.csr);
+
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 5 * (u64)left->non_empty_col_count + 2 * (u64)left->non_zero_count + 4 * product_count,
+    .bytes  = 5 * sizeof(u32) * (u64)left->non_empty_col_count + (sizeof(u32) + sizeof(f64)) * (u64)left->non_zero_count +
+              (sizeof(u32) + 3 * sizeof(f64)) * product_count,
+  };
+
+  return result;
+}
+
+static
+Operation_Counts count_coo_dense(Operation_Parameters *params)
+{
+  COO_Matrix *left = &params->left.coo;
+  u64 product_count = (u64)left->non_zero_count * params->right.csr.col_count;
+
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 3 * (u64)left->non_zero_count + 3 * product_count,
+    .bytes  = (2 * sizeof(u32) + sizeof(f64)) * (u64)left->non_zero_count + 3 * sizeof(f64) * product_count,
+  };
+
+  return result;
+}
+
+static
+Operation_Counts count_coo_csr(Operation_Parameters *params)
+{
+  COO_Matrix *left  = &params->left.coo;
+  u64 product_count = sparse_product_count(&params->left.csr, &params->right.csr);
+
+  Operation_Counts result =
+  {
+    .flops  = 2 * product_count,
+    .memops = 5 * (u64)left->non_zero_count + 4 * product_count,
+    .bytes  = (4 * sizeof(u32) + sizeof(f64)) * (u64)left->non_zero_count + (sizeof(u32) + 3 * sizeof(f64)) * product_count,
+  };
+
+  return result;
+}
+
+// Same loop as csr_X_dense, over whatever element sizes the narrow format has. Nothing if the
+// format was never built
+#define COUNT_COMPACT_CSR_DENSE(name, left_field, Stored, Index, Accumulator)                      \
+static                                                                                            \
+Operation_Counts name(Operation_Parameters *params)                                               \
+{                                                                                                 \
+  Operation_Counts result = {0};                                                                  \
+                                                                                                  \
+  if (params->left.left_field.row_pointers)                                                       \
+  {                                                                                               \
+    result = count_csr_dense_sized(2 * (u64)params->left.left_field.row_count,                    \
+                                   params->left.left_field.non_zero_count,                        \
+                                   params->right.csr.col_count, sizeof(u32), sizeof(Index),       \
+                                   sizeof(Stored), sizeof(Stored), sizeof(Accumulator));          \
+  }                                                                                               \
+                                                                                                  \
+  return result;                                                                                  \
+}
+
+COUNT_COMPACT_CSR_DENSE(count_csr_f32_dense_f32,       csr_f32,     f32,  u32, f32)
+COUNT_COMPACT_CSR_DENSE(count_csr_f32_dense_f32_acc64, csr_f32,     f32,  u32, f64)
+COUNT_COMPACT_CSR_DENSE(count_csr_bf16_dense_bf16,     csr_bf16,    bf16, u32, f32)
+COUNT_COMPACT_CSR_DENSE(count_csr_u16_dense,           csr_u16,     f64,  u16, f64)
+COUNT_COMPACT_CSR_DENSE(count_csr_f32_u16_dense_f32,   csr_f32_u16, f32,  u16, f32)
+
+typedef struct Operation_Counter Operation_Counter;
+struct Operation_Counter
+{
+  void (*function)(Repetition_Tester *, Operation_Parameters *);
+  Operation_Counts (*count)(Operation_Parameters *);
+};
+
+// Every test entry but auto, which counts as whatever it picks
+static Operation_Counter operation_counters[] =
+{
+  {spmm_matmul_dense_dense,             count_dense_dense},
+  {spmm_matmul_dense_dense_blocked,     count_dense_dense_blocked},
+  {spmm_matmul_dense_csr,               count_dense_csr},
+  {spmm_matmul_dense_csr_simd,          count_dense_csr_simd},
+  {spmm_matmul_dense_csc,               count_dense_csc},
+  {spmm_matmul_csr_dense,               count_csr_dense},
+  {spmm_matmul_csr_dense_simd,          count_csr_dense_simd},
+  {spmm_matmul_csr_dense_tiled,         count_csr_dense_tiled},
+  {spmm_matmul_csr_dense_threads_2,     count_csr_dense},
+  {spmm_matmul_csr_dense_threads_4,     count_csr_dense},
+  {spmm_matmul_csr_dense_threads_8,     count_csr_dense},
+  {spmm_matmul_csr_dense_threads_16,    count_csr_dense},
+  {spmm_matmul_csr_dense_threads_32,    count_csr_dense},
+  {spmm_matmul_csr_dense_rcm,           count_csr_dense_reordered},
+  {spmm_matmul_csr_dense_degree,        count_csr_dense_reordered},
+  {spmm_matmul_csr_dense_cluster,       count_csr_dense_reordered},
+  {spmm_matmul_csr_csr,                 count_csr_csr},
+  {spmm_matmul_csr_csr_rcm,             count_csr_csr_reordered},
+  {spmm_matmul_csr_csr_degree,          count_csr_csr_reordered},
+  {spmm_matmul_csr_csr_cluster,         count_csr_csr_reordered},
+  {spmm_matmul_csr_csr_sparse,          count_csr_csr_sparse},
+  {spmm_matmul_csr_csr_symbolic,        count_csr_csr_symbolic},
+  {spmm_matmul_csr_csr_numeric,         count_csr_csr_numeric},
+  {spmm_matmul_csr_csc,                 count_csr_csc},
+  {spmm_matmul_csr_csc_adaptive,        count_csr_csc_adaptive},
+  {spmm_matmul_csc_dense,               count_csc_dense},
+  {spmm_matmul_csc_dense_simd,          count_csc_dense_simd},
+  {spmm_matmul_csc_dense_tiled,         count_csc_dense_tiled},
+  {spmm_matmul_csc_csr,                 count_csc_csr},
+  {spmm_matmul_csc_csc,                 count_csc_csc},
+  {spmm_matmul_bcsr_dense,              count_bcsr_dense},
+  {spmm_matmul_bcsr_bcsr,               count_bcsr_bcsr},
+  {spmm_matmul_sell_dense,              count_sell_dense},
+  {spmm_matmul_dcsr_dense,              count_dcsr_dense},
+  {spmm_matmul_dcsr_csr,                count_dcsr_csr},
+  {spmm_matmul_dcsc_dense,              count_dcsc_dense},
+  {spmm_matmul_dcsc_csr,                count_dcsc_csr},
+  {spmm_matmul_coo_dense,               count_coo_dense},
+  {spmm_matmul_coo_csr,                 count_coo_csr},
+  {spmm_matmul_csr_f32_dense_f32,       count_csr_f32_dense_f32},
+  {spmm_matmul_csr_f32_dense_f32_acc64, count_csr_f32_dense_f32_acc64},
+  {spmm_matmul_csr_bf16_dense_bf16,     count_csr_bf16_dense_bf16},
+  {spmm_matmul_csr_u16_dense,           count_csr_u16_dense},
+  {spmm_matmul_csr_f32_u16_dense_f32,   count_csr_f32_u16_dense_f32},
+};
+
+static
+Operation_Counts operation_counts(Operation_Parameters *params,
+                                  void (*function)(Repetition_Tester *, Operation_Parameters *))
+{
+  if (function == spmm_auto)
+  {
+    usize choice = spmm_auto_choose(params, spmm_held_formats(&params->left), spmm_held_formats(&params->right), NULL);
+    function = spmm_auto_candidates[choice].function;
+  }
+
+  Operation_Counts result = {0};
+
+  for (usize i = 0; i < STATIC_COUNT(operation_counters); i++)
+  {
+    if (operation_counters[i].function == function)
+    {
+      result = operation_counters[i].count(params);
+    }
+  }
+
+  return result;
+}
+
+Operation_Entry test_entries[] =
+{
+  {STR("dense_X_dense"),             spmm_matmul_dense_dense},
+  {STR("dense_X_dense_blocked"),     spmm_matmul_dense_dense_blocked},
+  {STR("dense_X_csr"),               spmm_matmul_dense_csr},
+  {STR("dense_X_csr_simd"),          spmm_matmul_dense_csr_simd},
+  {STR("dense_X_csc"),               spmm_matmul_dense_csc},
+  {STR("csr_X_dense"),               spmm_matmul_csr_dense},
+  {STR("csr_X_dense_simd"),          spmm_matmul_csr_dense_simd},
+  {STR("csr_X_dense_tiled"),         spmm_matmul_csr_dense_tiled},
+  {STR("csr_X_dense_t2"),            spmm_matmul_csr_dense_threads_2},
+  {STR("csr_X_dense_t4"),            spmm_matmul_csr_dense_threads_4},
+  {STR("csr_X_dense_t8"),            spmm_matmul_csr_dense_threads_8},
+  {STR("csr_X_dense_t16"),           spmm_matmul_csr_dense_threads_16},
+  {STR("csr_X_dense_t32"),           spmm_matmul_csr_dense_threads_32},
+  {STR("csr_X_dense_rcm"),           spmm_matmul_csr_dense_rcm},
+  {STR("csr_X_dense_degree"),        spmm_matmul_csr_dense_degree},
+  {STR("csr_X_dense_cluster"),       spmm_matmul_csr_dense_cluster},
+  {STR("csr_X_csr"),                 spmm_matmul_csr_csr},
+  {STR("csr_X_csr_rcm"),             spmm_matmul_csr_csr_rcm},
+  {STR("csr_X_csr_degree"),          spmm_matmul_csr_csr_degree},
+  {STR("csr_X_csr_cluster"),         spmm_matmul_csr_csr_cluster},
+  {STR("csr_X_csr_sparse"),          spmm_matmul_csr_csr_sparse},
+  {STR("csr_X_csr_symbolic"),        spmm_matmul_csr_csr_symbolic},
+  {STR("csr_X_csr_numeric"),         spmm_matmul_csr_csr_numeric},
+  {STR("csr_X_csc"),                 spmm_matmul_csr_csc},
+  {STR("csr_X_csc_adaptive"),        spmm_matmul_csr_csc_adaptive},
+  {STR("csc_X_dense"),               spmm_matmul_csc_dense},
+  {STR("csc_X_dense_simd"),          spmm_matmul_csc_dense_simd},
+  {STR("csc_X_dense_tiled"),         spmm_matmul_csc_dense_tiled},
+  {STR("csc_X_csr"),                 spmm_matmul_csc_csr},
+  {STR("csc_X_csc"),                 spmm_matmul_csc_csc},
+  {STR("bcsr_X_dense"),              spmm_matmul_bcsr_dense},
+  {STR("bcsr_X_bcsr"),               spmm_matmul_bcsr_bcsr},
+  {STR("sell_X_dense"),              spmm_matmul_sell_dense},
+  {STR("dcsr_X_dense"),              spmm_matmul_dcsr_dense},
+  {STR("dcsr_X_csr"),                spmm_matmul_dcsr_csr},
+  {STR("dcsc_X_dense"),              spmm_matmul_dcsc_dense},
+  {STR("dcsc_X_csr"),                spmm_matmul_dcsc_csr},
+  {STR("coo_X_dense"),               spmm_matmul_coo_dense},
+  {STR("coo_X_csr"),                 spmm_matmul_coo_csr},
+  {STR("csr_f32_X_dense_f32"),       spmm_matmul_csr_f32_dense_f32},
+  {STR("csr_f32_X_dense_f32_acc64"), spmm_matmul_csr_f32_dense_f32_acc64},
+  {STR("csr_bf16_X_dense_bf16"),     spmm_matmul_csr_bf16_dense_bf16},
+  {STR("csr_u16_X_dense"),           spmm_matmul_csr_u16_dense},
+  {STR("csr_f32_u16_X_dense_f32"),   spmm_matmul_csr_f32_u16_dense_f32},
+  {STR("auto"),                      spmm_auto},
+  {STR("libspmm"),                   matmul_libspmm},
+};
+
+#include <math.h>
+#include <stdlib.h>
+
+static
+b32 compressed_equal(u32 major_count, u32 non_zero_count,
+                     u32 *pointers_a, u32 *minors_a, f64 *values_a,
+                     u32 *pointers_b, u32 *minors_b, f64 *values_b)
+{
+  return memcmp(pointers_a, pointers_b, sizeof(u32) * ((usize)major_count + 1)) == 0 &&
+         memcmp(minors_a, minors_b, sizeof(u32) * (usize)non_zero_count) == 0 &&
+         memcmp(values_a, values_b, sizeof(f64) * (usize)non_zero_count) == 0;
+}
+
+static
+b32 epsilon_equal(f64 a, f64 b)
+{
+  f64 epsilon = 0.00001;
+
+  return fabs(a - b) <= epsilon;
+}
+
+// Unit roundoffs of the narrow entries, everything else is checked with epsilon_equal()
+typedef struct Compact_Precision Compact_Precision;
+struct Compact_Precision
+{
+  void (*function)(Repetition_Tester *, Operation_Parameters *);
+  f64 storage_roundoff;
+  f64 accumulate_roundoff;
+  b32 narrow_indices;
+};
+
+static Compact_Precision compact_precisions[] =
+{
+  {spmm_matmul_csr_f32_dense_f32,       0x1p-24, 0x1p-24, false},
+  {spmm_matmul_csr_f32_dense_f32_acc64, 0x1p-24, 0x1p-53, false},
+  {spmm_matmul_csr_bf16_dense_bf16,     0x1p-8,  0x1p-24, false},
+  {spmm_matmul_csr_u16_dense,           0x1p-53, 0x1p-53, true},
+  {spmm_matmul_csr_f32_u16_dense_f32,   0x1p-24, 0x1p-24, true},
+};
+
+static
+Compact_Precision *compact_precision(void (*function)(Repetition_Tester *, Operation_Parameters *))
+{
+  Compact_Precision *result = NULL;
+
+  for (usize i = 0; i < STATIC_COUNT(compact_precisions); i++)
+  {
+    if (compact_precisions[i].function == function)
+    {
+      result = compact_precisions + i;
+    }
+  }
+
+  return result;
+}
+
+// Standard worst case for a sum of n products, relative to the sum of |left| * |right|. Each
+// operand rounded once when stored, a rounding for the multiply and one for the add per term, and
+// the f64 reference's own rounding on top. A little slack for the second order terms
+static
+f64 compact_error_bound(Compact_Precision *precision, u32 inner_count, f64 magnitude)
+{
+  f64 per_magnitude = 2.0 * precision->storage_roundoff +
+                      2.0 * inner_count * (precision->accumulate_roundoff + 0x1p-53);
+
+  return 1.01 * per_magnitude * magnitude;
+}
+
+// Kernels with sparse output leave the dense one alone
+static
+u64 output_non_zero_count(Operation_Parameters *params)
+{
+  u64 result = params->sparse_output.row_pointers ? params->sparse_output.non_zero_count
+                                                  : dense_non_zero_count(&params->output);
+
+  return result;
+}
+
+// Blocks this much bigger than the non zeros they hold aren't worth timing
+#define BCSR_MAX_FILL_RATIO 4.0
+
+// Width of the dense panel each block shape is timed against, and the seconds each gets to find
+// its min
+#define BCSR_TUNE_WIDTH   16
+#define BCSR_TUNE_SECONDS 1
+
+// The shape an operand was tuned to, so however many times it's rebuilt it's only timed once
+typedef struct BCSR_Tune BCSR_Tune;
+struct BCSR_Tune
+{
+  u32 block_rows; // 0 until tuned
+  u32 block_cols;
+};
+
+// Bigger blocks mean fewer index loads but more padding, which ones win depends on the pattern.
+// So convert to each shape, skip the ones that pad too much, and time what's left on a small
+// dense panel. Best time per real non zero wins
+static
+BCSR_Matrix bcsr_autotune(Arena *arena, CSR_Matrix *csr, BCSR_Tune *tune, u64 cpu_timer_frequency)
+{
+  if (tune->block_rows)
+  {
+    return bcsr_from_csr(arena, csr, tune->block_rows, tune->block_cols);
+  }
+
+  Dense_Matrix panel =
+  {
+    .row_count = csr->col_count,
+    .col_count = BCSR_TUNE_WIDTH,
+    .values = arena_calloc(arena, (usize)csr->col_count * BCSR_TUNE_WIDTH, f64),
+  };
+  Dense_Matrix panel_output =
+  {
+    .row_count = csr->row_count,
+    .col_count = BCSR_TUNE_WIDTH,
+    .values = arena_calloc(arena, (usize)csr->row_count * BCSR_TUNE_WIDTH, f64),
+  };
+
+  for (usize i = 0; i < (usize)panel.row_count * panel.col_count; i++)
+  {
+    panel.values[i] = 1.0;
+  }
+
+  BCSR_Matrix result = {0};
+  u64 best_time = 0;
+
+  for (usize i = 0; i < BCSR_KERNEL_COUNT; i++)
+  {
+    BCSR_Kernels *kernels = spmm_bcsr_kernels + i;
+    BCSR_Matrix candidate = bcsr_from_csr(arena, csr, kernels->block_rows, kernels->block_cols);
+
+    f64 fill_ratio = bcsr_fill_ratio(&candidate);
+
+    printf("\n--- BCSR autotune %ux%u, fill %.2f ---\n", kernels->block_rows, kernels->block_cols, fill_ratio);
+    if (fill_ratio > BCSR_MAX_FILL_RATIO)
+    {
+      printf("Skipped\n");
+      continue;
+    }
+    printf("                                                          \r");
+
+    Repetition_Tester tester = {0};
+    repetition_tester_new_wave(&tester, 0, cpu_timer_frequency, BCSR_TUNE_SECONDS);
+    while (repetition_tester_is_testing(&tester))
+    {
+      // The block kernels don't time themselves, that's spmm_matmul_bcsr_dense()
+      repetition_tester_begin_time(&tester);
+
+      kernels->dense(&tester, candidate, panel, panel_output);
+
+      repetition_tester_close_time(&tester);
+    }
+
+    u64 time = tester.results.min.v[REPTEST_VALUE_TIME];
+    printf("%.2f ns/nz\n", 1e9 * time / cpu_timer_frequency / MAX(csr->non_zero_count, 1));
+
+    if (!result.values || time < best_time)
+    {
+      result    = candidate;
+      best_time = time;
+    }
+  }
+  LOG_INFO("BCSR autotune using %ux%u", result.block_rows, result.block_cols);
+
+  tune->block_rows = result.block_rows;
+  tune->block_cols = result.block_cols;
+
+  return result;
+}
+
+// Shared by the random and file inputs
+static
+Operation_Parameters params_from_operands(Arena *arena, Arena *output_arena, Thread_Pool *pool,
+                                          Matrix_Reps left, Matrix_Reps right,
+                                          BCSR_Tune *tune, u64 cpu_timer_frequency)
+{
+  Dense_Matrix output =
+  {
+    .row_count = left.csr.row_count,
+    .col_count = right.csr.col_count,
+    .values = arena_calloc(arena, (usize)left.csr.row_count * right.csr.col_count, f64),
+  };
+
+  Operation_Parameters params =
+  {
+    .left  = left,
+    .right = right,
+
+    .output = output,
+    .output_arena = output_arena,
+    .arena = arena,
+
+    .pool = pool,
+  };
+
+  params.spgemm_plan = spmm_spgemm_symbolic(NULL, arena, params.left.csr, params.right.csr);
+
+  // The right's blocks are square on the left's block width, so the inner blocks line up
+  params.left.bcsr  = bcsr_autotune(arena, &params.left.csr, tune, cpu_timer_frequency);
+  params.right.bcsr = bcsr_from_csr(arena, &params.right.csr, params.left.bcsr.block_cols, params.left.bcsr.block_cols);
+
+  params.left.sell = sell_from_csr(arena, &params.left.csr, SELL_DEFAULT_SORT_WINDOW);
+  params.left.dcsr = dcsr_from_csr(arena, &params.left.csr);
+  params.left.dcsc = dcsc_from_csc(arena, &params.left.csc);
+  params.left.coo  = coo_from_csr(arena, &params.left.csr);
+
+  params.left.csr_f32  = csr_f32_from_csr(arena, &params.left.csr);
+  params.left.csr_bf16 = csr_bf16_from_csr(arena, &params.left.csr);
+  if (params.left.csr.col_count <= COMPACT_INDEX_LIMIT)
+  {
+    params.left.csr_u16     = csr_u16_from_csr(arena, &params.left.csr);
+    params.left.csr_f32_u16 = csr_f32_u16_from_csr(arena, &params.left.csr);
+  }
+  else
+  {
+    LOG_INFO("Inner dimension of %u is too wide for u16 indices, those entries won't run", params.left.csr.col_count);
+  }
+
+  return params;
+}
+
+// Same operands every run, so timings can be compared across builds and machines
+#define RANDOM_OPERAND_SEED 0x5eedf00dull
+
+Operation_Parameters init_params(Arena *arena, Arena *output_arena, Thread_Pool *pool,
+                                 u32 row_count, u32 col_count, u32 inner_count, f64 density, u64 seed,
+                                 BCSR_Tune *tune, u64 cpu_timer_frequency)
+{
+  CSR_Matrix left_csr  = make_random_csr_matrix(arena, pool, row_count, inner_count, density, seed);
+  CSR_Matrix right_csr = make_random_csr_matrix(arena, pool, inner_count, col_count, density, ~seed);
+
+  Matrix_Reps left =
+  {
+    .csr = left_csr,
+    .csc = csc_from_csr(arena, pool, &left_csr),
+  };
+
+  Matrix_Reps right =
+  {
+    .csr = right_csr,
+    .csc = csc_from_csr(arena, pool, &right_csr),
+  };
+
+  return params_from_operands(arena, output_arena, pool, left, right, tune, cpu_timer_frequency);
+}
+
+static
+b32 has_extension(char *path, char *extension)
+{
+  usize path_length      = strlen(path);
+  usize extension_length = strlen(extension);
+
+  return path_length > extension_length && strcmp(path + path_length - extension_length, extension) == 0;
+}
+
+// A X A when it's square, otherwise A X A^T. A's CSC arrays are already A^T's CSR and vice versa
+static
+b32 load_params(Arena *arena, Arena *output_arena, Thread_Pool *pool, char *path, Operation_Parameters *out,
+                BCSR_Tune *tune, u64 cpu_timer_frequency)
+{
+  CSR_Matrix csr = {0};
+  CSC_Matrix csc = {0};
+
+  // NOTE: Binary files stay mapped for the rest of the run, the kernels read straight out of them
+  Sparse_File file = {0};
+  b32 loaded = has_extension(path, SPARSE_FILE_EXTENSION) ? sparse_file_map(path, &file, &csr, &csc)
+                                                          : matrix_market_load(arena, pool, path, &csr, &csc);
+  if (!loaded)
+  {
+    return false;
+  }
+
+  Matrix_Reps left =
+  {
+    .csr = csr,
+    .csc = csc,
+  };
+
+  Matrix_Reps right = left;
+  if (csr.row_count != csr.col_count)
+  {
+    right.csr = (CSR_Matrix)
+    {
+      .non_zero_count = csc.non_zero_count,
+      .row_count      = csc.col_count,
+      .col_count      = csc.row_count,
+      .row_pointers   = csc.col_pointers,
+      .col_indices    = csc.row_indices,
+      .values         = csc.values,
+    };
+
+    right.csc = (CSC_Matrix)
+    {
+      .non_zero_count = csr.non_zero_count,
+      .row_count      = csr.col_count,
+      .col_count      = csr.row_count,
+      .row_indices    = csr.col_indices,
+      .col_pointers   = csr.row_pointers,
+      .values         = csr.values,
+    };
+  }
+
+  *out = params_from_operands(arena, output_arena, pool, left, right, tune, cpu_timer_frequency);
+
+  return true;
+}
+
+// Many small pairs of varied shapes, like the batched workload. Rows and inner 8 to 128, right
+// 1 to 64 wide, and each left somewhere between 2% and 30% full
+static
+Spmm_Batch make_random_batch(Arena *arena, Thread_Pool *pool, u32 count, u64 seed)
+{
+  Random_Series series = random_seed(seed, 0);
+
+  Spmm_Batch_Shape *shapes = arena_calloc(arena, MAX(count, 1), Spmm_Batch_Shape);
+  CSR_Matrix       *lefts  = arena_calloc(arena, MAX(count, 1), CSR_Matrix);
+
+  for (u32 i = 0; i < count; i++)
+  {
+    u32 row_count   = 8 + random_next(&series) % 121;
+    u32 inner_count = 8 + random_next(&series) % 121;
+    u32 col_count   = 1 + random_next(&series) % 64;
+    f64 density     = 0.02 + 0.28 * random_unit(&series);
+
+    lefts[i] = make_random_csr_matrix(arena, pool, row_count, inner_count, density, seed + i + 1);
+
+    shapes[i] = (Spmm_Batch_Shape)
+    {
+      .row_count      = row_count,
+      .inner_count    = inner_count,
+      .col_count      = col_count,
+      .non_zero_count = lefts[i].non_zero_count,
+    };
+  }
+
+  Spmm_Batch result = spmm_batch_alloc(arena, shapes, count);
+
+  for (u32 i = 0; i < count; i++)
+  {
+    CSR_Matrix *left = result.lefts + i;
+    MEM_COPY(left->row_pointers, lefts[i].row_pointers, sizeof(u32) * ((u64)left->row_count + 1));
+    MEM_COPY(left->col_indices,  lefts[i].col_indices,  sizeof(u32) * (u64)left->non_zero_count);
+    MEM_COPY(left->values,       lefts[i].values,       sizeof(f64) * (u64)left->non_zero_count);
+
+    Dense_Matrix *right = result.rights + i;
+    for (u64 v = 0; v < (u64)right->row_count * right->col_count; v++)
+    {
+      right->values[v] = 2.0 * random_unit(&series) - 1.0;
+    }
+  }
+
+  return result;
+}
+
+// What a caller without the batched entry point does, one kernel call per pair in the order
+// they come, zeroing each output first since the kernels accumulate. Timed as a whole like the
+// batch, so the per call setup the batch saves is in it, and the kernels get no tester
+static
+void spmm_batch_per_matrix(Repetition_Tester *tester, Spmm_Batch *batch, Operation_Entry *entry)
+{
+  repetition_tester_begin_time(tester);
+
+  for (u32 i = 0; i < batch->count; i++)
+  {
+    Operation_Parameters params =
+    {
+      .left   = {.csr = batch->lefts[i]},
+      .right  = {.dense = batch->rights[i]},
+      .output = batch->outputs[i],
+    };
+
+    MEM_SET(params.output.values, sizeof(f64) * params.output.row_count * params.output.col_count, 0);
+    entry->function(NULL, &params);
+  }
+
+  repetition_tester_close_time(tester);
+}
+
+// Runs every cell of a sweep config that results_path doesn't have yet. Operands are only made for
+// a shape and density if some entry still needs them
+static
+b32 run_sweep(Arena *arena, Arena *output_arena, Arena *pool_arena, char *config_path, char *results_path,
+              u32 seconds_to_try_for_min, u64 cpu_timer_frequency)
+{
+  // Holds the config and the finished keys for the whole sweep, arena gets cleared per shape
+  Arena sweep_arena = arena_make(.reserve_size = GB(1));
+
+  Sweep_Config config = {0};
+  if (!sweep_config_load(&sweep_arena, config_path, &config))
+  {
+    return false;
+  }
+
+  seconds_to_try_for_min = config.seconds ? config.seconds : seconds_to_try_for_min;
+
+  usize entry_indices[STATIC_COUNT(test_entries)] = {0};
+  usize entry_count = 0;
+  for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+  {
+    b32 wanted = config.entry_count == 0;
+    for (u32 i = 0; i < config.entry_count; i++)
+    {
+      wanted = wanted || strcmp(config.entries[i], string_to_c_string(&sweep_arena, test_entries[func_idx].name)) == 0;
+    }
+
+    if (wanted)
+    {
+      entry_indices[entry_count++] = func_idx;
+    }
+  }
+
+  if (entry_count < MAX(config.entry_count, 1))
+  {
+    LOG_ERROR("Sweep config names %u entries, only %lu of them exist", config.entry_count, entry_count);
+    return false;
+  }
+
+  // One pool per thread count, workers aren't torn down so they have to outlive the sweep
+  Thread_Pool *pools[SWEEP_MAX_VALUES] = {0};
+  for (u32 thread_idx = 0; thread_idx < config.threads.count; thread_idx++)
+  {
+    pools[thread_idx] = thread_pool_make(pool_arena, MAX((u32)config.threads.v[thread_idx], 1));
+  }
+
+  Sweep_Results results = {0};
+  if (!sweep_results_open(&sweep_arena, results_path, &results))
+  {
+    return false;
+  }
+
+  // Every aspect, then every fixed width
+  u32 col_choice_count = config.aspects.count + config.cols.count;
+
+  // Thread count varies fastest, then density, cols, inners, rows
+  u64 combo_count = (u64)config.rows.count * config.inners.count * col_choice_count *
+                    config.densities.count * config.threads.count;
+  u64 cell_total  = combo_count * entry_count;
+  u64 cell_index  = 0;
+
+  // Every thread count of a shape and density gets the same operands, tuned for the first
+  BCSR_Tune tune = {0};
+  u64 tuned_operands = (u64)-1;
+
+  for (u64 combo = 0; combo < combo_count; combo++)
+  {
+    u64 rest = combo;
+    u32 thread_idx  = rest % config.threads.count;   rest /= config.threads.count;
+    u32 density_idx = rest % config.densities.count; rest /= config.densities.count;
+    u32 col_idx     = rest % col_choice_count;       rest /= col_choice_count;
+    u32 inner_idx   = rest % config.inners.count;    rest /= config.inners.count;
+    u32 row_idx     = (u32)rest;
+
+    u32 row_count   = (u32)config.rows.v[row_idx];
+    u32 inner_count = (u32)config.inners.v[inner_idx];
+    u32 col_count   = col_idx < config.aspects.count ? (u32)MAX(round(row_count * config.aspects.v[col_idx]), 1.0)
+                                                     : (u32)config.cols.v[col_idx - config.aspects.count];
+    f64 density     = config.densities.v[density_idx];
+
+    Sweep_Cell cell =
+    {
+      .row_count       = row_count,
+      .col_count       = col_count,
+      .inner_count     = inner_count,
+      .density         = density,
+      .thread_count    = MAX((u32)config.threads.v[thread_idx], 1),
+      .timer_frequency = cpu_timer_frequency,
+    };
+
+    b32 any_left = false;
+    for (usize i = 0; i < entry_count; i++)
+    {
+      cell.entry = string_to_c_string(arena, test_entries[entry_indices[i]].name);
+      any_left = any_left || !sweep_cell_done(&results, &cell);
+    }
+
+    if (!any_left)
+    {
+      cell_index += entry_count;
+      arena_clear(arena);
+      continue;
+    }
+
+    u64 operands = combo / config.threads.count;
+    if (operands != tuned_operands)
+    {
+      tune = (BCSR_Tune){0};
+      tuned_operands = operands;
+    }
+
+    // Same seed for a density whichever order cells run in, so a resumed sweep sees the same operands
+    Operation_Parameters params = init_params(arena, output_arena, pools[thread_idx],
+                                              row_count, col_count, inner_count, density,
+                                              RANDOM_OPERAND_SEED + density_idx,
+                                              &tune, cpu_timer_frequency);
+
+    for (usize i = 0; i < entry_count; i++, cell_index++)
+    {
+      Operation_Entry *entry = test_entries + entry_indices[i];
+
+      cell.entry = string_to_c_string(arena, entry->name);
+      if (sweep_cell_done(&results, &cell))
+      {
+        continue;
+      }
+
+      printf("\n--- [%lu/%lu] %.*s, %ux%ux%u @ %g density, %u threads ---\n", cell_index + 1, cell_total,
+             STRF(entry->name), row_count, col_count, inner_count, density, cell.thread_count);
+      printf("                                                          \r");
+
+      Repetition_Tester tester = {0};
+      repetition_tester_new_wave(&tester, 0, cpu_timer_frequency, seconds_to_try_for_min);
+
+      params.sparse_output = (CSR_Matrix){0};
+
+      // is_testing() folds the last repetition into the total, so the growth since the last check
+      // is that one repetition's time
+      Sweep_Stats stats = {0};
+      u64 seen_test_count = 0;
+      u64 seen_total_time = 0;
+      b32 testing = true;
+      while (testing)
+      {
+        testing = repetition_tester_is_testing(&tester);
+
+        if (tester.results.test_count != seen_test_count)
+        {
+          sweep_stats_add(&stats, (f64)(tester.results.total.v[REPTEST_VALUE_TIME] - seen_total_time));
+          seen_test_count = tester.results.test_count;
+          seen_total_time = tester.results.total.v[REPTEST_VALUE_TIME];
+        }
+
+        if (testing)
+        {
+          entry->function(&tester, &params);
+        }
+      }
+
+      Repetition_Test_Values v = tester.results.min;
+      Operation_Counts counts = operation_counts(&params, entry->function);
+
+      cell.left_non_zero_count   = params.left.csr.non_zero_count;
+      cell.right_non_zero_count  = params.right.csr.non_zero_count;
+      cell.output_non_zero_count = output_non_zero_count(&params);
+      cell.time           = stats;
+      cell.flops          = v.v[REPTEST_VALUE_FLOP_COUNT];
+      cell.memops         = v.v[REPTEST_VALUE_MEMOP_COUNT];
+      cell.bytes          = v.v[REPTEST_VALUE_BYTE_COUNT];
+      cell.counted_flops  = counts.flops;
+      cell.counted_memops = counts.memops;
+      cell.counted_bytes  = counts.bytes;
+
+      sweep_results_write(&results, &cell);
+    }
+
+    arena_clear(arena);
+  }
+
+  sweep_results_close(&results);
+
+  LOG_INFO("Sweep done: %s", results_path);
+
+  return true;
+}
+
+int main(int arg_count, char **args)
+{
+  // Either a shape to fill with random operands, or a matrix file to multiply by itself
+  char *matrix_path = NULL;
+  if (arg_count >= 3 && (has_extension(args[2], ".mtx") || has_extension(args[2], SPARSE_FILE_EXTENSION)))
+  {
+    matrix_path = args[2];
+  }
+
+  if (arg_count < 5 && !matrix_path)
+  {
+    printf("Usage: %s [seconds_to_try_for_min] [row_count] [col_count] [inner_count] [verify/no-verify]\n", args[0]);
+    printf("       %s [seconds_to_try_for_min] [matrix.mtx/matrix.spmm] [verify/no-verify]\n", args[0]);
+    printf("       %s [seconds_to_try_for_min] sweep [config] [results.csv]\n", args[0]);
+    return -1;
+  }
+
+  Arena arena = arena_make(.reserve_size = GB(64));
+
+  u32 seconds_to_try_for_min = atoi(args[1]);
+  u64 cpu_timer_frequency = estimate_cpu_timer_freq();
+
+  spmm_set_tester_hooks((Spmm_Tester_Hooks){reptest_begin_time, reptest_close_time, reptest_count});
+
+  u32 row_count   = matrix_path ? 0 : atoi(args[2]);
+  u32 col_count   = matrix_path ? 0 : atoi(args[3]);
+  u32 inner_count = matrix_path ? 0 : atoi(args[4]);
+  int verify_arg  = matrix_path ? 3 : 5;
+
+#ifdef OBSERVE_PMU
+  // Before any pool, so the counters follow the workers too
+  if (!perf_counters_open(&perf_counters))
+  {
+    LOG_ERROR("No PMU counters available, check /proc/sys/kernel/perf_event_paranoid");
+  }
+#endif // OBSERVE_PMU
+
+  // Outlives the arena_clear()s below
+  Arena pool_arena = arena_make(.reserve_size = MB(1));
+  Thread_Pool *pool = thread_pool_make(&pool_arena, thread_hardware_count());
+
+  // Kernels with sparse output allocate into this, and clear it themselves
+  Arena output_arena = arena_make(.reserve_size = GB(16));
+
+  // A matrix file is the same operand every time it's loaded, only tuned the first
+  BCSR_Tune file_tune = {0};
+
+  LOG_INFO("Using %.*s kernels for the *_simd entries", STRF(simd_level_name(simd_level())));
+
+  // A whole grid of shapes instead of the one, see sweep.h
+  if (strcmp(args[2], "sweep") == 0)
+  {
+    return run_sweep(&arena, &output_arena, &pool_arena, args[3], args[4],
+                     seconds_to_try_for_min, cpu_timer_frequency) ? 0 : -1;
+  }
+
+  if (arg_count == verify_arg + 1)
+  {
+    if (strcmp(args[verify_arg], "verify") == 0)
+    {
+      // Arbitrary sparsity to check
+      Operation_Parameters params = {0};
+      if (!matrix_path)
+      {
+        BCSR_Tune tune = {0};
+        params = init_params(&arena, &output_arena, pool, row_count, col_count, inner_count, 0.4,
+                             RANDOM_OPERAND_SEED, &tune, cpu_timer_frequency);
+      }
+      else if (!load_params(&arena, &output_arena, pool, matrix_path, &params, &file_tune, cpu_timer_frequency))
+      {
+        return -1;
+      }
+
+      b32 had_failure = false;
+      Repetition_Tester dummy = {0};
+      // Just gonna take a copy of the dense dense to compare against
+      spmm_matmul_dense_dense(&dummy, &params);
+
+      usize count = params.output.row_count * params.output.col_count;
+      f64 *reference = arena_calloc(&arena, count, f64);
+      MEM_COPY(reference, params.output.values, sizeof(f64) * count);
+
+      // Sum of |left| * |right| for each output value, what the narrow entries' error scales with
+      f64 *magnitude = arena_calloc(&arena, count, f64);
+      {
+        CSR_Matrix left   = params.left.csr;
+        Dense_Matrix right = spmm_operand_dense(&params, &params.right);
+
+        for (usize row = 0; row < left.row_count; row++)
+        {
+          for (usize i = left.row_pointers[row]; i < left.row_pointers[row + 1]; i++)
+          {
+            f64 left_value = fabs(left.values[i]);
+            f64 *right_row = right.values + (usize)left.col_indices[i] * right.col_count;
+
+            for (usize col = 0; col < right.col_count; col++)
+            {
+              magnitude[row * right.col_count + col] += left_value * fabs(right_row[col]);
+            }
+          }
+        }
+      }
+
+      for (isize i = 1; i < STATIC_COUNT(test_entries); i++)
+      {
+        Operation_Entry *entry = test_entries + i;
+
+        // The BCSR entries only run the autotuned block shape, so try them with every shape here
+        b32 is_bcsr = entry->function == spmm_matmul_bcsr_dense || entry->function == spmm_matmul_bcsr_bcsr;
+        usize shape_count = is_bcsr ? BCSR_KERNEL_COUNT : 1;
+
+        Compact_Precision *precision = compact_precision(entry->function);
+        if (precision && precision->narrow_indices && !params.left.csr_u16.row_pointers)
+        {
+          LOG_INFO("Skipping '%.*s', too many columns for u16 indices", STRF(entry->name));
+          continue;
+        }
+
+        for (usize shape_idx = 0; shape_idx < shape_count; shape_idx++)
+        {
+          if (is_bcsr)
+          {
+            u32 block_rows = spmm_bcsr_kernels[shape_idx].block_rows;
+            u32 block_cols = spmm_bcsr_kernels[shape_idx].block_cols;
+            params.left.bcsr  = bcsr_from_csr(&arena, &params.left.csr, block_rows, block_cols);
+            params.right.bcsr = bcsr_from_csr(&arena, &params.right.csr, block_cols, block_cols);
+          }
+
+          MEM_SET(params.output.values, sizeof(f64) * params.output.row_count * params.output.col_count, 0);
+          params.sparse_output = (CSR_Matrix){0};
+          entry->function(&dummy, &params);
+
+          if (params.sparse_output.row_pointers)
+          {
+            Dense_Matrix expanded = dense_from_csr(&arena, &params.sparse_output);
+            MEM_COPY(params.output.values, expanded.values, sizeof(f64) * count);
+          }
+
+          for (isize v = 0; v < count; v++)
+          {
+            b32 matches = precision ? fabs(params.output.values[v] - reference[v]) <=
+                                      compact_error_bound(precision, params.left.csr.col_count, magnitude[v])
+                                    : epsilon_equal(params.output.values[v], reference[v]);
+            if (!matches)
+            {
+              LOG_ERROR("Entry '%.*s' (%ux%u blocks if BCSR) does not match reference (%f:%f)",
+                        STRF(entry->name), params.left.bcsr.block_rows, params.left.bcsr.block_cols,
+                        reference[v], params.output.values[v]);
+              had_failure = true;
+              break;
+            }
+          }
+        }
+      }
+
+      // Each operand's formats should be exact transposes of each other
+      Matrix_Reps *operands[] = {&params.left, &params.right};
+      for (usize operand_idx = 0; operand_idx < STATIC_COUNT(operands); operand_idx++)
+      {
+        Matrix_Reps *operand = operands[operand_idx];
+
+        CSR_Matrix csr = csr_from_csc(&arena, pool, &operand->csc);
+        CSC_Matrix csc = csc_from_csr(&arena, pool, &operand->csr);
+
+        if (!compressed_equal(csr.row_count, csr.non_zero_count,
+                              csr.row_pointers, csr.col_indices, csr.values,
+                              operand->csr.row_pointers, operand->csr.col_indices, operand->csr.values) ||
+            !compressed_equal(csc.col_count, csc.non_zero_count,
+                              csc.col_pointers, csc.row_indices, csc.values,
+                              operand->csc.col_pointers, operand->csc.row_indices, operand->csc.values))
+        {
+          LOG_ERROR("Transposes of the %s operand don't match its other format", operand_idx ? "right" : "left");
+          had_failure = true;
+        }
+      }
+
+      // The fixed width kernels, every width that has one and 3 for the fallback, against one plain
+      // call. The operands above are rarely that narrow
+      {
+        Operation_Entry width_entries[] =
+        {
+          {STR("csr_X_dense_simd"),  spmm_matmul_csr_dense_simd},
+          {STR("csc_X_dense_simd"),  spmm_matmul_csc_dense_simd},
+          {STR("csr_X_dense_tiled"), spmm_matmul_csr_dense_tiled},
+          {STR("csc_X_dense_tiled"), spmm_matmul_csc_dense_tiled},
+        };
+        u32 widths[] = {1, 2, 3, 4, 8, 16};
+
+        Random_Series series = random_seed(RANDOM_OPERAND_SEED, 1);
+
+        for (usize width_idx = 0; width_idx < STATIC_COUNT(widths) && !had_failure; width_idx++)
+        {
+          u32 width = widths[width_idx];
+          usize right_count  = (usize)params.left.csr.col_count * width;
+          usize output_count = (usize)params.left.csr.row_count * width;
+
+          Dense_Matrix right = {params.left.csr.col_count, width, arena_calloc(&arena, MAX(right_count, 1), f64)};
+          for (usize v = 0; v < right_count; v++)
+          {
+            right.values[v] = 2.0 * random_unit(&series) - 1.0;
+          }
+
+          Operation_Parameters width_params =
+          {
+            .left   = {.csr = params.left.csr, .csc = params.left.csc},
+            .right  = {.dense = right},
+            .output = {params.left.csr.row_count, width, arena_calloc(&arena, MAX(output_count, 1), f64)},
+          };
+          spmm_matmul_csr_dense(&dummy, &width_params);
+
+          f64 *width_reference = arena_calloc(&arena, MAX(output_count, 1), f64);
+          MEM_COPY(width_reference, width_params.output.values, sizeof(f64) * output_count);
+
+          for (usize entry_idx = 0; entry_idx < STATIC_COUNT(width_entries); entry_idx++)
+          {
+            Operation_Entry *entry = width_entries + entry_idx;
+
+            MEM_SET(width_params.output.values, sizeof(f64) * output_count, 0);
+            entry->function(&dummy, &width_params);
+
+            for (usize v = 0; v < output_count; v++)
+            {
+              if (!epsilon_equal(width_params.output.values[v], width_reference[v]))
+              {
+                LOG_ERROR("Entry '%.*s' at width %u does not match reference (%f:%f)", STRF(entry->name), width,
+                          width_reference[v], width_params.output.values[v]);
+                had_failure = true;
+                break;
+              }
+            }
+          }
+        }
+      }
+
+      // Batched against one plain call per pair
+      {
+        Spmm_Batch batch = make_random_batch(&arena, pool, 256, RANDOM_OPERAND_SEED);
+        Spmm_Batch_Plan plan = spmm_batch_plan(&arena, &batch, pool->worker_count + 1);
+        spmm_batch_execute(pool, &batch, &plan);
+
+        for (u32 i = 0; i < batch.count && !had_failure; i++)
+        {
+          Dense_Matrix batched = batch.outputs[i];
+          usize pair_count = (usize)batched.row_count * batched.col_count;
+
+          Operation_Parameters pair_params =
+          {
+            .left   = {.csr = batch.lefts[i]},
+            .right  = {.dense = batch.rights[i]},
+            .output = {batched.row_count, batched.col_count, arena_calloc(&arena, MAX(pair_count, 1), f64)},
+          };
+          spmm_matmul_csr_dense(&dummy, &pair_params);
+
+          for (usize v = 0; v < pair_count; v++)
+          {
+            if (!epsilon_equal(batched.values[v], pair_params.output.values[v]))
+            {
+              LOG_ERROR("Batched pair %u does not match reference (%f:%f)", i,
+                        pair_params.output.values[v], batched.values[v]);
+              had_failure = true;
+              break;
+            }
+          }
+        }
+      }
+
+      arena_clear(&arena);
+
+      if (!had_failure)
+      {
+        LOG_INFO("All entries match reference");
+      }
+    }
+  }
+
+  // Roofline. The auto cost model stays on one thread streaming from DRAM at 256 bits, which is
+  // what the SIMD kernels do
+  Roofline_Results roofline = {0};
+  if (roofline_read_csv(&roofline, ROOFLINE_CACHE_PATH))
+  {
+    LOG_INFO("Roofline from %s, delete it to measure again", ROOFLINE_CACHE_PATH);
+  }
+  else
+  {
+    roofline = roofline_measure(pool, cpu_timer_frequency, seconds_to_try_for_min);
+
+    mkdir("data/", 0755);
+    if (!roofline_write_csv(&roofline, ROOFLINE_CACHE_PATH))
+    {
+      LOG_ERROR("Unable to open roofline file: %s", ROOFLINE_CACHE_PATH);
+    }
+  }
+
+  {
+    // Whichever wasn't measured stays at the dev machine's
+    spmm_set_ceilings(roofline.threaded_flops_256[0], roofline.bandwidth[ROOFLINE_DRAM][ROOFLINE_WIDTH_256]);
+  }
+
+  // Text vs binary startup, the binary gets written next to the .mtx the first time through
+  if (matrix_path)
+  {
+    b32 from_text = has_extension(matrix_path, ".mtx");
+
+    char binary_path[4096];
+    int stem_length = (int)(strlen(matrix_path) - (from_text ? strlen(".mtx") : 0));
+    snprintf(binary_path, sizeof(binary_path), "%.*s%s",
+             stem_length, matrix_path, from_text ? SPARSE_FILE_EXTENSION : "");
+
+    if (from_text)
+    {
+      struct stat binary_stat = {0};
+      if (stat(binary_path, &binary_stat) != 0)
+      {
+        CSR_Matrix csr = {0};
+        CSC_Matrix csc = {0};
+        if (matrix_market_load(&arena, pool, matrix_path, &csr, &csc) && sparse_file_write(binary_path, &csr, &csc))
+        {
+          LOG_INFO("Wrote binary copy: %s", binary_path);
+        }
+        arena_clear(&arena);
+      }
+    }
+
+    u64 text_time = 0;
+    if (from_text)
+    {
+      Repetition_Tester text_tester = {0};
+      repetition_tester_new_wave(&text_tester, 0, cpu_timer_frequency, seconds_to_try_for_min);
+
+      printf("\n--- Load matrix market text ---\n");
+      printf("                                                          \r");
+      while (repetition_tester_is_testing(&text_tester))
+      {
+        load_matrix_market_text(&text_tester, &arena, pool, matrix_path);
+      }
+      arena_clear(&arena);
+
+      text_time = text_tester.results.min.v[REPTEST_VALUE_TIME];
+      printf("Text load: %f ms\n", 1000.0 * text_time / cpu_timer_frequency);
+    }
+
+    Repetition_Tester binary_tester = {0};
+    repetition_tester_new_wave(&binary_tester, 0, cpu_timer_frequency, seconds_to_try_for_min);
+
+    printf("\n--- Map binary ---\n");
+    printf("                                                          \r");
+    while (repetition_tester_is_testing(&binary_tester))
+    {
+      load_sparse_file_binary(&binary_tester, binary_path);
+    }
+
+    u64 binary_time = binary_tester.results.min.v[REPTEST_VALUE_TIME];
+    printf("Binary map: %f ms", 1000.0 * binary_time / cpu_timer_frequency);
+    if (text_time && binary_time)
+    {
+      printf(" (%.1fx faster than text)", (f64)text_time / binary_time);
+    }
+    printf("\n");
+  }
+
+  // Packed single block CSR against the three separate allocations it replaced, same kernels on
+  // the same operands. Only telling on operands well past the LLC and the TLB's reach
+  {
+    Operation_Parameters params = {0};
+    if (!matrix_path)
+    {
+      BCSR_Tune tune = {0};
+      params = init_params(&arena, &output_arena, pool, row_count, col_count, inner_count, 0.1,
+                           RANDOM_OPERAND_SEED, &tune, cpu_timer_frequency);
+    }
+    else if (!load_params(&arena, &output_arena, pool, matrix_path, &params, &file_tune, cpu_timer_frequency))
+    {
+      return -1;
+    }
+
+    Matrix_Reps left  = params.left;
+    Matrix_Reps right = params.right;
+
+    struct
+    {
+      char *name;
+      CSR_Matrix (*copy)(Arena *, CSR_Matrix *);
+    } layouts[] =
+    {
+      {"separate", csr_copy_separate},
+      {"packed",   csr_copy},
+    };
+
+    Operation_Entry layout_entries[] =
+    {
+      {STR("csr_X_dense"),      spmm_matmul_csr_dense},
+      {STR("csr_X_csr_sparse"), spmm_matmul_csr_csr_sparse},
+    };
+
+    for (usize layout_idx = 0; layout_idx < STATIC_COUNT(layouts); layout_idx++)
+    {
+      params.left.csr  = layouts[layout_idx].copy(&arena, &left.csr);
+      params.right.csr = layouts[layout_idx].copy(&arena, &right.csr);
+
+      for (usize func_idx = 0; func_idx < STATIC_COUNT(layout_entries); func_idx++)
+      {
+        Repetition_Tester tester = {0};
+        Operation_Entry *entry = layout_entries + func_idx;
+
+        printf("\n--- %.*s, %s layout ---\n", STRF(entry->name), layouts[layout_idx].name);
+        printf("                                                          \r");
+        repetition_tester_new_wave(&tester, 0, cpu_timer_frequency, seconds_to_try_for_min);
+
+        params.sparse_output = (CSR_Matrix){0};
+        while (repetition_tester_is_testing(&tester))
+        {
+          entry->function(&tester, &params);
+        }
+
+        u64 time = tester.results.min.v[REPTEST_VALUE_TIME];
+        printf("%.*s, %s layout: %f ms, %f ns per left non zero\n", STRF(entry->name), layouts[layout_idx].name,
+               1000.0 * time / cpu_timer_frequency,
+               1e9 * time / cpu_timer_frequency / MAX(params.left.csr.non_zero_count, 1));
+      }
+    }
+
+    arena_clear(&arena);
+  }
+
+  // Thousands of small pairs, one call each against the batched entry point. Same packed batch
+  // for all of them, so it's only the calls and the scheduling that differ. The per matrix calls
+  // are one thread, so the batch runs on one first to compare against those, then on the pool
+  {
+    Spmm_Batch batch = make_random_batch(&arena, pool, 4096, RANDOM_OPERAND_SEED);
+
+    Operation_Entry per_matrix_entries[] =
+    {
+      {STR("csr_X_dense"),      spmm_matmul_csr_dense},
+      {STR("csr_X_dense_simd"), spmm_matmul_csr_dense_simd},
+    };
+
+    u64 non_zero_count = 0;
+    for (u32 i = 0; i < batch.count; i++)
+    {
+      non_zero_count += batch.lefts[i].non_zero_count;
+    }
+
+    u64 per_matrix_times[STATIC_COUNT(per_matrix_entries)] = {0};
+    for (usize func_idx = 0; func_idx < STATIC_COUNT(per_matrix_entries); func_idx++)
+    {
+      Repetition_Tester tester = {0};
+      Operation_Entry *entry = per_matrix_entries + func_idx;
+
+      printf("\n--- %.*s per matrix, %u pairs ---\n", STRF(entry->name), batch.count);
+      printf("                                                          \r");
+      repetition_tester_new_wave(&tester, 0, cpu_timer_frequency, seconds_to_try_for_min);
+
+      while (repetition_tester_is_testing(&tester))
+      {
+        spmm_batch_per_matrix(&tester, &batch, entry);
+      }
+
+      per_matrix_times[func_idx] = tester.results.min.v[REPTEST_VALUE_TIME];
+    }
+
+    // Outlives the arena_clear(), like the main pool
+    Thread_Pool *batch_pools[] = {thread_pool_make(&pool_arena, 1), pool};
+    usize batch_pool_count = pool->worker_count ? 2 : 1;
+
+    u64 batched_times[STATIC_COUNT(batch_pools)] = {0};
+    for (usize pool_idx = 0; pool_idx < batch_pool_count; pool_idx++)
+    {
+      Thread_Pool *batch_pool = batch_pools[pool_idx];
+      Spmm_Batch_Plan plan = spmm_batch_plan(&arena, &batch, batch_pool->worker_count + 1);
+
+      Repetition_Tester tester = {0};
+
+      printf("\n--- Batched, %u pairs in %u groups, %u threads ---\n", batch.count, plan.group_count,
+             batch_pool->worker_count + 1);
+      printf("                                                          \r");
+      repetition_tester_new_wave(&tester, 0, cpu_timer_frequency, seconds_to_try_for_min);
+
+      while (repetition_tester_is_testing(&tester))
+      {
+        repetition_tester_begin_time(&tester);
+
+        spmm_batch_execute(batch_pool, &batch, &plan);
+
+        repetition_tester_close_time(&tester);
+      }
+
+      batched_times[pool_idx] = tester.results.min.v[REPTEST_VALUE_TIME];
+    }
+
+    for (usize func_idx = 0; func_idx < STATIC_COUNT(per_matrix_entries); func_idx++)
+    {
+      u64 time = per_matrix_times[func_idx];
+      printf("%.*s per matrix: %f ms, %f ns per left non zero\n", STRF(per_matrix_entries[func_idx].name),
+             1000.0 * time / cpu_timer_frequency, 1e9 * time / cpu_timer_frequency / MAX(non_zero_count, 1));
+    }
+    for (usize pool_idx = 0; pool_idx < batch_pool_count; pool_idx++)
+    {
+      u64 time = batched_times[pool_idx];
+      printf("Batched, %u threads: %f ms, %f ns per left non zero", batch_pools[pool_idx]->worker_count + 1,
+             1000.0 * time / cpu_timer_frequency, 1e9 * time / cpu_timer_frequency / MAX(non_zero_count, 1));
+
+      // Batching and grouping alone against the same one thread, then what the threads add on top
+      if (time && pool_idx == 0)
+      {
+        printf(" (%.1fx faster than csr_X_dense_simd per matrix)", (f64)per_matrix_times[1] / time);
+      }
+      else if (time)
+      {
+        printf(" (%.1fx faster than batched on 1 thread)", (f64)batched_times[0] / time);
+      }
+      printf("\n");
+    }
+
+    arena_clear(&arena);
   }
 
 #if 1
   f64 densities[] =
   {
+    0.00001, 0.0001, 0.001, // Hypersparse, where the pointer arrays outweigh the non zeros
     0.01, 0.02, 0.03, 0.04, 0.05, 0.06, 0.07, 0.08, 0.09,
     0.1,  0.2,  0.3,  0.4,  0.5,  0.6,  0.7,  0.8,  0.9,
   };
@@ -580,17 +2203,54 @@ int main(int arg_count, char **args)
   };
 #endif
 
+  // A file only has the one density
+  usize density_count = matrix_path ? 1 : STATIC_COUNT(densities);
+
   Repetition_Tester testers[STATIC_COUNT(test_entries)][STATIC_COUNT(densities)] = {0};
 
   u32 non_zero_counts[STATIC_COUNT(densities)][2] = {0};
+  u64 output_non_zero_counts[STATIC_COUNT(test_entries)][STATIC_COUNT(densities)] = {0};
+  Operation_Counts counted[STATIC_COUNT(test_entries)][STATIC_COUNT(densities)] = {0};
+
+  // Cost model estimate for the kernels that are auto candidates, to hold the counts up against
+  Spmm_Cost modeled[STATIC_COUNT(test_entries)][STATIC_COUNT(densities)] = {0};
+  b32       has_model[STATIC_COUNT(test_entries)] = {0};
+
+  // Of the minimum time repetition, same as the tester's results.min
+  Perf_Counter_Values min_perf_counts[STATIC_COUNT(test_entries)][STATIC_COUNT(densities)] = {0};
+
+  Repetition_Tester conversion_testers[STATIC_COUNT(conversion_entries)][STATIC_COUNT(densities)] = {0};
+
+  // What spmm_auto would pick if every format were already built, which is what the kernels are
+  // timed with, and if the operands only came as CSR
+  usize auto_choices[STATIC_COUNT(densities)]     = {0};
+  usize auto_csr_choices[STATIC_COUNT(densities)] = {0};
+  f64   auto_estimates[STATIC_COUNT(densities)]   = {0};
 
-  for (usize density_idx = 0; density_idx < STATIC_COUNT(densities); density_idx++)
+  for (usize density_idx = 0; density_idx < density_count; density_idx++)
   {
-    // FIXME: So SLOW! But don't know of a better way to test a bunch of densities of different
-    // matrix sizes
-    Operation_Parameters params = init_params(&arena,
-                                              row_count, col_count, inner_count,
-                                              densities[density_idx]);
+    Operation_Parameters params = {0};
+    if (!matrix_path)
+    {
+      // A new operand every density, so each is tuned for itself
+      BCSR_Tune tune = {0};
+      params = init_params(&arena, &output_arena, pool,
+                           row_count, col_count, inner_count,
+                           densities[density_idx], RANDOM_OPERAND_SEED + density_idx,
+                           &tune, cpu_timer_frequency);
+    }
+    else
+    {
+      if (!load_params(&arena, &output_arena, pool, matrix_path, &params, &file_tune, cpu_timer_frequency))
+      {
+        return -1;
+      }
+
+      row_count   = params.left.csr.row_count;
+      inner_count = params.left.csr.col_count;
+      col_count   = params.right.csr.col_count;
+      densities[density_idx] = (f64)params.left.csr.non_zero_count / ((f64)row_count * inner_count);
+    }
 
     // NOTE: Should be the same across all formats, so just look at csr
     non_zero_counts[density_idx][0] = params.left.csr.non_zero_count;
@@ -598,12 +2258,65 @@ int main(int arg_count, char **args)
 
     f64 density = densities[density_idx];
 
+    auto_choices[density_idx]     = spmm_auto_choose(&params, ~0u, ~0u, &auto_estimates[density_idx]);
+    auto_csr_choices[density_idx] = spmm_auto_choose(&params, FORMAT_BIT(MAT_CSR), FORMAT_BIT(MAT_CSR), NULL);
+
     for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
     {
       Repetition_Tester *tester = &testers[func_idx][density_idx];
       Operation_Entry *entry = test_entries + func_idx;
 
-      printf("\n--- %.*s @ %.4f density ---\n", STRF(entry->name), density);
+      printf("\n--- %.*s @ %g density ---\n", STRF(entry->name), density);
+      printf("                                                          \r");
+      repetition_tester_new_wave(tester, 0, cpu_timer_frequency, seconds_to_try_for_min);
+
+      params.sparse_output = (CSR_Matrix){0};
+
+      // is_testing() is what folds the last repetition into the results, so the counts read
+      // after a call belong to the new min if the min moved by the next check
+      u64 min_time = tester->results.min.v[REPTEST_VALUE_TIME];
+      Perf_Counter_Values last_perf_counts = {0};
+      b32 testing = true;
+      while (testing)
+      {
+        testing = repetition_tester_is_testing(tester);
+
+        if (tester->results.min.v[REPTEST_VALUE_TIME] != min_time)
+        {
+          min_time = tester->results.min.v[REPTEST_VALUE_TIME];
+          min_perf_counts[func_idx][density_idx] = last_perf_counts;
+        }
+
+        if (testing)
+        {
+          perf_counters_reset(&perf_counters);
+          entry->function(tester, &params);
+          last_perf_counts = perf_counters_read(&perf_counters);
+        }
+      }
+
+      output_non_zero_counts[func_idx][density_idx] = output_non_zero_count(&params);
+
+      // After the runs, numeric's count needs the plan they built
+      counted[func_idx][density_idx] = operation_counts(&params, entry->function);
+
+      Spmm_Shape shape = spmm_shape_from(&params);
+      for (usize candidate_idx = 0; candidate_idx < AUTO_CANDIDATE_COUNT; candidate_idx++)
+      {
+        if (spmm_auto_candidates[candidate_idx].function == entry->function)
+        {
+          modeled[func_idx][density_idx] = spmm_auto_candidates[candidate_idx].cost(&shape);
+          has_model[func_idx] = true;
+        }
+      }
+    }
+
+    for (usize conversion_idx = 0; conversion_idx < STATIC_COUNT(conversion_entries); conversion_idx++)
+    {
+      Repetition_Tester *tester = &conversion_testers[conversion_idx][density_idx];
+      Operation_Entry *entry = conversion_entries + conversion_idx;
+
+      printf("\n--- %.*s @ %g density ---\n", STRF(entry->name), density);
       printf("                                                          \r");
       repetition_tester_new_wave(tester, 0, cpu_timer_frequency, seconds_to_try_for_min);
 
@@ -616,6 +2329,380 @@ int main(int arg_count, char **args)
     arena_clear(&arena); // Reset any memory taken by params
   }
 
+  // How many times a plan has to be reused before symbolic + n numerics beats n full products
+  {
+    usize sparse_idx = 0, symbolic_idx = 0, numeric_idx = 0;
+    for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+    {
+      if (test_entries[func_idx].function == spmm_matmul_csr_csr_sparse)   sparse_idx   = func_idx;
+      if (test_entries[func_idx].function == spmm_matmul_csr_csr_symbolic) symbolic_idx = func_idx;
+      if (test_entries[func_idx].function == spmm_matmul_csr_csr_numeric)  numeric_idx  = func_idx;
+    }
+
+    printf("\n--- SpGEMM plan payback ---\n");
+    for (usize density_idx = 0; density_idx < density_count; density_idx++)
+    {
+      u64 sparse   = testers[sparse_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+      u64 symbolic = testers[symbolic_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+      u64 numeric  = testers[numeric_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+
+      printf("%g density: symbolic %lu, numeric %lu, full product %lu",
+             densities[density_idx], symbolic, numeric, sparse);
+
+      if (sparse > numeric)
+      {
+        printf(" -> pays back after %.1f reuses\n", (f64)symbolic / (f64)(sparse - numeric));
+      }
+      else
+      {
+        printf(" -> numeric is no faster, never pays back\n");
+      }
+    }
+  }
+
+  // Fastest single core sparse kernel against the blocked GEMM, and the density it stops winning at
+  {
+    usize blocked_idx = 0;
+    for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+    {
+      if (test_entries[func_idx].function == spmm_matmul_dense_dense_blocked) blocked_idx = func_idx;
+    }
+
+    f64 crossover = -1.0;
+
+    printf("\n--- Sparse vs blocked GEMM ---\n");
+    for (usize density_idx = 0; density_idx < density_count; density_idx++)
+    {
+      usize sparse_idx = 0;
+      u64 sparse = 0;
+      for (usize candidate_idx = 0; candidate_idx < AUTO_CANDIDATE_COUNT; candidate_idx++)
+      {
+        Auto_Candidate *candidate = &spmm_auto_candidates[candidate_idx];
+        if (candidate->left == MAT_DENSE && candidate->right == MAT_DENSE)
+        {
+          continue;
+        }
+
+        for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+        {
+          u64 time = testers[func_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+          if (test_entries[func_idx].function == candidate->function && (!sparse || time < sparse))
+          {
+            sparse_idx = func_idx;
+            sparse     = time;
+          }
+        }
+      }
+
+      u64 blocked = testers[blocked_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+
+      printf("%g density: %.*s %lu vs blocked GEMM %lu -> %s\n", densities[density_idx],
+             STRF(test_entries[sparse_idx].name), sparse, blocked, sparse <= blocked ? "sparse" : "dense");
+
+      if (crossover < 0.0 && blocked < sparse)
+      {
+        crossover = densities[density_idx];
+      }
+    }
+
+    if (crossover >= 0.0)
+    {
+      printf("Sparse stops winning at %g density\n", crossover);
+    }
+    else
+    {
+      printf("Sparse wins at every density\n");
+    }
+  }
+
+  // Adaptive intersection against the plain merge it replaces
+  {
+    usize merge_idx = 0, adaptive_idx = 0;
+    for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+    {
+      if (test_entries[func_idx].function == spmm_matmul_csr_csc)          merge_idx    = func_idx;
+      if (test_entries[func_idx].function == spmm_matmul_csr_csc_adaptive) adaptive_idx = func_idx;
+    }
+
+    printf("\n--- CSR X CSC intersection ---\n");
+    for (usize density_idx = 0; density_idx < density_count; density_idx++)
+    {
+      u64 merge    = testers[merge_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+      u64 adaptive = testers[adaptive_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+
+      printf("%g density: merge %lu, adaptive %lu (%.2fx)\n", densities[density_idx],
+             merge, adaptive, (f64)merge / MAX(adaptive, 1));
+    }
+  }
+
+  // Whether SELL's padding buys back enough from vectorizing across rows, at the sparse end
+  {
+    usize sell_idx = 0, csr_idx = 0, csr_simd_idx = 0;
+    for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+    {
+      if (test_entries[func_idx].function == spmm_matmul_sell_dense)     sell_idx     = func_idx;
+      if (test_entries[func_idx].function == spmm_matmul_csr_dense)      csr_idx      = func_idx;
+      if (test_entries[func_idx].function == spmm_matmul_csr_dense_simd) csr_simd_idx = func_idx;
+    }
+
+    printf("\n--- SELL vs CSR ---\n");
+    for (usize density_idx = 0; density_idx < density_count; density_idx++)
+    {
+      if (densities[density_idx] > 0.1)
+      {
+        continue;
+      }
+
+      u64 sell     = testers[sell_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+      u64 csr      = testers[csr_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+      u64 csr_simd = testers[csr_simd_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+
+      printf("%g density: sell %lu, csr %lu (%.2fx), csr simd %lu (%.2fx)\n", densities[density_idx],
+             sell, csr, (f64)csr / MAX(sell, 1), csr_simd, (f64)csr_simd / MAX(sell, 1));
+    }
+  }
+
+  // What narrower values and indices buy over the f64/u32 csr_X_dense, same loop throughout
+  {
+    usize csr_idx = 0;
+    for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+    {
+      if (test_entries[func_idx].function == spmm_matmul_csr_dense) csr_idx = func_idx;
+    }
+
+    printf("\n--- Narrow storage vs csr_X_dense ---\n");
+    for (usize density_idx = 0; density_idx < density_count; density_idx++)
+    {
+      u64 csr = testers[csr_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+
+      printf("%g density:", densities[density_idx]);
+      for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+      {
+        if (compact_precision(test_entries[func_idx].function))
+        {
+          u64 compact = testers[func_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+          printf(" %.*s %.2fx,", STRF(test_entries[func_idx].name), (f64)csr / MAX(compact, 1));
+        }
+      }
+      printf("\n");
+    }
+  }
+
+  // Converting the right operand once and running the same format kernel, versus the mixed one
+  {
+    struct
+    {
+      void (*mixed)(Repetition_Tester *, Operation_Parameters *);
+      void (*conversion)(Repetition_Tester *, Operation_Parameters *);
+      void (*converted)(Repetition_Tester *, Operation_Parameters *);
+    } choices[] =
+    {
+      {spmm_matmul_csr_csc, convert_csc_to_csr, spmm_matmul_csr_csr},
+      {spmm_matmul_csc_csr, convert_csr_to_csc, spmm_matmul_csc_csc},
+    };
+
+    printf("\n--- Convert or mix ---\n");
+    for (usize choice_idx = 0; choice_idx < STATIC_COUNT(choices); choice_idx++)
+    {
+      usize mixed_idx = 0, conversion_idx = 0, converted_idx = 0;
+      for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+      {
+        if (test_entries[func_idx].function == choices[choice_idx].mixed)     mixed_idx     = func_idx;
+        if (test_entries[func_idx].function == choices[choice_idx].converted) converted_idx = func_idx;
+      }
+      for (usize func_idx = 0; func_idx < STATIC_COUNT(conversion_entries); func_idx++)
+      {
+        if (conversion_entries[func_idx].function == choices[choice_idx].conversion) conversion_idx = func_idx;
+      }
+
+      for (usize density_idx = 0; density_idx < density_count; density_idx++)
+      {
+        u64 mixed      = testers[mixed_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+        u64 conversion = conversion_testers[conversion_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+        u64 converted  = testers[converted_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+
+        printf("%g density: %.*s %lu vs %.*s %lu + %.*s %lu -> %s\n", densities[density_idx],
+               STRF(test_entries[mixed_idx].name), mixed,
+               STRF(conversion_entries[conversion_idx].name), conversion,
+               STRF(test_entries[converted_idx].name), converted,
+               conversion + converted < mixed ? "convert" : "mix");
+      }
+    }
+  }
+
+  // Multiplies it takes for a reordering to pay for itself, when the reordered kernel wins at all
+  {
+    struct
+    {
+      void (*plain)(Repetition_Tester *, Operation_Parameters *);
+      void (*reorder)(Repetition_Tester *, Operation_Parameters *);
+      void (*reordered)(Repetition_Tester *, Operation_Parameters *);
+    } choices[] =
+    {
+      {spmm_matmul_csr_dense, convert_reorder_rcm,     spmm_matmul_csr_dense_rcm},
+      {spmm_matmul_csr_dense, convert_reorder_degree,  spmm_matmul_csr_dense_degree},
+      {spmm_matmul_csr_dense, convert_reorder_cluster, spmm_matmul_csr_dense_cluster},
+      {spmm_matmul_csr_csr,   convert_reorder_rcm,     spmm_matmul_csr_csr_rcm},
+      {spmm_matmul_csr_csr,   convert_reorder_degree,  spmm_matmul_csr_csr_degree},
+      {spmm_matmul_csr_csr,   convert_reorder_cluster, spmm_matmul_csr_csr_cluster},
+    };
+
+    printf("\n--- Reordering payback ---\n");
+    for (usize choice_idx = 0; choice_idx < STATIC_COUNT(choices); choice_idx++)
+    {
+      usize plain_idx = 0, reorder_idx = 0, reordered_idx = 0;
+      for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+      {
+        if (test_entries[func_idx].function == choices[choice_idx].plain)     plain_idx     = func_idx;
+        if (test_entries[func_idx].function == choices[choice_idx].reordered) reordered_idx = func_idx;
+      }
+      for (usize func_idx = 0; func_idx < STATIC_COUNT(conversion_entries); func_idx++)
+      {
+        if (conversion_entries[func_idx].function == choices[choice_idx].reorder) reorder_idx = func_idx;
+      }
+
+      for (usize density_idx = 0; density_idx < density_count; density_idx++)
+      {
+        u64 plain     = testers[plain_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+        u64 reorder   = conversion_testers[reorder_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+        u64 reordered = testers[reordered_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+
+        printf("%g density: %.*s %lu vs %.*s %lu + %.*s %lu -> ", densities[density_idx],
+               STRF(test_entries[plain_idx].name), plain,
+               STRF(conversion_entries[reorder_idx].name), reorder,
+               STRF(test_entries[reordered_idx].name), reordered);
+
+        if (reordered < plain)
+        {
+          printf("pays back after %lu multiplies\n", (reorder + (plain - reordered) - 1) / (plain - reordered));
+        }
+        else
+        {
+          printf("never pays back\n");
+        }
+      }
+    }
+  }
+
+  // How often the cost model's pick is the one that measured fastest, and how much slower when not
+  {
+    usize candidate_entries[AUTO_CANDIDATE_COUNT] = {0};
+    for (usize candidate_idx = 0; candidate_idx < AUTO_CANDIDATE_COUNT; candidate_idx++)
+    {
+      for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+      {
+        if (test_entries[func_idx].function == spmm_auto_candidates[candidate_idx].function)
+        {
+          candidate_entries[candidate_idx] = func_idx;
+        }
+      }
+    }
+
+    usize match_count = 0, close_count = 0;
+
+    printf("\n--- Auto vs measured ---\n");
+    for (usize density_idx = 0; density_idx < density_count; density_idx++)
+    {
+      usize fastest_idx = candidate_entries[0];
+      for (usize candidate_idx = 1; candidate_idx < AUTO_CANDIDATE_COUNT; candidate_idx++)
+      {
+        usize func_idx = candidate_entries[candidate_idx];
+        if (testers[func_idx][density_idx].results.min.v[REPTEST_VALUE_TIME] <
+            testers[fastest_idx][density_idx].results.min.v[REPTEST_VALUE_TIME])
+        {
+          fastest_idx = func_idx;
+        }
+      }
+
+      usize chosen_idx     = candidate_entries[auto_choices[density_idx]];
+      usize csr_chosen_idx = candidate_entries[auto_csr_choices[density_idx]];
+
+      u64 chosen  = testers[chosen_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+      u64 fastest = testers[fastest_idx][density_idx].results.min.v[REPTEST_VALUE_TIME];
+
+      match_count += chosen_idx == fastest_idx;
+      close_count += (f64)chosen <= 1.1 * (f64)fastest;
+
+      printf("%g density: picked %.*s (estimate %.0f, took %lu), fastest %.*s %lu -> %s %.2fx; from CSR picks %.*s\n",
+             densities[density_idx],
+             STRF(test_entries[chosen_idx].name), auto_estimates[density_idx], chosen,
+             STRF(test_entries[fastest_idx].name), fastest,
+             chosen_idx == fastest_idx ? "match" : "miss", (f64)chosen / MAX(fastest, 1),
+             STRF(test_entries[csr_chosen_idx].name));
+    }
+
+    printf("Picked the fastest at %lu of %lu densities, within 10%% at %lu\n",
+           match_count, density_count, close_count);
+  }
+
+#if defined(OBSERVE_FLOPS) || defined(OBSERVE_MEMOPS)
+  // The counting pass has to agree exactly with what the kernels observed, anything else is a
+  // bug in one or the other
+  {
+    usize match_count = 0, total_count = 0;
+
+    printf("\n--- Counted vs observed ---\n");
+    for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+    {
+      for (usize density_idx = 0; density_idx < density_count; density_idx++)
+      {
+        Repetition_Test_Values v = testers[func_idx][density_idx].results.min;
+        Operation_Counts *c = &counted[func_idx][density_idx];
+
+        b32 match = true;
+#ifdef OBSERVE_FLOPS
+        match = match && c->flops == v.v[REPTEST_VALUE_FLOP_COUNT];
+#endif
+#ifdef OBSERVE_MEMOPS
+        match = match && c->memops == v.v[REPTEST_VALUE_MEMOP_COUNT] && c->bytes == v.v[REPTEST_VALUE_BYTE_COUNT];
+#endif
+
+        if (!match)
+        {
+          printf("%.*s @ %g density: counted %lu flops %lu memops %lu bytes, observed %lu %lu %lu\n",
+                 STRF(test_entries[func_idx].name), densities[density_idx],
+                 c->flops, c->memops, c->bytes,
+                 v.v[REPTEST_VALUE_FLOP_COUNT], v.v[REPTEST_VALUE_MEMOP_COUNT], v.v[REPTEST_VALUE_BYTE_COUNT]);
+        }
+
+        match_count += match;
+        total_count += 1;
+      }
+    }
+
+    printf("%lu of %lu match\n", match_count, total_count);
+  }
+#endif
+
+  // How far the auto cost model, the same closed forms as table.md and plot.py, strays from the
+  // exact counts. Off mostly where the product count isn't uniform
+  {
+    printf("\n--- Cost model vs counted ---\n");
+    for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
+    {
+      if (!has_model[func_idx])
+      {
+        continue;
+      }
+
+      f64 worst_flops = 1.0, worst_bytes = 1.0;
+      for (usize density_idx = 0; density_idx < density_count; density_idx++)
+      {
+        Operation_Counts *c = &counted[func_idx][density_idx];
+        Spmm_Cost *m = &modeled[func_idx][density_idx];
+
+        f64 flops = c->flops ? m->flops / (f64)c->flops : 1.0;
+        f64 bytes = c->bytes ? m->bytes / (f64)c->bytes : 1.0;
+
+        if (fabs(log(flops)) > fabs(log(worst_flops))) worst_flops = flops;
+        if (fabs(log(bytes)) > fabs(log(worst_bytes))) worst_bytes = bytes;
+      }
+
+      printf("%-*.*s worst model / counted: flops %.3fx, bytes %.3fx\n",
+             24, STRF(test_entries[func_idx].name), worst_flops, worst_bytes);
+    }
+  }
+
   // Dump csv
   for (usize func_idx = 0; func_idx < STATIC_COUNT(test_entries); func_idx++)
   {
@@ -635,9 +2722,14 @@ int main(int arg_count, char **args)
     if (csv)
     {
       LOG_INFO("Dumping csv: %.*s", STRF(filename));
-      fprintf(csv, "row_count,col_count,inner_count,left_non_zero_count,right_non_zero_count,density,flops,memops,time,bytes\n");
+      fprintf(csv, "row_count,col_count,inner_count,left_non_zero_count,right_non_zero_count,density,flops,memops,time,bytes,output_non_zero_count,bytes_per_flop,counted_flops,counted_memops,counted_bytes");
+      for (usize counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+      {
+        fprintf(csv, ",%s", perf_counter_names[counter]);
+      }
+      fprintf(csv, "\n");
 
-      for (usize density_idx = 0; density_idx < STATIC_COUNT(densities); density_idx++)
+      for (usize density_idx = 0; density_idx < density_count; density_idx++)
       {
         Repetition_Tester *tester = &testers[func_idx][density_idx];
         Repetition_Test_Values v = tester->results.min;
@@ -649,10 +2741,32 @@ int main(int arg_count, char **args)
 
         u32 left_non_zero_count  = non_zero_counts[density_idx][0];
         u32 right_non_zero_count = non_zero_counts[density_idx][1];
+        u64 output_non_zero      = output_non_zero_counts[func_idx][density_idx];
+
+        Operation_Counts *c = &counted[func_idx][density_idx];
 
-        fprintf(csv, "%u,%u,%u,%u,%u,%f,%lu,%lu,%lu,%lu\n",
+        // Observed where the build counts, counted otherwise
+        f64 bytes_per_flop = flops ? (f64)bytes / flops : c->flops ? (f64)c->bytes / c->flops : 0.0;
+
+        fprintf(csv, "%u,%u,%u,%u,%u,%f,%lu,%lu,%lu,%lu,%lu,%f,%lu,%lu,%lu",
                 row_count, col_count, inner_count, left_non_zero_count, right_non_zero_count,
-                density, flops, memops, time, bytes);
+                density, flops, memops, time, bytes, output_non_zero, bytes_per_flop,
+                c->flops, c->memops, c->bytes);
+
+        // Left empty when a counter couldn't be opened, so it reads as missing rather than 0
+        Perf_Counter_Values *perf_counts = &min_perf_counts[func_idx][density_idx];
+        for (usize counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+        {
+          if (perf_counts->valid[counter])
+          {
+            fprintf(csv, ",%lu", perf_counts->v[counter]);
+          }
+          else
+          {
+            fprintf(csv, ",");
+          }
+        }
+        fprintf(csv, "\n");
       }
     }
     else
@@ -660,4 +2774,19 @@ int main(int arg_count, char **args)
       LOG_ERROR("Unable to open csv file: %.*s", STRF(filename));
     }
   }
+
+  // Next to the entries', plot.py looks for it there
+  {
+    String timestamp = string_timestamp(&arena);
+    String filename  = string_formatted(&arena, "data/%.*s/roofline.csv", STRF(timestamp));
+
+    if (roofline_write_csv(&roofline, string_to_c_string(&arena, filename)))
+    {
+      LOG_INFO("Dumping roofline: %.*s", STRF(filename));
+    }
+    else
+    {
+      LOG_ERROR("Unable to open roofline file: %.*s", STRF(filename));
+    }
+  }
 }
@@ -4,9 +4,66 @@ global read128_asm
 global read256_asm
 global read512_asm
 global fmadd_asm
+global fmadd512_asm
 
 section .text
 
+; All the reads take (byte count, data) and go 64 bytes a loop, so the count has to be a multiple
+; of 64. Only the load width changes
+
+read32_asm:
+  align 64
+.loop:
+  mov eax, [rsi]
+  mov eax, [rsi + 4]
+  mov eax, [rsi + 8]
+  mov eax, [rsi + 12]
+  mov eax, [rsi + 16]
+  mov eax, [rsi + 20]
+  mov eax, [rsi + 24]
+  mov eax, [rsi + 28]
+  mov eax, [rsi + 32]
+  mov eax, [rsi + 36]
+  mov eax, [rsi + 40]
+  mov eax, [rsi + 44]
+  mov eax, [rsi + 48]
+  mov eax, [rsi + 52]
+  mov eax, [rsi + 56]
+  mov eax, [rsi + 60]
+  add rsi, 64
+  sub rdi, 64
+  jnle .loop
+  ret
+
+read64_asm:
+  align 64
+.loop:
+  mov rax, [rsi]
+  mov rax, [rsi + 8]
+  mov rax, [rsi + 16]
+  mov rax, [rsi + 24]
+  mov rax, [rsi + 32]
+  mov rax, [rsi + 40]
+  mov rax, [rsi + 48]
+  mov rax, [rsi + 56]
+  add rsi, 64
+  sub rdi, 64
+  jnle .loop
+  ret
+
+; Legacy SSE encoding so it runs anywhere, callers clear the upper halves after the wide ones
+read128_asm:
+  align 64
+.loop:
+  movdqu xmm0, [rsi]
+  movdqu xmm1, [rsi + 16]
+  movdqu xmm2, [rsi + 32]
+  movdqu xmm3, [rsi + 48]
+  add rsi, 64
+  sub rdi, 64
+  jnle .loop
+  ret
+
 read256_asm:
   align 64
 .loop:
@@ -15,6 +72,18 @@ read256_asm:
   add rsi, 64
   sub rdi, 64
   jnle .loop
+  vzeroupper
+  ret
+
+; AVX-512F only
+read512_asm:
+  align 64
+.loop:
+  vmovdqu64 zmm0, [rsi]
+  add rsi, 64
+  sub rdi, 64
+  jnle .loop
+  vzeroupper
   ret
 
 ; Try to get full saturation
@@ -43,6 +112,36 @@ fmadd_asm:
   sub rdi, 64
   jnz .loop
 
+  vzeroupper
+  ret
+
+; AVX-512F only. Same chains, twice as wide
+fmadd512_asm:
+  vbroadcastsd zmm0, [rel one]
+  vbroadcastsd zmm1, [rel one]
+  vbroadcastsd zmm2, [rel one]
+  vbroadcastsd zmm3, [rel one]
+  vbroadcastsd zmm4, [rel one]
+  vbroadcastsd zmm5, [rel one]
+  vbroadcastsd zmm6, [rel one]
+  vbroadcastsd zmm7, [rel one]
+
+  align 64
+.loop:
+  vfmadd231pd zmm0, zmm0, zmm0
+  vfmadd231pd zmm1, zmm1, zmm1
+  vfmadd231pd zmm2, zmm2, zmm2
+  vfmadd231pd zmm3, zmm3, zmm3
+  vfmadd231pd zmm4, zmm4, zmm4
+  vfmadd231pd zmm5, zmm5, zmm5
+  vfmadd231pd zmm6, zmm6, zmm6
+  vfmadd231pd zmm7, zmm7, zmm7
+
+  ; 8 fmadds (2 flops), 8 wide each, so 8 * 8 * 2 = 128
+  sub rdi, 128
+  jnz .loop
+
+  vzeroupper
   ret
 
 section .data
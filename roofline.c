@@ -0,0 +1,430 @@
+#include "roofline.h"
+
+#include <immintrin.h>
+
+// roofline.asm. Byte counts a multiple of 64, flop counts of 64 for fmadd_asm and 128 for
+// fmadd512_asm
+extern void read32_asm(u64 byte_count, u8 *data);
+extern void read64_asm(u64 byte_count, u8 *data);
+extern void read128_asm(u64 byte_count, u8 *data);
+extern void read256_asm(u64 byte_count, u8 *data);
+extern void read512_asm(u64 byte_count, u8 *data);
+extern void fmadd_asm(u64 flop_count);
+extern void fmadd512_asm(u64 flop_count);
+
+typedef void Roofline_Read(u64 byte_count, u8 *data);
+typedef void Roofline_Fmadd(u64 flop_count);
+
+static Roofline_Read *roofline_reads[ROOFLINE_WIDTH_COUNT] =
+{
+  [ROOFLINE_WIDTH_32]  = read32_asm,
+  [ROOFLINE_WIDTH_64]  = read64_asm,
+  [ROOFLINE_WIDTH_128] = read128_asm,
+  [ROOFLINE_WIDTH_256] = read256_asm,
+  [ROOFLINE_WIDTH_512] = read512_asm,
+};
+
+static u8 roofline_buffer[ROOFLINE_BUFFER_SIZE];
+
+// Small buffers get read over again until each thread has moved about this much, so the dispatch
+// doesn't show up in the time
+#define ROOFLINE_BYTES_PER_THREAD MB(64)
+
+#define ROOFLINE_FLOPS_PER_THREAD GB(1)
+
+typedef struct Roofline_Task Roofline_Task;
+struct Roofline_Task
+{
+  // Either a read of slice_bytes from each thread's own slice, repeat_count times, or an fmadd
+  Roofline_Read *read;
+  u64 slice_bytes;
+  u64 repeat_count;
+
+  Roofline_Fmadd *fmadd;
+  u64 flop_count;
+
+  u32 started;
+};
+
+static
+void roofline_task(void *user, u32 task_index, u32 task_count)
+{
+  Roofline_Task *task = user;
+
+  // Nobody starts until every task has a thread of its own, otherwise a quick one could claim
+  // two and the thread count would be a lie
+  __atomic_fetch_add(&task->started, 1, __ATOMIC_ACQ_REL);
+  while (__atomic_load_n(&task->started, __ATOMIC_ACQUIRE) < task_count)
+  {
+    _mm_pause();
+  }
+
+  if (task->read)
+  {
+    u8 *data = roofline_buffer + task_index * task->slice_bytes;
+    for (u64 i = 0; i < task->repeat_count; i++)
+    {
+      task->read(task->slice_bytes, data);
+    }
+  }
+  else
+  {
+    task->fmadd(task->flop_count);
+  }
+}
+
+// Bytes or flops per tick, all threads together
+static
+f64 roofline_run(Thread_Pool *pool, Roofline_Task *task, u32 thread_count,
+                 u64 cpu_timer_frequency, u32 seconds_to_try_for_min, char *label)
+{
+  Repetition_Tester tester = {0};
+  repetition_tester_new_wave(&tester, 0, cpu_timer_frequency, seconds_to_try_for_min);
+
+  u64 byte_count = task->read ? task->slice_bytes * task->repeat_count * thread_count : 0;
+  u64 flop_count = task->read ? 0 : task->flop_count * thread_count;
+
+  printf("\n--- Roofline %s ---\n", label);
+  printf("                                                          \r");
+  while (repetition_tester_is_testing(&tester))
+  {
+    task->started = 0;
+
+    repetition_tester_begin_time(&tester);
+
+    thread_pool_dispatch(pool, thread_count, roofline_task, task);
+
+    repetition_tester_close_time(&tester);
+
+    repetition_tester_count_bytes(&tester, byte_count);
+    repetition_tester_count_flops(&tester, flop_count);
+  }
+
+  Repetition_Test_Values v = tester.results.min;
+  u64 time  = v.v[REPTEST_VALUE_TIME];
+  u64 count = task->read ? v.v[REPTEST_VALUE_BYTE_COUNT] : v.v[REPTEST_VALUE_FLOP_COUNT];
+
+  f64 result = time ? (f64)count / time : 0.0;
+
+  printf("Roofline %s: %f\n", label, result);
+
+  return result;
+}
+
+static
+f64 roofline_read(Thread_Pool *pool, Roofline_Width width, u64 slice_bytes, u32 thread_count,
+                  u64 cpu_timer_frequency, u32 seconds_to_try_for_min, char *label)
+{
+  Roofline_Task task =
+  {
+    .read         = roofline_reads[width],
+    .slice_bytes  = slice_bytes,
+    .repeat_count = MAX(ROOFLINE_BYTES_PER_THREAD / slice_bytes, 1),
+  };
+
+  return roofline_run(pool, &task, thread_count, cpu_timer_frequency, seconds_to_try_for_min, label);
+}
+
+static
+f64 roofline_fmadd(Thread_Pool *pool, Roofline_Fmadd *fmadd, u32 thread_count,
+                   u64 cpu_timer_frequency, u32 seconds_to_try_for_min, char *label)
+{
+  Roofline_Task task =
+  {
+    .fmadd      = fmadd,
+    .flop_count = ROOFLINE_FLOPS_PER_THREAD,
+  };
+
+  return roofline_run(pool, &task, thread_count, cpu_timer_frequency, seconds_to_try_for_min, label);
+}
+
+// What each thread reads from a level when there are thread_count of them, whole loops of the
+// read kernels
+static
+u64 roofline_slice_bytes(Roofline_Results *results, Roofline_Level level, u32 thread_count)
+{
+  u64 result = results->level_bytes[level];
+
+  if (level == ROOFLINE_L3 || level == ROOFLINE_DRAM)
+  {
+    result /= thread_count;
+  }
+
+  result = MIN(result, ROOFLINE_BUFFER_SIZE / thread_count);
+
+  return MAX(result / 64 * 64, 64);
+}
+
+static
+Roofline_Results roofline_measure(Thread_Pool *pool, u64 cpu_timer_frequency, u32 seconds_to_try_for_min)
+{
+  Roofline_Results result = {0};
+
+  Simd_Level level = simd_level();
+  result.widest = level == SIMD_AVX512 ? ROOFLINE_WIDTH_512 :
+                  level == SIMD_AVX2   ? ROOFLINE_WIDTH_256 : ROOFLINE_WIDTH_128;
+
+  // Untouched pages all map to the one zero page, which would read back at cache speed
+  MEM_SET(roofline_buffer, sizeof(roofline_buffer), 1);
+
+  result.level_bytes[ROOFLINE_L1]   = cpu_cache_size(1) / 2;
+  result.level_bytes[ROOFLINE_L2]   = cpu_cache_size(2) / 2;
+  result.level_bytes[ROOFLINE_L3]   = cpu_cache_size(3) / 2;
+  result.level_bytes[ROOFLINE_DRAM] = ROOFLINE_BUFFER_SIZE;
+
+  u32 max_thread_count = pool->worker_count + 1;
+  for (u32 thread_count = 1; thread_count < max_thread_count && result.thread_step_count < ROOFLINE_MAX_THREAD_STEPS - 1;
+       thread_count *= 2)
+  {
+    result.thread_counts[result.thread_step_count++] = thread_count;
+  }
+  result.thread_counts[result.thread_step_count++] = max_thread_count;
+
+  char label[128];
+
+  for (usize level_idx = 0; level_idx < ROOFLINE_LEVEL_COUNT; level_idx++)
+  {
+    for (usize width = 0; width <= result.widest; width++)
+    {
+      snprintf(label, sizeof(label), "%s read %u bit", roofline_level_names[level_idx], roofline_width_bits[width]);
+      result.bandwidth[level_idx][width] = roofline_read(pool, width, roofline_slice_bytes(&result, level_idx, 1), 1,
+                                                         cpu_timer_frequency, seconds_to_try_for_min, label);
+    }
+  }
+
+  for (usize i = 0; i < ROOFLINE_SWEEP_COUNT; i++)
+  {
+    result.sweep_bytes[i] = MIN(KB(4) << i, ROOFLINE_BUFFER_SIZE);
+
+    snprintf(label, sizeof(label), "sweep %lu KB", result.sweep_bytes[i] / KB(1));
+    result.sweep[i] = roofline_read(pool, result.widest, result.sweep_bytes[i], 1,
+                                    cpu_timer_frequency, seconds_to_try_for_min, label);
+  }
+
+  for (u32 step = 0; step < result.thread_step_count; step++)
+  {
+    u32 thread_count = result.thread_counts[step];
+
+    for (usize level_idx = 0; level_idx < ROOFLINE_LEVEL_COUNT; level_idx++)
+    {
+      // Already have the one thread number
+      if (thread_count == 1)
+      {
+        result.threaded_bandwidth[level_idx][step] = result.bandwidth[level_idx][result.widest];
+        continue;
+      }
+
+      snprintf(label, sizeof(label), "%s read %u bit, %u threads",
+               roofline_level_names[level_idx], roofline_width_bits[result.widest], thread_count);
+      result.threaded_bandwidth[level_idx][step] =
+        roofline_read(pool, result.widest, roofline_slice_bytes(&result, level_idx, thread_count), thread_count,
+                      cpu_timer_frequency, seconds_to_try_for_min, label);
+    }
+
+    if (level >= SIMD_AVX2)
+    {
+      snprintf(label, sizeof(label), "fmadd 256 bit, %u threads", thread_count);
+      result.threaded_flops_256[step] = roofline_fmadd(pool, fmadd_asm, thread_count,
+                                                       cpu_timer_frequency, seconds_to_try_for_min, label);
+    }
+
+    if (level >= SIMD_AVX512)
+    {
+      snprintf(label, sizeof(label), "fmadd 512 bit, %u threads", thread_count);
+      result.threaded_flops_512[step] = roofline_fmadd(pool, fmadd512_asm, thread_count,
+                                                       cpu_timer_frequency, seconds_to_try_for_min, label);
+    }
+  }
+
+  return result;
+}
+
+static
+b32 roofline_write_csv(Roofline_Results *results, char *path)
+{
+  FILE *csv = fopen(path, "w");
+  if (!csv)
+  {
+    return false;
+  }
+
+  fprintf(csv, "kind,level,width_bits,thread_count,buffer_bytes,per_tick\n");
+
+  for (usize level_idx = 0; level_idx < ROOFLINE_LEVEL_COUNT; level_idx++)
+  {
+    for (usize width = 0; width <= results->widest; width++)
+    {
+      fprintf(csv, "read,%s,%u,1,%lu,%f\n", roofline_level_names[level_idx], roofline_width_bits[width],
+              results->level_bytes[level_idx], results->bandwidth[level_idx][width]);
+    }
+
+    for (u32 step = 0; step < results->thread_step_count; step++)
+    {
+      u32 thread_count = results->thread_counts[step];
+      if (thread_count > 1)
+      {
+        fprintf(csv, "read,%s,%u,%u,%lu,%f\n", roofline_level_names[level_idx], roofline_width_bits[results->widest],
+                thread_count, roofline_slice_bytes(results, level_idx, thread_count) * thread_count,
+                results->threaded_bandwidth[level_idx][step]);
+      }
+    }
+  }
+
+  for (usize i = 0; i < ROOFLINE_SWEEP_COUNT; i++)
+  {
+    fprintf(csv, "sweep,,%u,1,%lu,%f\n", roofline_width_bits[results->widest], results->sweep_bytes[i], results->sweep[i]);
+  }
+
+  for (u32 step = 0; step < results->thread_step_count; step++)
+  {
+    if (results->threaded_flops_256[step])
+    {
+      fprintf(csv, "fmadd,,256,%u,0,%f\n", results->thread_counts[step], results->threaded_flops_256[step]);
+    }
+    if (results->threaded_flops_512[step])
+    {
+      fprintf(csv, "fmadd,,512,%u,0,%f\n", results->thread_counts[step], results->threaded_flops_512[step]);
+    }
+  }
+
+  fclose(csv);
+
+  return true;
+}
+
+// Index of thread_count in thread_counts, added if it isn't there yet. ROOFLINE_MAX_THREAD_STEPS
+// if there's no room
+static
+u32 roofline_thread_step(Roofline_Results *results, u32 thread_count)
+{
+  for (u32 step = 0; step < results->thread_step_count; step++)
+  {
+    if (results->thread_counts[step] == thread_count)
+    {
+      return step;
+    }
+  }
+
+  if (results->thread_step_count == ROOFLINE_MAX_THREAD_STEPS)
+  {
+    return ROOFLINE_MAX_THREAD_STEPS;
+  }
+
+  results->thread_counts[results->thread_step_count] = thread_count;
+
+  return results->thread_step_count++;
+}
+
+static
+b32 roofline_read_csv(Roofline_Results *results, char *path)
+{
+  FILE *csv = fopen(path, "r");
+  if (!csv)
+  {
+    return false;
+  }
+
+  Roofline_Results result = {0};
+
+  // One thread is always step 0, what the cost model reads
+  result.thread_counts[result.thread_step_count++] = 1;
+
+  b32 ok = true;
+  u32 sweep_count = 0;
+
+  char line[256];
+  b32 header = true;
+  while (ok && fgets(line, sizeof(line), csv))
+  {
+    if (header)
+    {
+      ok = strcmp(line, "kind,level,width_bits,thread_count,buffer_bytes,per_tick\n") == 0;
+      header = false;
+      continue;
+    }
+
+    // Level is empty for sweep and fmadd rows, which sscanf's %[^,] won't match
+    char *fields[6] = {0};
+    usize field_count = 0;
+    for (char *at = line; at && field_count < STATIC_COUNT(fields); field_count++)
+    {
+      fields[field_count] = at;
+      at = strchr(at, ',');
+      if (at)
+      {
+        *at++ = '\0';
+      }
+    }
+
+    if (field_count != STATIC_COUNT(fields))
+    {
+      ok = false;
+      break;
+    }
+
+    u32 width_bits   = (u32)strtoul(fields[2], NULL, 10);
+    u32 thread_count = (u32)strtoul(fields[3], NULL, 10);
+    u64 buffer_bytes = strtoull(fields[4], NULL, 10);
+    f64 per_tick     = strtod(fields[5], NULL);
+
+    usize level = ROOFLINE_LEVEL_COUNT;
+    for (usize i = 0; i < ROOFLINE_LEVEL_COUNT; i++)
+    {
+      level = strcmp(fields[1], roofline_level_names[i]) == 0 ? i : level;
+    }
+
+    usize width = ROOFLINE_WIDTH_COUNT;
+    for (usize i = 0; i < ROOFLINE_WIDTH_COUNT; i++)
+    {
+      width = roofline_width_bits[i] == width_bits ? i : width;
+    }
+
+    u32 step = roofline_thread_step(&result, thread_count);
+
+    if (strcmp(fields[0], "read") == 0 && level < ROOFLINE_LEVEL_COUNT && width < ROOFLINE_WIDTH_COUNT &&
+        step < ROOFLINE_MAX_THREAD_STEPS)
+    {
+      if (thread_count == 1)
+      {
+        result.bandwidth[level][width] = per_tick;
+        result.level_bytes[level]      = buffer_bytes;
+        result.widest                  = MAX(result.widest, (Roofline_Width)width);
+      }
+      else
+      {
+        result.threaded_bandwidth[level][step] = per_tick;
+      }
+    }
+    else if (strcmp(fields[0], "sweep") == 0 && sweep_count < ROOFLINE_SWEEP_COUNT)
+    {
+      result.sweep_bytes[sweep_count] = buffer_bytes;
+      result.sweep[sweep_count]       = per_tick;
+      sweep_count += 1;
+    }
+    else if (strcmp(fields[0], "fmadd") == 0 && step < ROOFLINE_MAX_THREAD_STEPS && (width_bits == 256 || width_bits == 512))
+    {
+      f64 *flops = width_bits == 256 ? result.threaded_flops_256 : result.threaded_flops_512;
+      flops[step] = per_tick;
+    }
+    else
+    {
+      ok = false;
+    }
+  }
+
+  fclose(csv);
+
+  // Not written out, it's the single thread read at the widest width
+  for (usize level = 0; level < ROOFLINE_LEVEL_COUNT; level++)
+  {
+    result.threaded_bandwidth[level][0] = result.bandwidth[level][result.widest];
+  }
+
+  ok = ok && !header && sweep_count == ROOFLINE_SWEEP_COUNT;
+  if (ok)
+  {
+    *results = result;
+  }
+
+  return ok;
+}
@@ -0,0 +1,91 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include "../common.h"
+#include "threads.h"
+
+// Ceilings to put each kernel against. Read bandwidth out of a buffer sized to sit in each level
+// of the hierarchy, at every load width, plus FMA throughput, each from 1 thread up to however
+// many the pool has. Everything is in the tester's own time units, like the kernels' times
+typedef enum Roofline_Level
+{
+  ROOFLINE_L1,
+  ROOFLINE_L2,
+  ROOFLINE_L3,
+  ROOFLINE_DRAM,
+
+  ROOFLINE_LEVEL_COUNT,
+} Roofline_Level;
+
+static char *roofline_level_names[ROOFLINE_LEVEL_COUNT] =
+{
+  [ROOFLINE_L1]   = "L1",
+  [ROOFLINE_L2]   = "L2",
+  [ROOFLINE_L3]   = "L3",
+  [ROOFLINE_DRAM] = "DRAM",
+};
+
+typedef enum Roofline_Width
+{
+  ROOFLINE_WIDTH_32,
+  ROOFLINE_WIDTH_64,
+  ROOFLINE_WIDTH_128,
+  ROOFLINE_WIDTH_256,
+  ROOFLINE_WIDTH_512, // AVX-512 only, also the 512 bit FMA
+
+  ROOFLINE_WIDTH_COUNT,
+} Roofline_Width;
+
+static u32 roofline_width_bits[ROOFLINE_WIDTH_COUNT] = {32, 64, 128, 256, 512};
+
+// 1, 2, 4 ... and the pool's full count if that isn't a power of two
+#define ROOFLINE_MAX_THREAD_STEPS 16
+
+// Single thread reads from 4 KB up to ROOFLINE_BUFFER_SIZE, doubling
+#define ROOFLINE_SWEEP_COUNT 19
+
+#define ROOFLINE_BUFFER_SIZE GB(1)
+
+typedef struct Roofline_Results Roofline_Results;
+struct Roofline_Results
+{
+  // Widest width this machine can load and FMA with, what the thread scaling runs at
+  Roofline_Width widest;
+
+  // Half of the level, so it stays put. Per thread for L1 and L2, split between them for L3 and
+  // DRAM since those are shared
+  u64 level_bytes[ROOFLINE_LEVEL_COUNT];
+
+  // Bytes per tick, single thread. 0 for widths the machine lacks
+  f64 bandwidth[ROOFLINE_LEVEL_COUNT][ROOFLINE_WIDTH_COUNT];
+
+  u32 thread_counts[ROOFLINE_MAX_THREAD_STEPS];
+  u32 thread_step_count;
+
+  // All threads together, bytes at the widest width and flops at 256 and 512 bits
+  f64 threaded_bandwidth[ROOFLINE_LEVEL_COUNT][ROOFLINE_MAX_THREAD_STEPS];
+  f64 threaded_flops_256[ROOFLINE_MAX_THREAD_STEPS];
+  f64 threaded_flops_512[ROOFLINE_MAX_THREAD_STEPS];
+
+  u64 sweep_bytes[ROOFLINE_SWEEP_COUNT];
+  f64 sweep[ROOFLINE_SWEEP_COUNT];
+};
+
+// Each measurement gets its own wave of seconds_to_try_for_min
+static
+Roofline_Results roofline_measure(Thread_Pool *pool, u64 cpu_timer_frequency, u32 seconds_to_try_for_min);
+
+// One row per measurement: kind (read, sweep, fmadd), level, width_bits, thread_count,
+// buffer_bytes, per_tick. plot.py draws its ceilings from this
+static
+b32 roofline_write_csv(Roofline_Results *results, char *path);
+
+// Measuring is a few minutes of waves, so main keeps the last results here and reads them back
+// instead. Delete it after changing machines
+#define ROOFLINE_CACHE_PATH "data/roofline.csv"
+
+// Back from roofline_write_csv(). False if it's missing or doesn't parse
+static
+b32 roofline_read_csv(Roofline_Results *results, char *path);
+
+#endif // ROOFLINE_H
@@ -0,0 +1,946 @@
+#include "simd.h"
+
+#include <cpuid.h>
+#include <immintrin.h>
+#include <unistd.h>
+
+#define AVX2_TARGET   __attribute__((target("avx2,fma")))
+#define AVX512_TARGET __attribute__((target("avx512f")))
+
+// Independent accumulators per column tile, enough to cover FMA latency * throughput
+#define AVX2_TILE_REGISTERS   8
+#define AVX512_TILE_REGISTERS 8
+
+static
+Simd_Level simd_detect_level(void)
+{
+  u32 eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+  {
+    return SIMD_SCALAR;
+  }
+
+  b32 has_fma     = (ecx >> 12) & 1;
+  b32 has_osxsave = (ecx >> 27) & 1;
+  b32 has_avx     = (ecx >> 28) & 1;
+
+  if (!has_fma || !has_osxsave || !has_avx)
+  {
+    return SIMD_SCALAR;
+  }
+
+  // CPU supporting it doesn't mean the OS saves the registers on context switch
+  u32 xcr0_low, xcr0_high;
+  __asm__ volatile ("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+  u64 xcr0 = ((u64)xcr0_high << 32) | xcr0_low;
+
+  b32 os_saves_ymm = (xcr0 & 0x06) == 0x06;
+  b32 os_saves_zmm = (xcr0 & 0xE6) == 0xE6;
+
+  if (!os_saves_ymm || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+  {
+    return SIMD_SCALAR;
+  }
+
+  b32 has_avx2    = (ebx >> 5) & 1;
+  b32 has_avx512f = (ebx >> 16) & 1;
+
+  Simd_Level result = SIMD_SCALAR;
+
+  if (has_avx2)
+  {
+    result = SIMD_AVX2;
+  }
+
+  if (has_avx512f && os_saves_zmm)
+  {
+    result = SIMD_AVX512;
+  }
+
+  return result;
+}
+
+static
+Simd_Level simd_level(void)
+{
+  static Simd_Level level = SIMD_COUNT;
+
+  // Racy, but every thread would detect the same thing
+  if (level == SIMD_COUNT)
+  {
+    level = simd_detect_level();
+  }
+
+  return level;
+}
+
+static
+String simd_level_name(Simd_Level level)
+{
+  String result = STR("scalar");
+
+  switch (level)
+  {
+    case SIMD_AVX2:   result = STR("avx2");   break;
+    case SIMD_AVX512: result = STR("avx512"); break;
+    default: break;
+  }
+
+  return result;
+}
+
+// If sysconf doesn't know, which happens under some VMs
+#define DEFAULT_L1_CACHE_SIZE KB(32)
+#define DEFAULT_L2_CACHE_SIZE MB(1)
+#define DEFAULT_L3_CACHE_SIZE MB(8)
+
+static
+usize cpu_cache_size(u32 level)
+{
+  static usize sizes[4] = {0};
+
+  // Racy like simd_level(), same answer either way
+  if (!sizes[1])
+  {
+    long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+
+    sizes[3] = l3 > 0 ? (usize)l3 : DEFAULT_L3_CACHE_SIZE;
+    sizes[2] = l2 > 0 ? (usize)l2 : DEFAULT_L2_CACHE_SIZE;
+    sizes[1] = l1 > 0 ? (usize)l1 : DEFAULT_L1_CACHE_SIZE;
+  }
+
+  return sizes[MIN(MAX(level, 1), 3)];
+}
+
+//
+// CSR row X Dense
+//
+
+static
+void csr_dense_row_scalar(f64 *output_row, u32 *col_indices, f64 *values, usize count,
+                          f64 *right_values, usize right_stride, usize right_col_count)
+{
+  for (usize right_col = 0; right_col < right_col_count; right_col++)
+  {
+    output_row[right_col] = 0.0;
+  }
+
+  for (usize i = 0; i < count; i++)
+  {
+    f64 *right_row = right_values + col_indices[i] * right_stride;
+
+    for (usize right_col = 0; right_col < right_col_count; right_col++)
+    {
+      output_row[right_col] += values[i] * right_row[right_col];
+    }
+  }
+}
+
+// Output tile lives in registers across all of the row's non zeros, and is only stored once
+AVX2_TARGET
+static
+void csr_dense_row_avx2(f64 *output_row, u32 *col_indices, f64 *values, usize count,
+                        f64 *right_values, usize right_stride, usize right_col_count)
+{
+  usize tile_width = 4 * AVX2_TILE_REGISTERS;
+
+  usize col = 0;
+  for (; col + tile_width <= right_col_count; col += tile_width)
+  {
+    __m256d accumulators[AVX2_TILE_REGISTERS];
+    for (usize t = 0; t < AVX2_TILE_REGISTERS; t++)
+    {
+      accumulators[t] = _mm256_setzero_pd();
+    }
+
+    for (usize i = 0; i < count; i++)
+    {
+      __m256d left_value = _mm256_broadcast_sd(values + i);
+      f64 *right_tile = right_values + col_indices[i] * right_stride + col;
+
+      for (usize t = 0; t < AVX2_TILE_REGISTERS; t++)
+      {
+        accumulators[t] = _mm256_fmadd_pd(left_value, _mm256_loadu_pd(right_tile + 4 * t), accumulators[t]);
+      }
+    }
+
+    for (usize t = 0; t < AVX2_TILE_REGISTERS; t++)
+    {
+      _mm256_storeu_pd(output_row + col + 4 * t, accumulators[t]);
+    }
+  }
+
+  for (; col < right_col_count; col += 4)
+  {
+    // Masked for the remainder, masked lanes aren't touched so can't fault past the row
+    usize remaining = right_col_count - col;
+    __m256i mask = _mm256_cmpgt_epi64(_mm256_set1_epi64x(remaining), _mm256_setr_epi64x(0, 1, 2, 3));
+
+    __m256d accumulator = _mm256_setzero_pd();
+    for (usize i = 0; i < count; i++)
+    {
+      __m256d left_value = _mm256_broadcast_sd(values + i);
+      f64 *right_tile = right_values + col_indices[i] * right_stride + col;
+
+      accumulator = _mm256_fmadd_pd(left_value, _mm256_maskload_pd(right_tile, mask), accumulator);
+    }
+
+    _mm256_maskstore_pd(output_row + col, mask, accumulator);
+  }
+}
+
+AVX512_TARGET
+static
+void csr_dense_row_avx512(f64 *output_row, u32 *col_indices, f64 *values, usize count,
+                          f64 *right_values, usize right_stride, usize right_col_count)
+{
+  usize tile_width = 8 * AVX512_TILE_REGISTERS;
+
+  usize col = 0;
+  for (; col + tile_width <= right_col_count; col += tile_width)
+  {
+    __m512d accumulators[AVX512_TILE_REGISTERS];
+    for (usize t = 0; t < AVX512_TILE_REGISTERS; t++)
+    {
+      accumulators[t] = _mm512_setzero_pd();
+    }
+
+    for (usize i = 0; i < count; i++)
+    {
+      __m512d left_value = _mm512_set1_pd(values[i]);
+      f64 *right_tile = right_values + col_indices[i] * right_stride + col;
+
+      for (usize t = 0; t < AVX512_TILE_REGISTERS; t++)
+      {
+        accumulators[t] = _mm512_fmadd_pd(left_value, _mm512_loadu_pd(right_tile + 8 * t), accumulators[t]);
+      }
+    }
+
+    for (usize t = 0; t < AVX512_TILE_REGISTERS; t++)
+    {
+      _mm512_storeu_pd(output_row + col + 8 * t, accumulators[t]);
+    }
+  }
+
+  for (; col < right_col_count; col += 8)
+  {
+    usize remaining = right_col_count - col;
+    __mmask8 mask = remaining >= 8 ? 0xFF : (__mmask8)((1u << remaining) - 1);
+
+    __m512d accumulator = _mm512_setzero_pd();
+    for (usize i = 0; i < count; i++)
+    {
+      __m512d left_value = _mm512_set1_pd(values[i]);
+      f64 *right_tile = right_values + col_indices[i] * right_stride + col;
+
+      accumulator = _mm512_fmadd_pd(left_value, _mm512_maskz_loadu_pd(mask, right_tile), accumulator);
+    }
+
+    _mm512_mask_storeu_pd(output_row + col, mask, accumulator);
+  }
+}
+
+static Simd_CSR_Dense_Row *simd_csr_dense_row_kernels[SIMD_COUNT] =
+{
+  [SIMD_SCALAR] = csr_dense_row_scalar,
+  [SIMD_AVX2]   = csr_dense_row_avx2,
+  [SIMD_AVX512] = csr_dense_row_avx512,
+};
+
+//
+// CSC column X Dense
+//
+
+static
+void csc_dense_col_scalar(f64 *output_values, usize output_col_count,
+                          u32 *row_indices, f64 *values, usize count,
+                          f64 *right_row, usize right_col_count)
+{
+  for (usize i = 0; i < count; i++)
+  {
+    f64 *output_row = output_values + row_indices[i] * output_col_count;
+
+    for (usize right_col = 0; right_col < right_col_count; right_col++)
+    {
+      output_row[right_col] += values[i] * right_row[right_col];
+    }
+  }
+}
+
+// Every non zero in the column hits a different output row, so it's the right tile that stays
+// in registers instead
+AVX2_TARGET
+static
+void csc_dense_col_avx2(f64 *output_values, usize output_col_count,
+                        u32 *row_indices, f64 *values, usize count,
+                        f64 *right_row, usize right_col_count)
+{
+  // Half of the file for the right tile, other half for output
+  enum { TILE_REGISTERS = AVX2_TILE_REGISTERS / 2 };
+  usize tile_width = 4 * TILE_REGISTERS;
+
+  usize col = 0;
+  for (; col + tile_width <= right_col_count; col += tile_width)
+  {
+    __m256d right_tile[TILE_REGISTERS];
+    for (usize t = 0; t < TILE_REGISTERS; t++)
+    {
+      right_tile[t] = _mm256_loadu_pd(right_row + col + 4 * t);
+    }
+
+    for (usize i = 0; i < count; i++)
+    {
+      __m256d left_value = _mm256_broadcast_sd(values + i);
+      f64 *output_tile = output_values + row_indices[i] * output_col_count + col;
+
+      for (usize t = 0; t < TILE_REGISTERS; t++)
+      {
+        __m256d output = _mm256_fmadd_pd(left_value, right_tile[t], _mm256_loadu_pd(output_tile + 4 * t));
+        _mm256_storeu_pd(output_tile + 4 * t, output);
+      }
+    }
+  }
+
+  for (; col < right_col_count; col += 4)
+  {
+    usize remaining = right_col_count - col;
+    __m256i mask = _mm256_cmpgt_epi64(_mm256_set1_epi64x(remaining), _mm256_setr_epi64x(0, 1, 2, 3));
+
+    __m256d right = _mm256_maskload_pd(right_row + col, mask);
+    for (usize i = 0; i < count; i++)
+    {
+      __m256d left_value = _mm256_broadcast_sd(values + i);
+      f64 *output_tile = output_values + row_indices[i] * output_col_count + col;
+
+      __m256d output = _mm256_fmadd_pd(left_value, right, _mm256_maskload_pd(output_tile, mask));
+      _mm256_maskstore_pd(output_tile, mask, output);
+    }
+  }
+}
+
+AVX512_TARGET
+static
+void csc_dense_col_avx512(f64 *output_values, usize output_col_count,
+                          u32 *row_indices, f64 *values, usize count,
+                          f64 *right_row, usize right_col_count)
+{
+  usize tile_width = 8 * AVX512_TILE_REGISTERS;
+
+  usize col = 0;
+  for (; col + tile_width <= right_col_count; col += tile_width)
+  {
+    __m512d right_tile[AVX512_TILE_REGISTERS];
+    for (usize t = 0; t < AVX512_TILE_REGISTERS; t++)
+    {
+      right_tile[t] = _mm512_loadu_pd(right_row + col + 8 * t);
+    }
+
+    for (usize i = 0; i < count; i++)
+    {
+      __m512d left_value = _mm512_set1_pd(values[i]);
+      f64 *output_tile = output_values + row_indices[i] * output_col_count + col;
+
+      for (usize t = 0; t < AVX512_TILE_REGISTERS; t++)
+      {
+        __m512d output = _mm512_fmadd_pd(left_value, right_tile[t], _mm512_loadu_pd(output_tile + 8 * t));
+        _mm512_storeu_pd(output_tile + 8 * t, output);
+      }
+    }
+  }
+
+  for (; col < right_col_count; col += 8)
+  {
+    usize remaining = right_col_count - col;
+    __mmask8 mask = remaining >= 8 ? 0xFF : (__mmask8)((1u << remaining) - 1);
+
+    __m512d right = _mm512_maskz_loadu_pd(mask, right_row + col);
+    for (usize i = 0; i < count; i++)
+    {
+      __m512d left_value = _mm512_set1_pd(values[i]);
+      f64 *output_tile = output_values + row_indices[i] * output_col_count + col;
+
+      __m512d output = _mm512_fmadd_pd(left_value, right, _mm512_maskz_loadu_pd(mask, output_tile));
+      _mm512_mask_storeu_pd(output_tile, mask, output);
+    }
+  }
+}
+
+static Simd_CSC_Dense_Col *simd_csc_dense_col_kernels[SIMD_COUNT] =
+{
+  [SIMD_SCALAR] = csc_dense_col_scalar,
+  [SIMD_AVX2]   = csc_dense_col_avx2,
+  [SIMD_AVX512] = csc_dense_col_avx512,
+};
+
+//
+// Narrow right, fixed widths
+//
+
+// Right exactly W wide, W a compile time constant. The whole output row is W accumulators, which
+// the compiler keeps in registers, vectorized for the target, with every loop over them unrolled
+// away. Under 4 wide there's too little in a row to hide FMA latency, so CHAINS independent sets
+// take turns over the row's non zeros. The CSC one holds the right row instead, like the general
+// kernels. Same signatures as those, right_col_count is W
+#define SIMD_NARROW_KERNELS(W, CHAINS, suffix, TARGET)                                             \
+TARGET                                                                                           \
+static                                                                                           \
+void csr_dense_row_##W##_##suffix(f64 *output_row, u32 *col_indices, f64 *values, usize count,   \
+                                  f64 *right_values, usize right_stride, usize right_col_count)  \
+{                                                                                                \
+  (void)right_col_count;                                                                         \
+                                                                                                 \
+  f64 sums[CHAINS][W] = {0};                                                                     \
+                                                                                                 \
+  usize i = 0;                                                                                   \
+  for (; i + CHAINS <= count; i += CHAINS)                                                       \
+  {                                                                                              \
+    for (usize chain = 0; chain < CHAINS; chain++)                                               \
+    {                                                                                            \
+      f64 value = values[i + chain];                                                             \
+      f64 *right_row = right_values + col_indices[i + chain] * right_stride;                     \
+                                                                                                 \
+      for (usize col = 0; col < W; col++)                                                        \
+      {                                                                                          \
+        sums[chain][col] += value * right_row[col];                                              \
+      }                                                                                          \
+    }                                                                                            \
+  }                                                                                              \
+                                                                                                 \
+  for (; i < count; i++)                                                                         \
+  {                                                                                              \
+    f64 *right_row = right_values + col_indices[i] * right_stride;                               \
+                                                                                                 \
+    for (usize col = 0; col < W; col++)                                                          \
+    {                                                                                            \
+      sums[0][col] += values[i] * right_row[col];                                                \
+    }                                                                                            \
+  }                                                                                              \
+                                                                                                 \
+  for (usize col = 0; col < W; col++)                                                            \
+  {                                                                                              \
+    f64 sum = 0.0;                                                                               \
+    for (usize chain = 0; chain < CHAINS; chain++)                                               \
+    {                                                                                            \
+      sum += sums[chain][col];                                                                   \
+    }                                                                                            \
+                                                                                                 \
+    output_row[col] = sum;                                                                       \
+  }                                                                                              \
+}                                                                                                \
+                                                                                                 \
+TARGET                                                                                           \
+static                                                                                           \
+void csc_dense_col_##W##_##suffix(f64 *output_values, usize output_col_count,                    \
+                                  u32 *row_indices, f64 *values, usize count,                    \
+                                  f64 *right_row, usize right_col_count)                         \
+{                                                                                                \
+  (void)right_col_count;                                                                         \
+                                                                                                 \
+  f64 right[W];                                                                                  \
+  for (usize col = 0; col < W; col++)                                                            \
+  {                                                                                              \
+    right[col] = right_row[col];                                                                 \
+  }                                                                                              \
+                                                                                                 \
+  for (usize i = 0; i < count; i++)                                                              \
+  {                                                                                              \
+    f64 *output_row = output_values + row_indices[i] * output_col_count;                         \
+                                                                                                 \
+    for (usize col = 0; col < W; col++)                                                          \
+    {                                                                                            \
+      output_row[col] += values[i] * right[col];                                                 \
+    }                                                                                            \
+  }                                                                                              \
+}
+
+#define SIMD_NARROW_LEVEL(suffix, TARGET)    \
+SIMD_NARROW_KERNELS(1,  4, suffix, TARGET)   \
+SIMD_NARROW_KERNELS(2,  2, suffix, TARGET)   \
+SIMD_NARROW_KERNELS(4,  1, suffix, TARGET)   \
+SIMD_NARROW_KERNELS(8,  1, suffix, TARGET)   \
+SIMD_NARROW_KERNELS(16, 1, suffix, TARGET)
+
+SIMD_NARROW_LEVEL(scalar, )
+SIMD_NARROW_LEVEL(avx2,   AVX2_TARGET)
+SIMD_NARROW_LEVEL(avx512, AVX512_TARGET)
+
+static u32 simd_narrow_widths[SIMD_NARROW_WIDTH_COUNT] = {1, 2, 4, 8, 16};
+
+#define SIMD_NARROW_TABLE(kind, suffix) \
+  {kind##_1_##suffix, kind##_2_##suffix, kind##_4_##suffix, kind##_8_##suffix, kind##_16_##suffix}
+
+static Simd_CSR_Dense_Row *simd_csr_dense_row_narrow_kernels[SIMD_COUNT][SIMD_NARROW_WIDTH_COUNT] =
+{
+  [SIMD_SCALAR] = SIMD_NARROW_TABLE(csr_dense_row, scalar),
+  [SIMD_AVX2]   = SIMD_NARROW_TABLE(csr_dense_row, avx2),
+  [SIMD_AVX512] = SIMD_NARROW_TABLE(csr_dense_row, avx512),
+};
+
+static Simd_CSC_Dense_Col *simd_csc_dense_col_narrow_kernels[SIMD_COUNT][SIMD_NARROW_WIDTH_COUNT] =
+{
+  [SIMD_SCALAR] = SIMD_NARROW_TABLE(csc_dense_col, scalar),
+  [SIMD_AVX2]   = SIMD_NARROW_TABLE(csc_dense_col, avx2),
+  [SIMD_AVX512] = SIMD_NARROW_TABLE(csc_dense_col, avx512),
+};
+
+static
+Simd_CSR_Dense_Row *simd_csr_dense_row_kernel(usize right_col_count)
+{
+  Simd_CSR_Dense_Row *result = simd_csr_dense_row_kernels[simd_level()];
+
+  for (usize width_idx = 0; width_idx < SIMD_NARROW_WIDTH_COUNT; width_idx++)
+  {
+    if (simd_narrow_widths[width_idx] == right_col_count)
+    {
+      result = simd_csr_dense_row_narrow_kernels[simd_level()][width_idx];
+    }
+  }
+
+  return result;
+}
+
+static
+Simd_CSC_Dense_Col *simd_csc_dense_col_kernel(usize right_col_count)
+{
+  Simd_CSC_Dense_Col *result = simd_csc_dense_col_kernels[simd_level()];
+
+  for (usize width_idx = 0; width_idx < SIMD_NARROW_WIDTH_COUNT; width_idx++)
+  {
+    if (simd_narrow_widths[width_idx] == right_col_count)
+    {
+      result = simd_csc_dense_col_narrow_kernels[simd_level()][width_idx];
+    }
+  }
+
+  return result;
+}
+
+//
+// Dense X CSR row, indexed rather than contiguous
+//
+
+static
+void scatter_axpy_scalar(f64 *output_row, f64 scale, u32 *col_indices, f64 *values, usize count)
+{
+  for (usize i = 0; i < count; i++)
+  {
+    output_row[col_indices[i]] += scale * values[i];
+  }
+}
+
+// Column indices within a CSR row are unique, so lanes of a scatter never conflict
+AVX512_TARGET
+static
+void scatter_axpy_avx512(f64 *output_row, f64 scale, u32 *col_indices, f64 *values, usize count)
+{
+  __m512d scale_wide = _mm512_set1_pd(scale);
+
+  usize i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256i indices = _mm256_loadu_si256((__m256i *)(col_indices + i));
+
+    __m512d output = _mm512_i32gather_pd(indices, output_row, sizeof(f64));
+    output = _mm512_fmadd_pd(scale_wide, _mm512_loadu_pd(values + i), output);
+    _mm512_i32scatter_pd(output_row, indices, output, sizeof(f64));
+  }
+
+  for (; i < count; i++)
+  {
+    output_row[col_indices[i]] += scale * values[i];
+  }
+}
+
+// NOTE: AVX2 has gather but no scatter, so storing the lanes back one by one ends up no better
+// than scalar
+static Simd_Scatter_Axpy *simd_scatter_axpy_kernels[SIMD_COUNT] =
+{
+  [SIMD_SCALAR] = scatter_axpy_scalar,
+  [SIMD_AVX2]   = scatter_axpy_scalar,
+  [SIMD_AVX512] = scatter_axpy_avx512,
+};
+
+//
+// SELL chunk X Dense, one lane per row
+//
+
+static
+void sell_dense_chunk_scalar(f64 *output_values, usize output_col_count, u32 *rows, u32 lane_count,
+                             u32 *col_indices, f64 *values, usize width,
+                             f64 *right_values, usize right_col_count)
+{
+  for (usize lane = 0; lane < lane_count; lane++)
+  {
+    f64 *output_row = output_values + rows[lane] * output_col_count;
+
+    for (usize right_col = 0; right_col < right_col_count; right_col++)
+    {
+      output_row[right_col] = 0.0;
+    }
+
+    for (usize j = 0; j < width; j++)
+    {
+      f64 value = values[j * SELL_CHUNK_HEIGHT + lane];
+      f64 *right_row = right_values + col_indices[j * SELL_CHUNK_HEIGHT + lane] * right_col_count;
+
+      for (usize right_col = 0; right_col < right_col_count; right_col++)
+      {
+        output_row[right_col] += value * right_row[right_col];
+      }
+    }
+  }
+}
+
+_Static_assert(SELL_CHUNK_HEIGHT == 8, "SIMD SELL kernels assume a chunk is 8 f64 lanes");
+
+// Each accumulator is one output column of all 8 rows. The padding in a chunk is column 0 with
+// value 0.0 so gathers can run blind, only the stores have to skip the lanes past the matrix
+AVX2_TARGET
+static
+void sell_dense_chunk_avx2(f64 *output_values, usize output_col_count, u32 *rows, u32 lane_count,
+                           u32 *col_indices, f64 *values, usize width,
+                           f64 *right_values, usize right_col_count)
+{
+  // Two halves of 4 lanes per column, so half the tile of the AVX-512 version
+  usize tile_width = AVX2_TILE_REGISTERS / 2;
+  __m256i stride = _mm256_set1_epi32((int)right_col_count);
+
+  usize col = 0;
+  while (col < right_col_count)
+  {
+    usize tile_count = MIN(tile_width, right_col_count - col);
+
+    __m256d low_accumulators[AVX2_TILE_REGISTERS / 2];
+    __m256d high_accumulators[AVX2_TILE_REGISTERS / 2];
+    for (usize t = 0; t < tile_width; t++)
+    {
+      low_accumulators[t]  = _mm256_setzero_pd();
+      high_accumulators[t] = _mm256_setzero_pd();
+    }
+
+    for (usize j = 0; j < width; j++)
+    {
+      __m256i right_offsets = _mm256_mullo_epi32(_mm256_loadu_si256((__m256i *)(col_indices + j * SELL_CHUNK_HEIGHT)), stride);
+      __m128i low_offsets   = _mm256_castsi256_si128(right_offsets);
+      __m128i high_offsets  = _mm256_extracti128_si256(right_offsets, 1);
+
+      __m256d low_values  = _mm256_loadu_pd(values + j * SELL_CHUNK_HEIGHT);
+      __m256d high_values = _mm256_loadu_pd(values + j * SELL_CHUNK_HEIGHT + 4);
+
+      for (usize t = 0; t < tile_count; t++)
+      {
+        f64 *right_col = right_values + col + t;
+        low_accumulators[t]  = _mm256_fmadd_pd(low_values, _mm256_i32gather_pd(right_col, low_offsets, sizeof(f64)),
+                                               low_accumulators[t]);
+        high_accumulators[t] = _mm256_fmadd_pd(high_values, _mm256_i32gather_pd(right_col, high_offsets, sizeof(f64)),
+                                               high_accumulators[t]);
+      }
+    }
+
+    // No scatter in AVX2
+    for (usize t = 0; t < tile_count; t++)
+    {
+      f64 lanes[SELL_CHUNK_HEIGHT];
+      _mm256_storeu_pd(lanes, low_accumulators[t]);
+      _mm256_storeu_pd(lanes + 4, high_accumulators[t]);
+
+      for (usize lane = 0; lane < lane_count; lane++)
+      {
+        output_values[rows[lane] * output_col_count + col + t] = lanes[lane];
+      }
+    }
+
+    col += tile_count;
+  }
+}
+
+AVX512_TARGET
+static
+void sell_dense_chunk_avx512(f64 *output_values, usize output_col_count, u32 *rows, u32 lane_count,
+                             u32 *col_indices, f64 *values, usize width,
+                             f64 *right_values, usize right_col_count)
+{
+  __mmask8 lanes = (__mmask8)((1u << lane_count) - 1);
+  __m256i stride = _mm256_set1_epi32((int)right_col_count);
+  __m256i output_offsets = _mm256_mullo_epi32(_mm256_loadu_si256((__m256i *)rows),
+                                              _mm256_set1_epi32((int)output_col_count));
+
+  usize col = 0;
+  while (col < right_col_count)
+  {
+    usize tile_count = MIN(AVX512_TILE_REGISTERS, right_col_count - col);
+
+    __m512d accumulators[AVX512_TILE_REGISTERS];
+    for (usize t = 0; t < AVX512_TILE_REGISTERS; t++)
+    {
+      accumulators[t] = _mm512_setzero_pd();
+    }
+
+    for (usize j = 0; j < width; j++)
+    {
+      __m256i right_offsets = _mm256_mullo_epi32(_mm256_loadu_si256((__m256i *)(col_indices + j * SELL_CHUNK_HEIGHT)), stride);
+      __m512d left_values   = _mm512_loadu_pd(values + j * SELL_CHUNK_HEIGHT);
+
+      for (usize t = 0; t < tile_count; t++)
+      {
+        accumulators[t] = _mm512_fmadd_pd(left_values, _mm512_i32gather_pd(right_offsets, right_values + col + t, sizeof(f64)),
+                                          accumulators[t]);
+      }
+    }
+
+    for (usize t = 0; t < tile_count; t++)
+    {
+      _mm512_mask_i32scatter_pd(output_values + col + t, lanes, output_offsets, accumulators[t], sizeof(f64));
+    }
+
+    col += tile_count;
+  }
+}
+
+static Simd_SELL_Dense_Chunk *simd_sell_dense_chunk_kernels[SIMD_COUNT] =
+{
+  [SIMD_SCALAR] = sell_dense_chunk_scalar,
+  [SIMD_AVX2]   = sell_dense_chunk_avx2,
+  [SIMD_AVX512] = sell_dense_chunk_avx512,
+};
+
+//
+// Sorted index intersection
+//
+
+// Two cursors, step whichever is behind, both on a match. Branch free apart from the loop
+static
+f64 sorted_dot_scalar(u32 *left_indices, f64 *left_values, usize left_count,
+                      u32 *right_indices, f64 *right_values, usize right_count,
+                      u64 *out_match_count)
+{
+  f64 result = 0.0;
+  u64 match_count = 0;
+
+  usize l = 0, r = 0;
+  while (l < left_count && r < right_count)
+  {
+    u32 left_index  = left_indices[l];
+    u32 right_index = right_indices[r];
+
+    b32 match = left_index == right_index;
+    result      += match ? left_values[l] * right_values[r] : 0.0;
+    match_count += match;
+
+    l += left_index <= right_index;
+    r += right_index <= left_index;
+  }
+
+  *out_match_count += match_count;
+
+  return result;
+}
+
+// Eight from each side at a time, every left lane against every right lane by rotating the right
+// block through all eight positions. Since both are sorted and unique, the nth match on the left
+// pairs with the nth on the right. Then drop whichever block ends lower, or both if they tie
+AVX2_TARGET
+static
+f64 sorted_dot_avx2(u32 *left_indices, f64 *left_values, usize left_count,
+                    u32 *right_indices, f64 *right_values, usize right_count,
+                    u64 *out_match_count)
+{
+  f64 result = 0.0;
+  u64 match_count = 0;
+
+  __m256i lanes  = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+  __m256i seven  = _mm256_set1_epi32(7);
+
+  usize l = 0, r = 0;
+  while (l + 8 <= left_count && r + 8 <= right_count)
+  {
+    __m256i left_block = _mm256_loadu_si256((__m256i *)(left_indices + l));
+    __m256i rotated    = _mm256_loadu_si256((__m256i *)(right_indices + r));
+
+    __m256i left_hits  = _mm256_setzero_si256();
+    __m256i right_hits = _mm256_setzero_si256();
+    for (int k = 0; k < 8; k++)
+    {
+      __m256i equal = _mm256_cmpeq_epi32(left_block, rotated);
+      left_hits = _mm256_or_si256(left_hits, equal);
+
+      // Lane i compared against right lane (i + k) % 8, so rotate back onto the right's lanes
+      __m256i back = _mm256_and_si256(_mm256_sub_epi32(lanes, _mm256_set1_epi32(k)), seven);
+      right_hits = _mm256_or_si256(right_hits, _mm256_permutevar8x32_epi32(equal, back));
+
+      rotated = _mm256_permutevar8x32_epi32(rotated, rotate);
+    }
+
+    u32 left_mask  = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(left_hits));
+    u32 right_mask = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(right_hits));
+
+    while (left_mask)
+    {
+      result += left_values[l + __builtin_ctz(left_mask)] * right_values[r + __builtin_ctz(right_mask)];
+      match_count += 1;
+
+      left_mask  &= left_mask - 1;
+      right_mask &= right_mask - 1;
+    }
+
+    u32 left_last  = left_indices[l + 7];
+    u32 right_last = right_indices[r + 7];
+    l += left_last  <= right_last ? 8 : 0;
+    r += right_last <= left_last  ? 8 : 0;
+  }
+
+  *out_match_count += match_count;
+
+  // gcc doesn't clear the upper halves on its own before calling into the non VEX scalar tail,
+  // and the SSE/AVX transition that leaves costs more than small pairs take altogether
+  _mm256_zeroupper();
+
+  // Fewer than 8 left on one side
+  result += sorted_dot_scalar(left_indices + l, left_values + l, left_count - l,
+                              right_indices + r, right_values + r, right_count - r, out_match_count);
+
+  return result;
+}
+
+// NOTE: 16 wide without AVX-512CD's conflict detection means 16 rotations a side, twice the
+// compares for twice the lanes, so AVX-512 sticks with the 8 wide one
+static Simd_Sorted_Dot *simd_sorted_dot_kernels[SIMD_COUNT] =
+{
+  [SIMD_SCALAR] = sorted_dot_scalar,
+  [SIMD_AVX2]   = sorted_dot_avx2,
+  [SIMD_AVX512] = sorted_dot_avx2,
+};
+
+//
+// GEMM register tiles
+//
+
+#define GEMM_SCALAR_ROWS 4
+#define GEMM_SCALAR_COLS 4
+
+static
+void gemm_micro_scalar(usize depth, f64 *packed_left, f64 *packed_right,
+                       f64 *output, usize output_stride, b32 accumulate)
+{
+  f64 tile[GEMM_SCALAR_ROWS][GEMM_SCALAR_COLS] = {0};
+
+  for (usize k = 0; k < depth; k++)
+  {
+    f64 *left  = packed_left  + k * GEMM_SCALAR_ROWS;
+    f64 *right = packed_right + k * GEMM_SCALAR_COLS;
+
+    for (usize r = 0; r < GEMM_SCALAR_ROWS; r++)
+    {
+      for (usize c = 0; c < GEMM_SCALAR_COLS; c++)
+      {
+        tile[r][c] += left[r] * right[c];
+      }
+    }
+  }
+
+  for (usize r = 0; r < GEMM_SCALAR_ROWS; r++)
+  {
+    for (usize c = 0; c < GEMM_SCALAR_COLS; c++)
+    {
+      f64 *out = output + r * output_stride + c;
+      *out = accumulate ? *out + tile[r][c] : tile[r][c];
+    }
+  }
+}
+
+// 6x8, 12 accumulators plus the two right loads and a broadcast, out of 16 registers
+#define GEMM_AVX2_ROWS 6
+#define GEMM_AVX2_COLS 8
+
+AVX2_TARGET
+static
+void gemm_micro_avx2(usize depth, f64 *packed_left, f64 *packed_right,
+                     f64 *output, usize output_stride, b32 accumulate)
+{
+  __m256d accumulators[GEMM_AVX2_ROWS][2];
+  for (usize r = 0; r < GEMM_AVX2_ROWS; r++)
+  {
+    accumulators[r][0] = _mm256_setzero_pd();
+    accumulators[r][1] = _mm256_setzero_pd();
+  }
+
+  for (usize k = 0; k < depth; k++)
+  {
+    f64 *left = packed_left + k * GEMM_AVX2_ROWS;
+    __m256d right_0 = _mm256_loadu_pd(packed_right + k * GEMM_AVX2_COLS);
+    __m256d right_1 = _mm256_loadu_pd(packed_right + k * GEMM_AVX2_COLS + 4);
+
+    for (usize r = 0; r < GEMM_AVX2_ROWS; r++)
+    {
+      __m256d left_value = _mm256_broadcast_sd(left + r);
+      accumulators[r][0] = _mm256_fmadd_pd(left_value, right_0, accumulators[r][0]);
+      accumulators[r][1] = _mm256_fmadd_pd(left_value, right_1, accumulators[r][1]);
+    }
+  }
+
+  for (usize r = 0; r < GEMM_AVX2_ROWS; r++)
+  {
+    f64 *out = output + r * output_stride;
+    if (accumulate)
+    {
+      accumulators[r][0] = _mm256_add_pd(accumulators[r][0], _mm256_loadu_pd(out));
+      accumulators[r][1] = _mm256_add_pd(accumulators[r][1], _mm256_loadu_pd(out + 4));
+    }
+    _mm256_storeu_pd(out,     accumulators[r][0]);
+    _mm256_storeu_pd(out + 4, accumulators[r][1]);
+  }
+}
+
+// 8x16, 16 accumulators out of 32 registers
+#define GEMM_AVX512_ROWS 8
+#define GEMM_AVX512_COLS 16
+
+AVX512_TARGET
+static
+void gemm_micro_avx512(usize depth, f64 *packed_left, f64 *packed_right,
+                       f64 *output, usize output_stride, b32 accumulate)
+{
+  __m512d accumulators[GEMM_AVX512_ROWS][2];
+  for (usize r = 0; r < GEMM_AVX512_ROWS; r++)
+  {
+    accumulators[r][0] = _mm512_setzero_pd();
+    accumulators[r][1] = _mm512_setzero_pd();
+  }
+
+  for (usize k = 0; k < depth; k++)
+  {
+    f64 *left = packed_left + k * GEMM_AVX512_ROWS;
+    __m512d right_0 = _mm512_loadu_pd(packed_right + k * GEMM_AVX512_COLS);
+    __m512d right_1 = _mm512_loadu_pd(packed_right + k * GEMM_AVX512_COLS + 8);
+
+    for (usize r = 0; r < GEMM_AVX512_ROWS; r++)
+    {
+      __m512d left_value = _mm512_set1_pd(left[r]);
+      accumulators[r][0] = _mm512_fmadd_pd(left_value, right_0, accumulators[r][0]);
+      accumulators[r][1] = _mm512_fmadd_pd(left_value, right_1, accumulators[r][1]);
+    }
+  }
+
+  for (usize r = 0; r < GEMM_AVX512_ROWS; r++)
+  {
+    f64 *out = output + r * output_stride;
+    if (accumulate)
+    {
+      accumulators[r][0] = _mm512_add_pd(accumulators[r][0], _mm512_loadu_pd(out));
+      accumulators[r][1] = _mm512_add_pd(accumulators[r][1], _mm512_loadu_pd(out + 8));
+    }
+    _mm512_storeu_pd(out,     accumulators[r][0]);
+    _mm512_storeu_pd(out + 8, accumulators[r][1]);
+  }
+}
+
+static Simd_Gemm_Kernel simd_gemm_kernels[SIMD_COUNT] =
+{
+  [SIMD_SCALAR] = {gemm_micro_scalar, GEMM_SCALAR_ROWS, GEMM_SCALAR_COLS},
+  [SIMD_AVX2]   = {gemm_micro_avx2,   GEMM_AVX2_ROWS,   GEMM_AVX2_COLS},
+  [SIMD_AVX512] = {gemm_micro_avx512, GEMM_AVX512_ROWS, GEMM_AVX512_COLS},
+};
@@ -0,0 +1,84 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "../common.h"
+#include "formats.h"
+
+typedef enum Simd_Level
+{
+  SIMD_SCALAR,
+  SIMD_AVX2,   // Also requires FMA
+  SIMD_AVX512, // Just F
+
+  SIMD_COUNT,
+} Simd_Level;
+
+// output_row = sum of values[i] * (row col_indices[i] of right), over one CSR row's non zeros.
+// Overwrites output_row, so it doesn't need to be zeroed first. Right's rows are right_stride
+// apart and only the first right_col_count of each are used, so it can be a column panel
+typedef void Simd_CSR_Dense_Row(f64 *output_row, u32 *col_indices, f64 *values, usize count,
+                                f64 *right_values, usize right_stride, usize right_col_count);
+
+// (row row_indices[i] of output) += values[i] * right_row, over one CSC column's non zeros
+typedef void Simd_CSC_Dense_Col(f64 *output_values, usize output_col_count,
+                                u32 *row_indices, f64 *values, usize count,
+                                f64 *right_row, usize right_col_count);
+
+// output_row[col_indices[i]] += scale * values[i], over one CSR row's non zeros
+typedef void Simd_Scatter_Axpy(f64 *output_row, f64 scale, u32 *col_indices, f64 *values, usize count);
+
+// Rows rows[0..lane_count) of output = one SELL chunk X right, where entry j of each lane is at
+// j * SELL_CHUNK_HEIGHT + lane. Vectorized across the chunk's rows rather than along them, with
+// 32 bit gather/scatter offsets, so right and output need fewer than 2^31 values each.
+// Overwrites the rows, like the CSR row kernels
+typedef void Simd_SELL_Dense_Chunk(f64 *output_values, usize output_col_count, u32 *rows, u32 lane_count,
+                                   u32 *col_indices, f64 *values, usize width,
+                                   f64 *right_values, usize right_col_count);
+
+// Sum of left_values[i] * right_values[j] over every left_indices[i] == right_indices[j]. Both
+// index lists sorted without repeats, like a CSR row and a CSC column. Adds the number of
+// matches to *out_match_count
+typedef f64 Simd_Sorted_Dot(u32 *left_indices, f64 *left_values, usize left_count,
+                            u32 *right_indices, f64 *right_values, usize right_count,
+                            u64 *out_match_count);
+
+// One register tile of a blocked GEMM. output (rows x cols, output_stride apart) = or += a sliver
+// of packed left (depth x rows, k major) X a sliver of packed right (depth x cols, k major).
+// Tile shape is per level, see simd_gemm_kernels[], and packing has to follow it
+typedef void Simd_Gemm_Micro(usize depth, f64 *packed_left, f64 *packed_right,
+                             f64 *output, usize output_stride, b32 accumulate);
+
+typedef struct Simd_Gemm_Kernel Simd_Gemm_Kernel;
+struct Simd_Gemm_Kernel
+{
+  Simd_Gemm_Micro *micro;
+  u32 tile_rows; // MR
+  u32 tile_cols; // NR
+};
+
+// Largest tile of any level, for scratch
+#define SIMD_GEMM_MAX_TILE_ROWS 8
+#define SIMD_GEMM_MAX_TILE_COLS 16
+
+static
+Simd_Level simd_level(void);
+
+// Right widths with a kernel of their own, see SIMD_NARROW_KERNELS
+#define SIMD_NARROW_WIDTH_COUNT 5
+
+// For right (or a panel of it) right_col_count wide, the fixed width kernel if there is one,
+// otherwise the level's general one
+static
+Simd_CSR_Dense_Row *simd_csr_dense_row_kernel(usize right_col_count);
+
+static
+Simd_CSC_Dense_Col *simd_csc_dense_col_kernel(usize right_col_count);
+
+static
+String simd_level_name(Simd_Level level);
+
+// Data/unified cache size in bytes, level 1 to 3
+static
+usize cpu_cache_size(u32 level);
+
+#endif // SIMD_H
@@ -0,0 +1,260 @@
+#include "sparse_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static
+u64 sparse_file_align(u64 offset)
+{
+  return (offset + SPARSE_FILE_ALIGNMENT - 1) & ~(u64)(SPARSE_FILE_ALIGNMENT - 1);
+}
+
+// Claims an aligned section after the cursor, returns its offset
+static
+u64 sparse_file_place(u64 *cursor, u64 size)
+{
+  u64 result = sparse_file_align(*cursor);
+  *cursor = result + size;
+
+  return result;
+}
+
+// Zero pads up to the section's offset first
+static
+b32 sparse_file_write_section(FILE *file, u64 *written, u64 offset, void *data, u64 size)
+{
+  static u8 zeros[SPARSE_FILE_ALIGNMENT] = {0};
+
+  b32 result = true;
+
+  while (result && *written < offset)
+  {
+    u64 pad_size = MIN(offset - *written, sizeof(zeros));
+    result = fwrite(zeros, 1, pad_size, file) == pad_size;
+    *written += pad_size;
+  }
+
+  if (result && size)
+  {
+    result = fwrite(data, 1, size, file) == size;
+    *written += size;
+  }
+
+  return result;
+}
+
+static
+b32 sparse_file_write(char *path, CSR_Matrix *csr, CSC_Matrix *csc)
+{
+  Sparse_File_Header header = {0};
+  MEM_COPY(header.magic, SPARSE_FILE_MAGIC, sizeof(header.magic));
+  header.version = SPARSE_FILE_VERSION;
+
+  u64 cursor = sizeof(header);
+
+  if (csr)
+  {
+    header.flags |= SPARSE_FILE_HAS_CSR;
+    header.row_count      = csr->row_count;
+    header.col_count      = csr->col_count;
+    header.non_zero_count = csr->non_zero_count;
+
+    header.csr_row_pointers_offset = sparse_file_place(&cursor, sizeof(u32) * ((u64)csr->row_count + 1));
+    header.csr_col_indices_offset  = sparse_file_place(&cursor, sizeof(u32) * (u64)csr->non_zero_count);
+    header.csr_values_offset       = sparse_file_place(&cursor, sizeof(f64) * (u64)csr->non_zero_count);
+  }
+
+  if (csc)
+  {
+    if (csr && (csc->row_count != csr->row_count || csc->col_count != csr->col_count ||
+                csc->non_zero_count != csr->non_zero_count))
+    {
+      LOG_ERROR("CSR and CSC written to %s aren't the same matrix", path);
+      return false;
+    }
+
+    header.flags |= SPARSE_FILE_HAS_CSC;
+    header.row_count      = csc->row_count;
+    header.col_count      = csc->col_count;
+    header.non_zero_count = csc->non_zero_count;
+
+    header.csc_col_pointers_offset = sparse_file_place(&cursor, sizeof(u32) * ((u64)csc->col_count + 1));
+    header.csc_row_indices_offset  = sparse_file_place(&cursor, sizeof(u32) * (u64)csc->non_zero_count);
+    header.csc_values_offset       = sparse_file_place(&cursor, sizeof(f64) * (u64)csc->non_zero_count);
+  }
+
+  header.file_size = sparse_file_align(cursor);
+
+  // Written off to the side then renamed, so nobody ever maps half a file
+  char temp_path[4096];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+  FILE *file = fopen(temp_path, "wb");
+  if (!file)
+  {
+    LOG_ERROR("Unable to open sparse file for writing: %s", temp_path);
+    return false;
+  }
+
+  u64 written = 0;
+  b32 result = sparse_file_write_section(file, &written, 0, &header, sizeof(header));
+
+  if (csr)
+  {
+    result = result && sparse_file_write_section(file, &written, header.csr_row_pointers_offset,
+                                                 csr->row_pointers, sizeof(u32) * ((u64)csr->row_count + 1));
+    result = result && sparse_file_write_section(file, &written, header.csr_col_indices_offset,
+                                                 csr->col_indices, sizeof(u32) * (u64)csr->non_zero_count);
+    result = result && sparse_file_write_section(file, &written, header.csr_values_offset,
+                                                 csr->values, sizeof(f64) * (u64)csr->non_zero_count);
+  }
+
+  if (csc)
+  {
+    result = result && sparse_file_write_section(file, &written, header.csc_col_pointers_offset,
+                                                 csc->col_pointers, sizeof(u32) * ((u64)csc->col_count + 1));
+    result = result && sparse_file_write_section(file, &written, header.csc_row_indices_offset,
+                                                 csc->row_indices, sizeof(u32) * (u64)csc->non_zero_count);
+    result = result && sparse_file_write_section(file, &written, header.csc_values_offset,
+                                                 csc->values, sizeof(f64) * (u64)csc->non_zero_count);
+  }
+
+  result = result && sparse_file_write_section(file, &written, header.file_size, NULL, 0);
+  result = (fclose(file) == 0) && result;
+
+  if (result)
+  {
+    result = rename(temp_path, path) == 0;
+  }
+
+  if (!result)
+  {
+    LOG_ERROR("Unable to write sparse file: %s", path);
+    remove(temp_path);
+  }
+
+  return result;
+}
+
+static
+b32 sparse_file_section_ok(Sparse_File_Header *header, u64 offset, u64 size)
+{
+  return offset >= sizeof(*header) &&
+         offset % SPARSE_FILE_ALIGNMENT == 0 &&
+         offset <= header->file_size &&
+         size <= header->file_size - offset; // Not offset + size, which a corrupt offset can wrap
+}
+
+static
+b32 sparse_file_map(char *path, Sparse_File *out_file, CSR_Matrix *out_csr, CSC_Matrix *out_csc)
+{
+  int file = open(path, O_RDONLY);
+  if (file < 0)
+  {
+    LOG_ERROR("Unable to open sparse file: %s", path);
+    return false;
+  }
+
+  struct stat file_stat = {0};
+  fstat(file, &file_stat);
+  usize file_size = file_stat.st_size;
+
+  u8 *mapping = file_size >= sizeof(Sparse_File_Header) ? mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, file, 0)
+                                                        : MAP_FAILED;
+  close(file);
+
+  if (mapping == MAP_FAILED)
+  {
+    LOG_ERROR("Unable to map sparse file: %s", path);
+    return false;
+  }
+
+  Sparse_File_Header *header = (Sparse_File_Header *)mapping;
+
+  b32 result = memcmp(header->magic, SPARSE_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+               header->version == SPARSE_FILE_VERSION &&
+               header->file_size == file_size &&
+               header->non_zero_count <= (u32)-1; // What CSR_Matrix and CSC_Matrix can hold
+
+  if (!result)
+  {
+    LOG_ERROR("Not a version %d sparse file, truncated, or over 2^32 non zeros: %s", SPARSE_FILE_VERSION, path);
+  }
+
+  if (result && out_csr)
+  {
+    CSR_Matrix csr =
+    {
+      .non_zero_count = header->non_zero_count,
+      .row_count      = header->row_count,
+      .col_count      = header->col_count,
+      .row_pointers   = (u32 *)(mapping + header->csr_row_pointers_offset),
+      .col_indices    = (u32 *)(mapping + header->csr_col_indices_offset),
+      .values         = (f64 *)(mapping + header->csr_values_offset),
+    };
+
+    result = (header->flags & SPARSE_FILE_HAS_CSR) &&
+             sparse_file_section_ok(header, header->csr_row_pointers_offset, sizeof(u32) * ((u64)csr.row_count + 1)) &&
+             sparse_file_section_ok(header, header->csr_col_indices_offset, sizeof(u32) * (u64)csr.non_zero_count) &&
+             sparse_file_section_ok(header, header->csr_values_offset, sizeof(f64) * (u64)csr.non_zero_count) &&
+             csr.row_pointers[csr.row_count] == csr.non_zero_count;
+
+    if (!result)
+    {
+      LOG_ERROR("Sparse file %s has no valid CSR section", path);
+    }
+
+    *out_csr = csr;
+  }
+
+  if (result && out_csc)
+  {
+    CSC_Matrix csc =
+    {
+      .non_zero_count = header->non_zero_count,
+      .row_count      = header->row_count,
+      .col_count      = header->col_count,
+      .row_indices    = (u32 *)(mapping + header->csc_row_indices_offset),
+      .col_pointers   = (u32 *)(mapping + header->csc_col_pointers_offset),
+      .values         = (f64 *)(mapping + header->csc_values_offset),
+    };
+
+    result = (header->flags & SPARSE_FILE_HAS_CSC) &&
+             sparse_file_section_ok(header, header->csc_col_pointers_offset, sizeof(u32) * ((u64)csc.col_count + 1)) &&
+             sparse_file_section_ok(header, header->csc_row_indices_offset, sizeof(u32) * (u64)csc.non_zero_count) &&
+             sparse_file_section_ok(header, header->csc_values_offset, sizeof(f64) * (u64)csc.non_zero_count) &&
+             csc.col_pointers[csc.col_count] == csc.non_zero_count;
+
+    if (!result)
+    {
+      LOG_ERROR("Sparse file %s has no valid CSC section", path);
+    }
+
+    *out_csc = csc;
+  }
+
+  if (result)
+  {
+    out_file->mapping = mapping;
+    out_file->size    = file_size;
+  }
+  else
+  {
+    munmap(mapping, file_size);
+  }
+
+  return result;
+}
+
+static
+void sparse_file_unmap(Sparse_File *file)
+{
+  if (file->mapping)
+  {
+    munmap(file->mapping, file->size);
+  }
+
+  *file = (Sparse_File){0};
+}
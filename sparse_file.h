@@ -0,0 +1,70 @@
+#ifndef SPARSE_FILE_H
+#define SPARSE_FILE_H
+
+#include "../common.h"
+#include "formats.h"
+
+// Binary CSR and/or CSC of one matrix, laid out so that mapping the file is all it takes to load
+// it. The structs from formats.h point straight into the mapping, nothing is copied or parsed.
+//
+// [header][csr row_pointers][csr col_indices][csr values][csc col_pointers][csc row_indices][csc values]
+//
+// Every section starts on a SPARSE_FILE_ALIGNMENT boundary, all little endian like the machine
+
+#define SPARSE_FILE_MAGIC     "SPMMSPRS"
+#define SPARSE_FILE_VERSION   1
+#define SPARSE_FILE_ALIGNMENT 64
+#define SPARSE_FILE_EXTENSION ".spmm"
+
+typedef enum Sparse_File_Flags
+{
+  SPARSE_FILE_HAS_CSR = 1 << 0,
+  SPARSE_FILE_HAS_CSC = 1 << 1,
+} Sparse_File_Flags;
+
+typedef struct Sparse_File_Header Sparse_File_Header;
+struct Sparse_File_Header
+{
+  u8  magic[8];
+  u32 version;
+  u32 flags;
+
+  u32 row_count;
+  u32 col_count;
+  u64 non_zero_count;
+
+  // Byte offsets from the start of the file, 0 if the section isn't there
+  u64 csr_row_pointers_offset;
+  u64 csr_col_indices_offset;
+  u64 csr_values_offset;
+  u64 csc_col_pointers_offset;
+  u64 csc_row_indices_offset;
+  u64 csc_values_offset;
+
+  u64 file_size;
+
+  u8 reserved[40]; // Pads out to two cache lines, for whatever version 2 needs
+};
+
+_Static_assert(sizeof(Sparse_File_Header) == 2 * SPARSE_FILE_ALIGNMENT, "Header should stay 128 bytes");
+
+typedef struct Sparse_File Sparse_File;
+struct Sparse_File
+{
+  u8   *mapping;
+  usize size;
+};
+
+// Either may be NULL, but not both
+static
+b32 sparse_file_write(char *path, CSR_Matrix *csr, CSC_Matrix *csc);
+
+// Read only mapping, the matrices are only valid until sparse_file_unmap(). Either out may be
+// NULL, fails if the file lacks a section that was asked for
+static
+b32 sparse_file_map(char *path, Sparse_File *out_file, CSR_Matrix *out_csr, CSC_Matrix *out_csc);
+
+static
+void sparse_file_unmap(Sparse_File *file);
+
+#endif // SPARSE_FILE_H
@@ -0,0 +1,252 @@
+#include "spgemm.h"
+
+// Columns within a row are unique, so no need to worry about equal keys
+static
+void sort_cols_values(u32 *cols, f64 *values, u32 count)
+{
+  // Quicksort down to small partitions, recursing into the smaller side to bound the stack
+  while (count > 32)
+  {
+    u32 middle = (count - 1) / 2;
+    u32 pivot  = cols[middle];
+
+    isize i = -1;
+    isize j = count;
+    for (;;)
+    {
+      do { i++; } while (cols[i] < pivot);
+      do { j--; } while (cols[j] > pivot);
+
+      if (i >= j)
+      {
+        break;
+      }
+
+      u32 col = cols[i];  cols[i]   = cols[j];   cols[j]   = col;
+      f64 value = values[i]; values[i] = values[j]; values[j] = value;
+    }
+
+    u32 low_count  = (u32)j + 1;
+    u32 high_count = count - low_count;
+
+    if (low_count < high_count)
+    {
+      sort_cols_values(cols, values, low_count);
+      cols   += low_count;
+      values += low_count;
+      count   = high_count;
+    }
+    else
+    {
+      sort_cols_values(cols + low_count, values + low_count, high_count);
+      count = low_count;
+    }
+  }
+
+  for (u32 i = 1; i < count; i++)
+  {
+    u32 col   = cols[i];
+    f64 value = values[i];
+
+    u32 j = i;
+    while (j > 0 && cols[j - 1] > col)
+    {
+      cols[j]   = cols[j - 1];
+      values[j] = values[j - 1];
+      j -= 1;
+    }
+
+    cols[j]   = col;
+    values[j] = value;
+  }
+}
+
+static
+b32 spgemm_use_hash(u32 row_upper_bound, u32 width)
+{
+  return (u64)row_upper_bound * SPGEMM_HASH_WIDTH_RATIO < width;
+}
+
+static
+Dense_Accumulator dense_accumulator_make(Arena *arena, u32 width)
+{
+  Dense_Accumulator result =
+  {
+    .width     = width,
+    .stamp     = 1,
+    .marks     = arena_calloc(arena, width, u32),
+    .values    = arena_calloc(arena, width, f64),
+    .live_cols = arena_calloc(arena, width, u32),
+  };
+
+  return result;
+}
+
+static
+f64 *dense_accumulator_slot(Dense_Accumulator *accumulator, u32 col)
+{
+  if (accumulator->marks[col] != accumulator->stamp)
+  {
+    accumulator->marks[col]  = accumulator->stamp;
+    accumulator->values[col] = 0.0;
+
+    accumulator->live_cols[accumulator->live_count] = col;
+    accumulator->live_count += 1;
+  }
+
+  return accumulator->values + col;
+}
+
+static
+u32 dense_accumulator_flush(Dense_Accumulator *accumulator, u32 *out_cols, f64 *out_values)
+{
+  u32 count = accumulator->live_count;
+
+  // Dense enough that walking the marks in order beats sorting what we touched
+  if (!spgemm_use_hash(count, accumulator->width))
+  {
+    u32 out_index = 0;
+    for (u32 col = 0; col < accumulator->width; col++)
+    {
+      if (accumulator->marks[col] == accumulator->stamp)
+      {
+        out_cols[out_index]   = col;
+        out_values[out_index] = accumulator->values[col];
+        out_index += 1;
+      }
+    }
+  }
+  else
+  {
+    for (u32 i = 0; i < count; i++)
+    {
+      u32 col = accumulator->live_cols[i];
+      out_cols[i]   = col;
+      out_values[i] = accumulator->values[col];
+    }
+
+    sort_cols_values(out_cols, out_values, count);
+  }
+
+  accumulator->stamp += 1;
+  accumulator->live_count = 0;
+
+  return count;
+}
+
+// Just the count of columns touched, for when only the pattern matters
+static
+u32 dense_accumulator_clear(Dense_Accumulator *accumulator)
+{
+  u32 result = accumulator->live_count;
+
+  accumulator->stamp += 1;
+  accumulator->live_count = 0;
+
+  return result;
+}
+
+// At most half full so probes stay short
+static
+u32 hash_capacity_for(u32 row_upper_bound)
+{
+  u32 result = 16;
+  while (result < 2 * (u64)row_upper_bound)
+  {
+    result <<= 1;
+  }
+
+  return result;
+}
+
+static
+Hash_Accumulator hash_accumulator_make(Arena *arena, u32 max_row_upper_bound)
+{
+  u32 max_capacity = hash_capacity_for(max_row_upper_bound);
+
+  Hash_Accumulator result =
+  {
+    .max_capacity = max_capacity,
+    .keys         = arena_calloc(arena, max_capacity, u32),
+    .values       = arena_calloc(arena, max_capacity, f64),
+  };
+
+  return result;
+}
+
+static
+void hash_accumulator_begin_row(Hash_Accumulator *accumulator, u32 row_upper_bound)
+{
+  accumulator->capacity   = hash_capacity_for(row_upper_bound);
+  accumulator->shift      = 32 - __builtin_ctz(accumulator->capacity);
+  accumulator->live_count = 0;
+}
+
+static
+f64 *hash_accumulator_slot(Hash_Accumulator *accumulator, u32 col)
+{
+  u32 mask = accumulator->capacity - 1;
+  u32 key  = col + 1;
+
+  // Knuth's multiplicative hash, the top bits of the product are the ones every bit of col mixes
+  // into, the bottom k only depend on the bottom k of col
+  u32 slot = (col * 2654435761u) >> accumulator->shift;
+
+  for (;;)
+  {
+    u32 slot_key = accumulator->keys[slot];
+
+    if (slot_key == key)
+    {
+      break;
+    }
+
+    if (slot_key == 0)
+    {
+      accumulator->keys[slot]   = key;
+      accumulator->values[slot] = 0.0;
+      accumulator->live_count += 1;
+      break;
+    }
+
+    slot = (slot + 1) & mask;
+  }
+
+  return accumulator->values + slot;
+}
+
+// Also clears the table for the next row
+static
+u32 hash_accumulator_flush(Hash_Accumulator *accumulator, u32 *out_cols, f64 *out_values)
+{
+  u32 out_index = 0;
+  for (u32 slot = 0; slot < accumulator->capacity; slot++)
+  {
+    u32 key = accumulator->keys[slot];
+    if (key)
+    {
+      out_cols[out_index]   = key - 1;
+      out_values[out_index] = accumulator->values[slot];
+      out_index += 1;
+
+      accumulator->keys[slot] = 0;
+    }
+  }
+
+  sort_cols_values(out_cols, out_values, out_index);
+
+  accumulator->live_count = 0;
+
+  return out_index;
+}
+
+static
+u32 hash_accumulator_clear(Hash_Accumulator *accumulator)
+{
+  u32 result = accumulator->live_count;
+
+  MEM_SET(accumulator->keys, sizeof(u32) * accumulator->capacity, 0);
+  accumulator->live_count = 0;
+
+  return result;
+}
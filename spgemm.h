@@ -0,0 +1,86 @@
+#ifndef SPGEMM_H
+#define SPGEMM_H
+
+#include "../common.h"
+#include "formats.h"
+
+// Accumulators for Gustavson's row by row sparse output products. Each row of the output is
+// collected in one of these then flushed, sorted by column, into the output CSR
+
+// Rows whose upper bound on non zeros is less than (width / this) go through the hash table.
+// Otherwise the dense one, which touches less memory per product but spans the whole width
+#define SPGEMM_HASH_WIDTH_RATIO 16
+
+// Values indexed directly by column. Marks hold the stamp of the last row to touch the column,
+// so nothing needs to be cleared between rows
+typedef struct Dense_Accumulator Dense_Accumulator;
+struct Dense_Accumulator
+{
+  u32 width;
+  u32 stamp;
+
+  u32 *marks;
+  f64 *values;
+
+  u32 live_count;
+  u32 *live_cols; // Insertion order
+};
+
+// Open addressing, linear probing. Keys are col + 1 so that zeroed memory means empty
+typedef struct Hash_Accumulator Hash_Accumulator;
+struct Hash_Accumulator
+{
+  u32 max_capacity;
+  u32 capacity; // Power of 2, for the current row
+  u32 shift;    // 32 - log2(capacity), keeps the top bits of the hash
+  u32 live_count;
+
+  u32 *keys;
+  f64 *values;
+};
+
+// Same sparsity patterns get multiplied over and over with new values. The symbolic pass fixes
+// the output pattern once, then each numeric pass only refills the values
+typedef struct Spgemm_Plan Spgemm_Plan;
+struct Spgemm_Plan
+{
+  CSR_Matrix output;
+
+  // Output width, numeric pass scatters each row's products into here then gathers the pattern
+  f64 *workspace;
+};
+
+static
+Dense_Accumulator dense_accumulator_make(Arena *arena, u32 width);
+
+static
+f64 *dense_accumulator_slot(Dense_Accumulator *accumulator, u32 col);
+
+static
+u32 dense_accumulator_flush(Dense_Accumulator *accumulator, u32 *out_cols, f64 *out_values);
+
+static
+u32 dense_accumulator_clear(Dense_Accumulator *accumulator);
+
+static
+Hash_Accumulator hash_accumulator_make(Arena *arena, u32 max_row_upper_bound);
+
+static
+void hash_accumulator_begin_row(Hash_Accumulator *accumulator, u32 row_upper_bound);
+
+static
+f64 *hash_accumulator_slot(Hash_Accumulator *accumulator, u32 col);
+
+static
+u32 hash_accumulator_flush(Hash_Accumulator *accumulator, u32 *out_cols, f64 *out_values);
+
+static
+u32 hash_accumulator_clear(Hash_Accumulator *accumulator);
+
+static
+b32 spgemm_use_hash(u32 row_upper_bound, u32 width);
+
+static
+void sort_cols_values(u32 *cols, f64 *values, u32 count);
+
+#endif // SPGEMM_H
@@ -0,0 +1,232 @@
+// libspmm, the one translation unit of libspmm.a. See spmm.h
+#define LOG_TITLE "SPMM"
+#define SPMM_LIBRARY
+
+#include "../common.h"
+#include "formats.h"
+#include "formats.c"
+#include "threads.h"
+#include "threads.c"
+#include "simd.h"
+#include "simd.c"
+#include "spgemm.h"
+#include "spgemm.c"
+#include "gemm.h"
+#include "gemm.c"
+#include "reorder.h"
+#include "reorder.c"
+#include "spmm.h"
+#include "kernels.h"
+#include "kernels.c"
+#include "batch.h"
+#include "batch.c"
+
+struct Spmm_Plan
+{
+  Operation_Parameters params;
+  Auto_Candidate *candidate;
+};
+
+// Full pointers for every row (column) from a doubly compressed format's pointers for the non
+// empty ones. Indices and values need no change
+static
+u32 *spmm_expand_pointers(Arena *arena, u32 major_count, u32 *ids, u32 *pointers, u32 non_empty_count)
+{
+  u32 *result = arena_calloc(arena, (usize)major_count + 1, u32);
+
+  u32 non_empty = 0;
+  for (u32 major = 0; major <= major_count; major++)
+  {
+    while (non_empty < non_empty_count && ids[non_empty] < major)
+    {
+      non_empty += 1;
+    }
+
+    result[major] = pointers[non_empty];
+  }
+
+  return result;
+}
+
+// Everything the cost model and auto_convert() go from is the CSR, so every operand gets one. Its
+// arrays are shared with the operand wherever the layout already matches
+static
+b32 spmm_operand_from(Arena *arena, Thread_Pool *pool, Matrix_Union *operand, Matrix_Reps *out)
+{
+  Matrix_Reps result = {0};
+
+  switch (operand->format)
+  {
+    case MAT_DENSE:
+    {
+      result.dense = operand->dense;
+      result.csr   = csr_from_dense(arena, &operand->dense);
+    } break;
+    case MAT_CSR:
+    {
+      result.csr = operand->csr;
+    } break;
+    case MAT_CSC:
+    {
+      result.csc = operand->csc;
+      result.csr = csr_from_csc(arena, pool, &operand->csc);
+    } break;
+    case MAT_DCSR:
+    {
+      DCSR_Matrix dcsr = operand->dcsr;
+
+      result.dcsr = dcsr;
+      result.csr  = (CSR_Matrix)
+      {
+        .non_zero_count = dcsr.non_zero_count,
+        .row_count      = dcsr.row_count,
+        .col_count      = dcsr.col_count,
+        .row_pointers   = spmm_expand_pointers(arena, dcsr.row_count, dcsr.row_ids, dcsr.row_pointers,
+                                               dcsr.non_empty_row_count),
+        .col_indices    = dcsr.col_indices,
+        .values         = dcsr.values,
+      };
+    } break;
+    case MAT_DCSC:
+    {
+      DCSC_Matrix dcsc = operand->dcsc;
+
+      result.dcsc = dcsc;
+      result.csc  = (CSC_Matrix)
+      {
+        .non_zero_count = dcsc.non_zero_count,
+        .row_count      = dcsc.row_count,
+        .col_count      = dcsc.col_count,
+        .row_indices    = dcsc.row_indices,
+        .col_pointers   = spmm_expand_pointers(arena, dcsc.col_count, dcsc.col_ids, dcsc.col_pointers,
+                                               dcsc.non_empty_col_count),
+        .values         = dcsc.values,
+      };
+      result.csr = csr_from_csc(arena, pool, &result.csc);
+    } break;
+    case MAT_COO:
+    {
+      COO_Matrix coo = operand->coo;
+
+      // Already sorted by row, so it's only the pointers
+      u32 *row_pointers = arena_calloc(arena, (usize)coo.row_count + 1, u32);
+      for (u32 i = 0; i < coo.non_zero_count; i++)
+      {
+        row_pointers[coo.row_indices[i] + 1] += 1;
+      }
+      for (u32 row = 0; row < coo.row_count; row++)
+      {
+        row_pointers[row + 1] += row_pointers[row];
+      }
+
+      result.coo = coo;
+      result.csr = (CSR_Matrix)
+      {
+        .non_zero_count = coo.non_zero_count,
+        .row_count      = coo.row_count,
+        .col_count      = coo.col_count,
+        .row_pointers   = row_pointers,
+        .col_indices    = coo.col_indices,
+        .values         = coo.values,
+      };
+    } break;
+    default:
+    {
+      LOG_ERROR("spmm_plan() takes dense, CSR, CSC, DCSR, DCSC or COO operands");
+      return false;
+    } break;
+  }
+
+  *out = result;
+
+  return true;
+}
+
+Spmm_Plan *spmm_plan(Arena *arena, Thread_Pool *pool, Matrix_Union *left, Matrix_Union *right)
+{
+  Spmm_Plan *result = arena_calloc(arena, 1, Spmm_Plan);
+
+  Operation_Parameters *params = &result->params;
+  params->arena = arena;
+  params->pool  = pool;
+
+  if (!spmm_operand_from(arena, pool, left, &params->left) ||
+      !spmm_operand_from(arena, pool, right, &params->right))
+  {
+    return NULL;
+  }
+
+  if (params->left.csr.col_count != params->right.csr.row_count)
+  {
+    LOG_ERROR("Can't multiply %ux%u by %ux%u", params->left.csr.row_count, params->left.csr.col_count,
+              params->right.csr.row_count, params->right.csr.col_count);
+    return NULL;
+  }
+
+  Spmm_Shape shape = spmm_shape_from(params);
+  u32 left_held  = spmm_held_formats(&params->left);
+  u32 right_held = spmm_held_formats(&params->right);
+
+  // Same pick as spmm_auto_choose(), less the one kernel with a sparse output
+  f64 best = 0.0;
+  for (usize candidate_idx = 0; candidate_idx < AUTO_CANDIDATE_COUNT; candidate_idx++)
+  {
+    Auto_Candidate *candidate = &spmm_auto_candidates[candidate_idx];
+    if (candidate->function == spmm_matmul_csr_csr_sparse)
+    {
+      continue;
+    }
+
+    f64 estimate = auto_estimate(candidate, &shape, left_held, right_held);
+    if (!result->candidate || estimate < best)
+    {
+      best = estimate;
+      result->candidate = candidate;
+    }
+  }
+
+  auto_convert(params, &params->left,  result->candidate->left);
+  auto_convert(params, &params->right, result->candidate->right);
+
+  // And the scratch the two kernels that have any would make on their first call, so execute
+  // never allocates
+  if (result->candidate->function == spmm_matmul_dense_dense_blocked)
+  {
+    params_gemm_workspace(params);
+  }
+  else if (result->candidate->function == spmm_matmul_csr_csc_adaptive)
+  {
+    params_intersect_lookup(params);
+  }
+
+  return result;
+}
+
+void spmm_execute(Spmm_Plan *plan, Dense_Matrix output)
+{
+  Operation_Parameters *params = &plan->params;
+  params->output = output;
+
+  // Most of the kernels accumulate into what's there
+  MEM_SET(output.values, sizeof(f64) * output.row_count * output.col_count, 0);
+
+  plan->candidate->function(NULL, params);
+}
+
+void spmm_set_ceilings(f64 flops_per_tick, f64 bytes_per_tick)
+{
+  if (flops_per_tick)
+  {
+    roofline_ceilings.flops_per_tick = flops_per_tick;
+  }
+
+  if (bytes_per_tick)
+  {
+    roofline_ceilings.bytes_per_tick = bytes_per_tick;
+  }
+}
+
+void spmm_set_tester_hooks(Spmm_Tester_Hooks hooks)
+{
+  spmm_tester_hooks = hooks;
+}
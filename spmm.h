@@ -0,0 +1,52 @@
+#ifndef SPMM_H
+#define SPMM_H
+
+#include "../common.h"
+#include "formats.h"
+#include "threads.h"
+
+// libspmm, the kernels in kernels.c and the batch in batch.c, built -O3 -march=native into
+// libspmm.a by `make libspmm`. These are its interface for applications. kernels.h and batch.h
+// are the benchmark's, which links the same build to time every kernel on its own. It leaves
+// common.h's implementation to whatever links it, which needs an Arena to call in anyway.
+//
+// Plan once per pair of operands, then execute repeatedly only while the operand values are
+// unchanged, re-plan otherwise:
+//
+//   Spmm_Plan *plan = spmm_plan(&arena, pool, &left, &right);
+//   spmm_execute(plan, output);
+//
+// Planning picks a kernel with the same cost model as spmm_auto and builds whatever format it
+// reads, so none of that is paid again per execute. Those copies are what execute reads, which
+// is why new values need a new plan
+typedef struct Spmm_Plan Spmm_Plan;
+
+// Operands can come as dense, CSR, CSC, DCSR, DCSC or COO. BCSR and SELL are only ever built from
+// a CSR here, so pass that instead. Their arrays are read, not copied, and have to outlive the
+// plan, which along with every conversion and the chosen kernel's scratch goes in arena, so
+// execute allocates nothing. NULL if the operands can't be multiplied
+Spmm_Plan *spmm_plan(Arena *arena, Thread_Pool *pool, Matrix_Union *left, Matrix_Union *right);
+
+// output = left X right, overwritten, left.row_count x right.col_count. One at a time per plan,
+// some kernels keep scratch in it
+void spmm_execute(Spmm_Plan *plan, Dense_Matrix output);
+
+// Flops and bytes per timer tick the cost model weighs kernels against. Only the ratio between
+// them matters for which kernel gets picked. Without a call, or for either one left 0, the ratio
+// from the dev machine
+void spmm_set_ceilings(f64 flops_per_tick, f64 bytes_per_tick);
+
+// How the kernels time and count themselves into the tester the benchmark hands them, which
+// they only ever pass back here. Unset, or for the NULL tester spmm_execute() passes, nothing
+// happens. Counts only come from libspmm_observe.a, built with OBSERVE_FLOPS/OBSERVE_MEMOPS
+typedef struct Spmm_Tester_Hooks Spmm_Tester_Hooks;
+struct Spmm_Tester_Hooks
+{
+  void (*begin_time)(void *tester);
+  void (*close_time)(void *tester);
+  void (*count)(void *tester, u64 flops, u64 memops, u64 bytes);
+};
+
+void spmm_set_tester_hooks(Spmm_Tester_Hooks hooks);
+
+#endif // SPMM_H
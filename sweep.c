@@ -0,0 +1,316 @@
+#include "sweep.h"
+
+#include <math.h>
+#include <unistd.h>
+
+// Everything through entry, the cell's key
+#define SWEEP_KEY_COLUMN_COUNT 6
+
+static char sweep_header[] =
+  "row_count,col_count,inner_count,density,thread_count,entry,"
+  "left_non_zero_count,right_non_zero_count,output_non_zero_count,"
+  "repeat_count,min,mean,max,stddev,flops,memops,bytes,counted_flops,counted_memops,counted_bytes,timer_frequency";
+
+// Whole file, NUL terminated. NULL if it can't be read
+static
+char *sweep_read_file(Arena *arena, char *path, u64 *out_size)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file)
+  {
+    return NULL;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  char *result = arena_calloc(arena, MAX(size, 0) + 1, char);
+  if (size > 0 && fread(result, 1, size, file) != (usize)size)
+  {
+    result = NULL;
+  }
+
+  fclose(file);
+
+  *out_size = MAX(size, 0);
+  return result;
+}
+
+static
+u64 sweep_count_char(char *string, char c)
+{
+  u64 result = 0;
+  for (char *at = string; *at; at++)
+  {
+    result += *at == c;
+  }
+
+  return result;
+}
+
+static
+b32 sweep_config_load(Arena *arena, char *path, Sweep_Config *out)
+{
+  u64 size = 0;
+  char *text = sweep_read_file(arena, path, &size);
+  if (!text)
+  {
+    LOG_ERROR("Unable to read sweep config: %s", path);
+    return false;
+  }
+
+  Sweep_Config config = {0};
+
+  struct
+  {
+    char *key;
+    Sweep_List *list;
+  } lists[] =
+  {
+    {"rows",      &config.rows},
+    {"inners",    &config.inners},
+    {"cols",      &config.cols},
+    {"aspects",   &config.aspects},
+    {"densities", &config.densities},
+    {"threads",   &config.threads},
+  };
+
+  b32 result = true;
+
+  char *line_state = NULL;
+  for (char *line = strtok_r(text, "\n", &line_state); line; line = strtok_r(NULL, "\n", &line_state))
+  {
+    char *comment = strchr(line, '#');
+    if (comment)
+    {
+      *comment = '\0';
+    }
+
+    char *equals = strchr(line, '=');
+    if (!equals)
+    {
+      if (strspn(line, " \t\r") != strlen(line))
+      {
+        LOG_ERROR("Sweep config line without '=': %s", line);
+        result = false;
+      }
+      continue;
+    }
+    *equals = '\0';
+
+    char *value_state = NULL;
+    char *key = strtok_r(line, " \t\r", &value_state);
+    if (!key)
+    {
+      LOG_ERROR("Sweep config line without a key");
+      result = false;
+      continue;
+    }
+
+    Sweep_List *list = NULL;
+    for (usize i = 0; i < STATIC_COUNT(lists); i++)
+    {
+      if (strcmp(key, lists[i].key) == 0)
+      {
+        list = lists[i].list;
+      }
+    }
+
+    b32 is_entries = strcmp(key, "entries") == 0;
+    b32 is_seconds = strcmp(key, "seconds") == 0;
+    if (!list && !is_entries && !is_seconds)
+    {
+      LOG_ERROR("Unknown sweep config key: %s", key);
+      result = false;
+      continue;
+    }
+
+    value_state = NULL;
+    for (char *value = strtok_r(equals + 1, " \t\r,", &value_state); value;
+         value = strtok_r(NULL, " \t\r,", &value_state))
+    {
+      if (is_entries)
+      {
+        if (config.entry_count < SWEEP_MAX_VALUES)
+        {
+          config.entries[config.entry_count++] = value;
+        }
+        continue;
+      }
+
+      char *end = NULL;
+      f64 number = strtod(value, &end);
+      if (*end || number < 0)
+      {
+        LOG_ERROR("Bad sweep config value for %s: %s", key, value);
+        result = false;
+        continue;
+      }
+
+      if (is_seconds)
+      {
+        config.seconds = (u32)number;
+      }
+      else if (list->count < SWEEP_MAX_VALUES)
+      {
+        list->v[list->count++] = number;
+      }
+    }
+  }
+
+  if (!config.rows.count || !config.inners.count || !config.densities.count ||
+      !(config.cols.count || config.aspects.count))
+  {
+    LOG_ERROR("Sweep config needs rows, inners, densities, and cols or aspects");
+    result = false;
+  }
+
+  if (!config.threads.count)
+  {
+    config.threads.v[config.threads.count++] = 1;
+  }
+
+  *out = config;
+
+  return result;
+}
+
+static
+void sweep_cell_key(Sweep_Cell *cell, char *buffer, usize buffer_size)
+{
+  snprintf(buffer, buffer_size, "%u,%u,%u,%g,%u,%s",
+           cell->row_count, cell->col_count, cell->inner_count, cell->density, cell->thread_count, cell->entry);
+}
+
+static
+b32 sweep_results_open(Arena *arena, char *path, Sweep_Results *out)
+{
+  Sweep_Results result = {0};
+
+  u64 size = 0;
+  char *text = sweep_read_file(arena, path, &size);
+
+  // A line cut off mid write is dropped, and the cell run again
+  u64 whole_size = text ? size : 0;
+  while (whole_size && text[whole_size - 1] != '\n')
+  {
+    whole_size -= 1;
+  }
+
+  if (whole_size != size && truncate(path, whole_size) != 0)
+  {
+    LOG_ERROR("Unable to drop the partial last line of %s", path);
+    return false;
+  }
+
+  if (whole_size)
+  {
+    result.done_keys = arena_calloc(arena, sweep_count_char(text, '\n') + 1, char *);
+
+    u64 column_count = sweep_count_char(sweep_header, ',') + 1;
+
+    char *line = text;
+    for (char *newline = strchr(line, '\n'); newline; line = newline + 1, newline = strchr(line, '\n'))
+    {
+      *newline = '\0';
+
+      if (strncmp(line, "row_count,", strlen("row_count,")) == 0 ||
+          sweep_count_char(line, ',') + 1 != column_count)
+      {
+        continue;
+      }
+
+      char *key_end = line;
+      for (u32 i = 0; i < SWEEP_KEY_COLUMN_COUNT; i++)
+      {
+        key_end = strchr(key_end, ',') + 1;
+      }
+      key_end[-1] = '\0';
+
+      result.done_keys[result.done_count++] = line;
+    }
+  }
+
+  result.file = fopen(path, "a");
+  if (!result.file)
+  {
+    LOG_ERROR("Unable to open sweep results: %s", path);
+    return false;
+  }
+
+  if (!whole_size)
+  {
+    fprintf(result.file, "%s\n", sweep_header);
+    fflush(result.file);
+  }
+
+  if (result.done_count)
+  {
+    LOG_INFO("Resuming sweep, %lu cells already in %s", result.done_count, path);
+  }
+
+  *out = result;
+
+  return true;
+}
+
+static
+void sweep_results_close(Sweep_Results *results)
+{
+  if (results->file)
+  {
+    fclose(results->file);
+  }
+
+  results->file = NULL;
+}
+
+static
+b32 sweep_cell_done(Sweep_Results *results, Sweep_Cell *cell)
+{
+  char key[512];
+  sweep_cell_key(cell, key, sizeof(key));
+
+  b32 result = false;
+  for (u64 i = 0; i < results->done_count && !result; i++)
+  {
+    result = strcmp(results->done_keys[i], key) == 0;
+  }
+
+  return result;
+}
+
+static
+void sweep_results_write(Sweep_Results *results, Sweep_Cell *cell)
+{
+  char key[512];
+  sweep_cell_key(cell, key, sizeof(key));
+
+  // One call per row and flushed straight away, so a kill leaves at most one partial line
+  fprintf(results->file, "%s,%lu,%lu,%lu,%lu,%f,%f,%f,%f,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+          key, cell->left_non_zero_count, cell->right_non_zero_count, cell->output_non_zero_count,
+          cell->time.count, cell->time.min, cell->time.mean, cell->time.max, sweep_stats_stddev(&cell->time),
+          cell->flops, cell->memops, cell->bytes,
+          cell->counted_flops, cell->counted_memops, cell->counted_bytes, cell->timer_frequency);
+  fflush(results->file);
+}
+
+static
+void sweep_stats_add(Sweep_Stats *stats, f64 value)
+{
+  stats->count += 1;
+  stats->min = stats->count == 1 ? value : MIN(stats->min, value);
+  stats->max = stats->count == 1 ? value : MAX(stats->max, value);
+
+  f64 delta = value - stats->mean;
+  stats->mean += delta / stats->count;
+  stats->m2   += delta * (value - stats->mean);
+}
+
+// Sample standard deviation, 0 with fewer than 2
+static
+f64 sweep_stats_stddev(Sweep_Stats *stats)
+{
+  return stats->count > 1 ? sqrt(stats->m2 / (stats->count - 1)) : 0.0;
+}
@@ -0,0 +1,117 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "../common.h"
+
+// A grid of benchmark cells, every shape x density x thread count x entry, from a config file of
+// `key = values` lines, '#' to the end of a line is a comment:
+//
+//   rows      = 256 1024 4096
+//   inners    = 512 2048
+//   cols      = 256 1024            and/or  aspects = 0.5 1 2, for col_count = row_count * aspect
+//   densities = 0.001 0.01 0.1
+//   threads   = 1 4 16              thread pool size, 1 if left out
+//   entries   = csr_X_dense coo_X_csr  every entry if left out
+//   seconds   = 3                   per cell, the command line's if left out
+//
+// Cells go to one csv, a row flushed as each finishes. Rerunning with the same file skips every
+// cell it already has, so a sweep that got cut off picks up where it stopped
+
+#define SWEEP_MAX_VALUES 64
+
+typedef struct Sweep_List Sweep_List;
+struct Sweep_List
+{
+  f64 v[SWEEP_MAX_VALUES];
+  u32 count;
+};
+
+typedef struct Sweep_Config Sweep_Config;
+struct Sweep_Config
+{
+  Sweep_List rows;
+  Sweep_List inners;
+  Sweep_List cols;
+  Sweep_List aspects;
+  Sweep_List densities;
+  Sweep_List threads;
+
+  char *entries[SWEEP_MAX_VALUES];
+  u32 entry_count;
+
+  u32 seconds;
+};
+
+// Every repetition's time, not just the fastest
+typedef struct Sweep_Stats Sweep_Stats;
+struct Sweep_Stats
+{
+  u64 count;
+  f64 min;
+  f64 max;
+  f64 mean;
+  f64 m2; // Sum of squared distances from the mean, Welford
+};
+
+typedef struct Sweep_Cell Sweep_Cell;
+struct Sweep_Cell
+{
+  // The key, a cell is done if the file has a row starting with these
+  u32 row_count;
+  u32 col_count;
+  u32 inner_count;
+  f64 density;
+  u32 thread_count;
+  char *entry;
+
+  u64 left_non_zero_count;
+  u64 right_non_zero_count;
+  u64 output_non_zero_count;
+
+  Sweep_Stats time;
+
+  // Of the fastest repetition, 0 unless built with OBSERVE_FLOPS/OBSERVE_MEMOPS
+  u64 flops;
+  u64 memops;
+  u64 bytes;
+
+  u64 counted_flops;
+  u64 counted_memops;
+  u64 counted_bytes;
+
+  u64 timer_frequency;
+};
+
+typedef struct Sweep_Results Sweep_Results;
+struct Sweep_Results
+{
+  FILE *file;
+
+  // Keys of the rows already there
+  char **done_keys;
+  u64 done_count;
+};
+
+static
+b32 sweep_config_load(Arena *arena, char *path, Sweep_Config *out);
+
+// Opens for appending, writing the header if the file is new
+static
+b32 sweep_results_open(Arena *arena, char *path, Sweep_Results *out);
+
+static
+void sweep_results_close(Sweep_Results *results);
+
+static
+b32 sweep_cell_done(Sweep_Results *results, Sweep_Cell *cell);
+
+static
+void sweep_results_write(Sweep_Results *results, Sweep_Cell *cell);
+
+static
+void sweep_stats_add(Sweep_Stats *stats, f64 value);
+
+static
+f64 sweep_stats_stddev(Sweep_Stats *stats);
+
+#endif // SWEEP_H
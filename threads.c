@@ -0,0 +1,114 @@
+#include "threads.h"
+
+#include <unistd.h>
+#include <immintrin.h>
+
+static
+u32 thread_hardware_count(void)
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return count > 0 ? (u32)count : 1;
+}
+
+// Claim tasks until there are none left, shared by the workers and the dispatching thread
+static
+void thread_pool_run_tasks(Thread_Pool *pool, Thread_Task_Function *function, void *user, u32 task_count)
+{
+  for (;;)
+  {
+    u32 task_index = __atomic_fetch_add(&pool->next_task, 1, __ATOMIC_ACQ_REL);
+    if (task_index >= task_count)
+    {
+      break;
+    }
+
+    function(user, task_index, task_count);
+
+    __atomic_fetch_add(&pool->finished_task_count, 1, __ATOMIC_ACQ_REL);
+  }
+}
+
+static
+void *thread_pool_worker(void *data)
+{
+  Thread_Pool *pool = data;
+
+  u32 seen_generation = 0;
+
+  for (;;)
+  {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->generation == seen_generation)
+    {
+      pthread_cond_wait(&pool->wake, &pool->mutex);
+    }
+    seen_generation = pool->generation;
+
+    // Snapshot under the lock, dispatch won't touch these while we're counted as active
+    Thread_Task_Function *function = pool->function;
+    void *user     = pool->user;
+    u32 task_count = pool->task_count;
+    pool->active_worker_count += 1;
+    pthread_mutex_unlock(&pool->mutex);
+
+    thread_pool_run_tasks(pool, function, user, task_count);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->active_worker_count -= 1;
+    pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->mutex);
+  }
+
+  return NULL;
+}
+
+static
+Thread_Pool *thread_pool_make(Arena *arena, u32 thread_count)
+{
+  Thread_Pool *pool = arena_calloc(arena, 1, Thread_Pool);
+
+  pool->worker_count = thread_count > 1 ? thread_count - 1 : 0;
+  pool->workers = arena_calloc(arena, pool->worker_count, pthread_t);
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->done, NULL);
+
+  for (u32 i = 0; i < pool->worker_count; i++)
+  {
+    pthread_create(&pool->workers[i], NULL, thread_pool_worker, pool);
+  }
+
+  return pool;
+}
+
+// Blocks until every task has finished, the calling thread helps out
+static
+void thread_pool_dispatch(Thread_Pool *pool, u32 task_count, Thread_Task_Function *function, void *user)
+{
+  pthread_mutex_lock(&pool->mutex);
+  // Stragglers from the last dispatch may still be claiming (and failing to claim) tasks
+  while (pool->active_worker_count > 0)
+  {
+    pthread_cond_wait(&pool->done, &pool->mutex);
+  }
+
+  pool->function   = function;
+  pool->user       = user;
+  pool->task_count = task_count;
+  pool->next_task  = 0;
+  pool->finished_task_count = 0;
+  pool->generation += 1;
+
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+
+  thread_pool_run_tasks(pool, function, user, task_count);
+
+  // Tasks are short, spinning beats sleeping on the condition variable here
+  while (__atomic_load_n(&pool->finished_task_count, __ATOMIC_ACQUIRE) < task_count)
+  {
+    _mm_pause();
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+#include "../common.h"
+
+#include <pthread.h>
+
+// Called once per task, task_index in [0, task_count)
+typedef void Thread_Task_Function(void *user, u32 task_index, u32 task_count);
+
+// Persistent workers, so that timing a parallel kernel doesn't also time pthread_create()
+typedef struct Thread_Pool Thread_Pool;
+struct Thread_Pool
+{
+  u32 worker_count; // Not including the thread that dispatches, it also runs tasks
+  pthread_t *workers;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t  wake;
+  pthread_cond_t  done;
+
+  // Current dispatch, only written under the mutex while no worker is active
+  Thread_Task_Function *function;
+  void *user;
+  u32   task_count;
+  u32   generation;
+
+  u32 active_worker_count;
+  u32 next_task;
+  u32 finished_task_count;
+};
+
+static
+u32 thread_hardware_count(void);
+
+static
+Thread_Pool *thread_pool_make(Arena *arena, u32 thread_count);
+
+static
+void thread_pool_dispatch(Thread_Pool *pool, u32 task_count, Thread_Task_Function *function, void *user);
+
+#endif // THREADS_H